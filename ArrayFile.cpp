@@ -0,0 +1,64 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by James Vecore
+// james.vecore@gmail.com
+
+#include "ArrayFile.h"
+
+#include <cstdio>
+#include <algorithm>
+
+std::string GetArrayFileName(const std::string& fileName, const std::string& channel)
+{
+	return fileName + "." + channel + ".arr";
+}
+
+std::string WriteArrayFile(const std::string& fileName, const ParticleDataArray& data, int particleCount)
+{
+	// the elements of every particle are somewhere in [0, elementCount), the first element of an empty array can be
+	// anything so it doesn't count
+	size_t elementCount = 0;
+	const int tableSize = data.Stride == 0 ? std::min(particleCount, 1) : particleCount;
+	for (int i=0; i < tableSize; i++)
+	{
+		if (data.ArrayCounts[i] != 0)
+			elementCount = std::max(elementCount, size_t(data.ArrayFirst[i]) + data.ArrayCounts[i]);
+	}
+
+	// the values are written as they are, every platform softimage runs on is little endian
+	const int header[3] = { data.Int ? 0 : 1, data.Components, (int)elementCount };
+	const char magic[8] = { 'P', 'X', 'S', 'A', 'R', 'R', '1', 0 };
+	const size_t valueBytes = elementCount * data.Components * sizeof(float);
+
+	FILE* file = fopen(fileName.c_str(), "wb");
+	if (file == NULL)
+		return "Failed to open file for writing: " + fileName;
+
+	bool ok = fwrite(magic, 1, sizeof(magic), file) == sizeof(magic);
+	ok = ok && fwrite(header, 1, sizeof(header), file) == sizeof(header);
+	ok = ok && (valueBytes == 0 || fwrite(data.Data, 1, valueBytes, file) == valueBytes);
+	ok = fclose(file) == 0 && ok;
+	if (!ok)
+		return "Failed to write array values: " + fileName;
+	return std::string();
+}
@@ -0,0 +1,48 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by James Vecore
+// james.vecore@gmail.com
+
+#ifndef PARTIO_EXPORT_ARRAY_FILE_H
+#define PARTIO_EXPORT_ARRAY_FILE_H
+
+#include <string>
+
+#include "ParticleSource.h"
+
+// the file next to fileName that holds the elements of an indexed array channel (arrays=indexed, see ExportOptions.h)
+std::string GetArrayFileName(const std::string& fileName, const std::string& channel);
+
+// Writes the elements of a per point array attribute as a sidecar to the particle file, which stores each particle's
+// first element and element count in the <channel>Offset and <channel>Count channels. All values little endian:
+//
+//   char[8]  "PXSARR1" and a 0 byte
+//   int32    0 for int elements, 1 for float elements
+//   int32    values per element
+//   int32    element count
+//   int32 or float32 values, element after element
+//
+// Returns an empty string on success, otherwise an error message.
+std::string WriteArrayFile(const std::string& fileName, const ParticleDataArray& data, int particleCount);
+
+#endif
@@ -0,0 +1,215 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by James Vecore
+// james.vecore@gmail.com
+// Microbenchmark of the bulk conversion kernels (ConvertKernels.h) against the per particle loop StoreData used
+// before them: one dataWrite() call per particle and the components stored one at a time from an ICE style value
+// type. Both run on the same synthetic arrays into a partio particle set and their output is compared.
+//
+//   PartioConvertBenchmark [--particles <n>] [--repeat <n>] [--output <file>]
+//
+// Writes CSV to stdout or --output: case, particles, loop_ms, bulk_ms, speedup. Times are the best of --repeat runs
+// (default 5) over --particles particles (default 10M).
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include <Partio.h>
+
+#include "ConvertKernels.h"
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	// stand-ins for the ICE value types the old loop read through their accessors
+	struct Vector3f
+	{
+		float x, y, z;
+		float GetX() const { return x; }
+		float GetY() const { return y; }
+		float GetZ() const { return z; }
+	};
+
+	struct Vector4f
+	{
+		float x, y, z, w;
+		float GetX() const { return x; }
+		float GetY() const { return y; }
+		float GetZ() const { return z; }
+		float GetW() const { return w; }
+	};
+
+	struct Color4f
+	{
+		float r, g, b, a;
+		float GetR() const { return r; }
+		float GetG() const { return g; }
+		float GetB() const { return b; }
+		float GetA() const { return a; }
+	};
+
+	// w first, like the quaternions of Rotation attributes
+	struct Quaternionf
+	{
+		float w, x, y, z;
+	};
+
+	inline void StoreValue(const float& value, float* dst, int) { dst[0] = value; }
+	inline void StoreValue(const Vector3f& value, float* dst, int) { dst[0] = value.GetX(); dst[1] = value.GetY(); dst[2] = value.GetZ(); }
+	inline void StoreValue(const Vector4f& value, float* dst, int) { dst[0] = value.GetX(); dst[1] = value.GetY(); dst[2] = value.GetZ(); dst[3] = value.GetW(); }
+	inline void StoreValue(const Quaternionf& value, float* dst, int) { dst[0] = value.x; dst[1] = value.y; dst[2] = value.z; dst[3] = value.w; }
+
+	inline void StoreValue(const Color4f& value, float* dst, int count)
+	{
+		dst[0] = value.GetR();
+		dst[1] = value.GetG();
+		dst[2] = value.GetB();
+		if (count > 3)
+			dst[3] = value.GetA();
+	}
+
+	template <typename ValueType>
+	void StoreLoop(const std::vector<ValueType>& values, Partio::ParticlesDataMutable* pPD, const Partio::ParticleAttribute& attr)
+	{
+		const int count = attr.count;
+		for (int i=0; i < pPD->numParticles(); i++)
+		{
+			StoreValue(values[i], pPD->dataWrite<float>(attr, i), count);
+		}
+	}
+
+	template <typename ValueType>
+	void StoreBulk(const std::vector<ValueType>& values, Partio::ParticlesDataMutable* pPD, const Partio::ParticleAttribute& attr, bool wxyz)
+	{
+		const int components = sizeof(ValueType) / sizeof(float);
+		float* dst = pPD->dataWrite<float>(attr, 0);
+		const size_t dstStride = pPD->numParticles() > 1 ? (char*)pPD->dataWrite<float>(attr, 1) - (char*)dst : attr.count * sizeof(float);
+		if (wxyz)
+			CopyQuaternionsWXYZ((const float*)&values[0], sizeof(ValueType), dst, dstStride, pPD->numParticles());
+		else
+			CopyFloatsBulk((const float*)&values[0], sizeof(ValueType), components, dst, dstStride, attr.count, pPD->numParticles());
+	}
+
+	double Milliseconds(Clock::duration duration)
+	{
+		return std::chrono::duration<double, std::milli>(duration).count();
+	}
+
+	template <typename ValueType>
+	bool RunCase(const char* name, int particleCount, int channelCount, bool wxyz, int repeat, std::ostream& out)
+	{
+		std::vector<ValueType> values(particleCount);
+		float* floats = (float*)&values[0];
+		for (size_t i=0; i < values.size() * sizeof(ValueType) / sizeof(float); i++)
+		{
+			floats[i] = (float)(i % 1000) * 0.5f;
+		}
+
+		Partio::ParticlesDataMutable* loopPD = Partio::create();
+		Partio::ParticlesDataMutable* bulkPD = Partio::create();
+		Partio::ParticleAttribute loopAttr = loopPD->addAttribute(name, Partio::FLOAT, channelCount);
+		Partio::ParticleAttribute bulkAttr = bulkPD->addAttribute(name, Partio::FLOAT, channelCount);
+		loopPD->addParticles(particleCount);
+		bulkPD->addParticles(particleCount);
+
+		double loopMs = 0.0, bulkMs = 0.0;
+		for (int r=0; r < repeat; r++)
+		{
+			Clock::time_point start = Clock::now();
+			StoreLoop(values, loopPD, loopAttr);
+			Clock::time_point loopEnd = Clock::now();
+			StoreBulk(values, bulkPD, bulkAttr, wxyz);
+			Clock::time_point bulkEnd = Clock::now();
+
+			loopMs = r == 0 ? Milliseconds(loopEnd - start) : std::min(loopMs, Milliseconds(loopEnd - start));
+			bulkMs = r == 0 ? Milliseconds(bulkEnd - loopEnd) : std::min(bulkMs, Milliseconds(bulkEnd - loopEnd));
+		}
+
+		const bool same = particleCount == 0 || memcmp(loopPD->data<float>(loopAttr, 0), bulkPD->data<float>(bulkAttr, 0), size_t(particleCount) * channelCount * sizeof(float)) == 0;
+		if (!same)
+			std::cerr << name << ": bulk and loop output differ" << std::endl;
+
+		out << name << "," << particleCount << "," << loopMs << "," << bulkMs << "," << (bulkMs > 0.0 ? loopMs / bulkMs : 0.0) << std::endl;
+
+		loopPD->release();
+		bulkPD->release();
+		return same;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	int particleCount = 10000000;
+	int repeat = 5;
+	std::string outputFileName;
+
+	for (int i=1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--particles" && hasValue)
+			particleCount = atoi(argv[++i]);
+		else if (arg == "--repeat" && hasValue)
+			repeat = atoi(argv[++i]);
+		else if (arg == "--output" && hasValue)
+			outputFileName = argv[++i];
+		else
+			particleCount = -1;
+	}
+	if (particleCount < 0 || repeat < 1)
+	{
+		std::cerr << "usage: PartioConvertBenchmark [--particles <n>] [--repeat <n>] [--output <file>]" << std::endl;
+		return 1;
+	}
+
+	std::ofstream outputFile;
+	if (!outputFileName.empty())
+	{
+		outputFile.open(outputFileName.c_str());
+		if (!outputFile)
+		{
+			std::cerr << "Failed to open " << outputFileName << std::endl;
+			return 1;
+		}
+	}
+	std::ostream& out = outputFileName.empty() ? std::cout : outputFile;
+	out << "case,particles,loop_ms,bulk_ms,speedup" << std::endl;
+	out << std::fixed << std::setprecision(3);
+
+	bool ok = true;
+	ok = RunCase<float>("Float", particleCount, 1, false, repeat, out) && ok;
+	ok = RunCase<Vector3f>("Vector3f", particleCount, 3, false, repeat, out) && ok;
+	ok = RunCase<Vector4f>("Vector4f", particleCount, 4, false, repeat, out) && ok;
+	ok = RunCase<Color4f>("Color4f", particleCount, 4, false, repeat, out) && ok;
+	ok = RunCase<Color4f>("Color4fToFloat3", particleCount, 3, false, repeat, out) && ok;
+	ok = RunCase<Quaternionf>("QuaternionfWXYZ", particleCount, 4, true, repeat, out) && ok;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,334 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by James Vecore
+// james.vecore@gmail.com
+
+
+
+// Headless export benchmark: exports synthetic clouds through the export core (MemoryParticleSource.h) for every
+// format and a range of particle counts and writes the time each stage took as CSV, one line per exported file.
+//
+//   PartioExportBenchmark [--max-particles <n>] [--frames <n>] [--cases <case,...>] [--channels <n>] [--threads <n,...>]
+//                         [--dir <path>] [--output <file>] [--keep]
+//
+// Particle counts go from 1K up to 50M by default (--max-particles lowers that, 50M particles take about 5 GB). Every
+// count is exported --frames times (default 3) so the first frame, which allocates, can be told apart from the ones
+// that reuse their particle sets. The clouds have 5 channels (position, velocity, color, size and ID), --channels adds
+// vector channels up to that many, i.e. --channels 20 for a wide cache. --threads runs everything once per worker
+// thread count (the exporter is restarted with PARTIO_EXPORT_THREADS set), to see how conversion and compression
+// scale; by default the pool's usual thread count is used. The files go to --dir and are deleted afterwards unless
+// --keep is given. Results go to stdout or --output. Columns:
+//
+//   case, extension, options, particles, channels, threads, frame,
+//   fetch_ms, allocate_ms, convert_ms, write_ms  stage times from the export profiler (convert is summed over threads)
+//   export_ms                                    wall time of the export call (fetch, allocate and convert)
+//   total_ms                                     wall time until the file was written
+//   data_bytes, file_bytes, mparticles_per_s     converted data, file size and particles per second of total_ms
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "ParticleExporter.h"
+#include "MemoryParticleSource.h"
+#include "ExportProfiler.h"
+#include "WriteQueue.h"
+#include "WorkerPool.h"
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	struct BenchmarkCase
+	{
+		const char* Name;
+		const char* Extension;
+		const char* Options;
+	};
+
+	const BenchmarkCase benchmarkCases[] =
+	{
+		{ "prt",              "prt",  "" },
+		{ "prt-fast",         "prt",  "level=fast" },
+		{ "prt-uncompressed", "prt",  "compress=off" },
+		{ "prt-half",         "prt",  "precision=half" },
+		{ "bgeo",             "bgeo", "" },
+		{ "bgeo-gzip",        "bgeo", "compress=on" },
+		{ "bin",              "bin",  "" },
+		{ "pdb",              "pdb",  "" },
+	};
+
+	const int particleCounts[] = { 1000, 10000, 100000, 1000000, 10000000, 50000000 };
+
+	double Milliseconds(Clock::duration duration)
+	{
+		return std::chrono::duration<double, std::milli>(duration).count();
+	}
+
+	// deterministic values that don't compress unrealistically well
+	struct Random
+	{
+		Random(unsigned int seed) : State(seed) {}
+
+		float Next(float low, float high)
+		{
+			State = State * 1664525u + 1013904223u;
+			return low + (high - low) * (float)(State >> 8) / 16777216.0f;
+		}
+
+		unsigned int State;
+	};
+
+	// what a typical simulation cache holds: positions, velocities, colors, sizes and IDs, and vectors up to channelCount
+	void AddChannels(MemoryParticleSource& source, int particleCount, int channelCount)
+	{
+		Random random(1234);
+		std::vector<float> position(size_t(particleCount) * 3), velocity(size_t(particleCount) * 3);
+		std::vector<float> color(size_t(particleCount) * 4), size(particleCount);
+		std::vector<int> id(particleCount);
+		for (int i=0; i < particleCount; i++)
+		{
+			for (int c=0; c < 3; c++)
+			{
+				position[i*3 + c] = random.Next(-100.0f, 100.0f);
+				velocity[i*3 + c] = random.Next(-1.0f, 1.0f);
+			}
+			for (int c=0; c < 4; c++)
+			{
+				color[i*4 + c] = random.Next(0.0f, 1.0f);
+			}
+			size[i] = random.Next(0.01f, 0.1f);
+			id[i] = i;
+		}
+
+		source.AddAttribute("PointPosition", ParticleDataVector3, position);
+		source.AddAttribute("PointVelocity", ParticleDataVector3, velocity);
+		source.AddAttribute("Color", ParticleDataColor4, color);
+		source.AddAttribute("Size", ParticleDataFloat, size);
+		source.AddAttribute("ID", ParticleDataLong, id);
+
+		for (int c=source.GetAttributeCount(); c < channelCount; c++)
+		{
+			std::ostringstream name;
+			name << "Vector" << c;
+			for (size_t i=0; i < position.size(); i++)
+			{
+				position[i] = random.Next(-1.0f, 1.0f);
+			}
+			source.AddAttribute(name.str(), ParticleDataVector3, position);
+		}
+	}
+
+	void SetThreadCount(int threadCount)
+	{
+		std::ostringstream value;
+		value << threadCount;
+#ifdef _WIN32
+		_putenv_s("PARTIO_EXPORT_THREADS", value.str().c_str());
+#else
+		setenv("PARTIO_EXPORT_THREADS", value.str().c_str(), 1);
+#endif
+	}
+
+	long long GetFileSize(const std::string& fileName)
+	{
+		std::ifstream file(fileName.c_str(), std::ios::binary | std::ios::ate);
+		return file ? (long long)file.tellg() : 0;
+	}
+
+	bool IsSelected(const std::vector<std::string>& selected, const std::string& name)
+	{
+		if (selected.empty())
+			return true;
+		for (size_t i=0; i < selected.size(); i++)
+		{
+			if (selected[i] == name)
+				return true;
+		}
+		return false;
+	}
+
+	std::vector<std::string> SplitList(const std::string& list)
+	{
+		std::vector<std::string> items;
+		std::stringstream ss(list);
+		std::string item;
+		while (std::getline(ss, item, ','))
+		{
+			if (!item.empty())
+				items.push_back(item);
+		}
+		return items;
+	}
+
+	int Usage()
+	{
+		std::cerr << "usage: PartioExportBenchmark [--max-particles <n>] [--frames <n>] [--cases <case,...>] [--channels <n>] [--threads <n,...>] [--dir <path>] [--output <file>] [--keep]" << std::endl;
+		std::cerr << "cases:";
+		for (size_t i=0; i < sizeof(benchmarkCases) / sizeof(benchmarkCases[0]); i++)
+		{
+			std::cerr << " " << benchmarkCases[i].Name;
+		}
+		std::cerr << std::endl;
+		return 1;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	long long maxParticles = 50000000;
+	int frames = 3;
+	std::vector<std::string> selectedCases;
+	int channelCount = 5;
+	std::vector<int> threadCounts;
+	std::string directory = ".";
+	std::string outputFileName;
+	bool keepFiles = false;
+
+	for (int i=1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--max-particles" && hasValue)
+			maxParticles = atoll(argv[++i]);
+		else if (arg == "--frames" && hasValue)
+			frames = atoi(argv[++i]);
+		else if (arg == "--cases" && hasValue)
+			selectedCases = SplitList(argv[++i]);
+		else if (arg == "--channels" && hasValue)
+			channelCount = atoi(argv[++i]);
+		else if (arg == "--threads" && hasValue)
+		{
+			std::vector<std::string> counts = SplitList(argv[++i]);
+			for (size_t t=0; t < counts.size(); t++)
+			{
+				threadCounts.push_back(atoi(counts[t].c_str()));
+				if (threadCounts.back() < 1)
+					return Usage();
+			}
+		}
+		else if (arg == "--dir" && hasValue)
+			directory = argv[++i];
+		else if (arg == "--output" && hasValue)
+			outputFileName = argv[++i];
+		else if (arg == "--keep")
+			keepFiles = true;
+		else
+			return Usage();
+	}
+	if (frames < 1)
+		return Usage();
+
+	std::ofstream outputFile;
+	if (!outputFileName.empty())
+	{
+		outputFile.open(outputFileName.c_str());
+		if (!outputFile)
+		{
+			std::cerr << "Failed to open " << outputFileName << std::endl;
+			return 1;
+		}
+	}
+	std::ostream& out = outputFileName.empty() ? std::cout : outputFile;
+	out << "case,extension,options,particles,channels,threads,frame,fetch_ms,allocate_ms,convert_ms,write_ms,export_ms,total_ms,data_bytes,file_bytes,mparticles_per_s" << std::endl;
+	out << std::fixed << std::setprecision(3);
+
+	StreamExportLog log(std::cerr, ExportLogWarning);
+	bool ok = true;
+
+	if (threadCounts.empty())
+		threadCounts.push_back(WorkerPool::DefaultThreadCount());
+
+	for (size_t p=0; p < sizeof(particleCounts) / sizeof(particleCounts[0]) && particleCounts[p] <= maxParticles; p++)
+	{
+		const int particleCount = particleCounts[p];
+		MemoryParticleSource source("benchmark", particleCount);
+		AddChannels(source, particleCount, channelCount);
+
+		for (size_t t=0; t < threadCounts.size(); t++)
+		{
+			// the shared pool picks up the thread count when it is created again
+			if (WorkerPool::Shared().GetThreadCount() != threadCounts[t])
+			{
+				ShutdownExporter(log);
+				SetThreadCount(threadCounts[t]);
+			}
+			ExportProfiler::Shared().SetRecordFrames(true);
+
+			for (size_t c=0; c < sizeof(benchmarkCases) / sizeof(benchmarkCases[0]); c++)
+			{
+				const BenchmarkCase& benchmarkCase = benchmarkCases[c];
+				if (!IsSelected(selectedCases, benchmarkCase.Name))
+					continue;
+
+				ExportFormatFamily family;
+				GetExportFormatFamily(benchmarkCase.Extension, family);
+				const ExportFormat& format = GetExportFormat(family);
+
+				ExportOptions options;
+				ParseExportOptions(*benchmarkCase.Options != 0 ? std::string(benchmarkCase.Options) + ",profile=on" : "profile=on", options);
+
+				std::ostringstream fileName;
+				fileName << directory << "/benchmark_" << benchmarkCase.Name << "_" << particleCount << "." << benchmarkCase.Extension;
+
+				for (int frame=0; frame < frames; frame++)
+				{
+					Clock::time_point start = Clock::now();
+					ok = ExportParticles(source, format, options, fileName.str(), log) && ok;
+					Clock::time_point exported = Clock::now();
+					WriteQueue::Shared().Flush();
+					Clock::time_point written = Clock::now();
+					ok = !LogWriteErrors(log) && ok;
+
+					std::vector< std::shared_ptr<FrameProfile> > profiles;
+					ExportProfiler::Shared().LogFinishedFrames(log);
+					ExportProfiler::Shared().TakeRecordedFrames(profiles);
+					FrameProfile profile;
+					if (!profiles.empty())
+						profile = *profiles.back();
+
+					const double totalMs = Milliseconds(written - start);
+					out << benchmarkCase.Name << "," << benchmarkCase.Extension << "," << benchmarkCase.Options << "," << particleCount << "," << source.GetAttributeCount() << ","
+						<< WorkerPool::Shared().GetThreadCount() << "," << frame << ","
+						<< profile.StageSeconds[ExportStageFetch] * 1000.0 << "," << profile.StageSeconds[ExportStageAllocate] * 1000.0 << ","
+						<< profile.StageSeconds[ExportStageConvert] * 1000.0 << "," << profile.StageSeconds[ExportStageWrite] * 1000.0 << ","
+						<< Milliseconds(exported - start) << "," << totalMs << "," << profile.Bytes << "," << GetFileSize(fileName.str()) << ","
+						<< (totalMs > 0.0 ? particleCount / totalMs / 1000.0 : 0.0) << std::endl;
+				}
+
+				if (!keepFiles)
+					remove(fileName.str().c_str());
+			}
+		}
+	}
+
+	ShutdownExporter(log);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,125 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by James Vecore
+// james.vecore@gmail.com
+
+
+
+#ifndef PARTIO_EXPORT_CONVERT_KERNELS_H
+#define PARTIO_EXPORT_CONVERT_KERNELS_H
+
+#include <cstring>
+#include <cstddef>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define PARTIO_EXPORT_SSE
+#include <xmmintrin.h>
+#endif
+
+// Bulk conversion kernels
+//
+// Sources hand over their data as plain int or float arrays (see ParticleDataArray), so converting a channel is mostly
+// a strided copy. Strides are in bytes, a source stride of 0 means all particles share one value.
+
+// copies srcCount floats per particle into dstCount floats per particle (dstCount <= srcCount)
+inline void CopyFloatsBulk(const float* src, size_t srcStride, int srcCount, float* dst, size_t dstStride, int dstCount, int numParticles)
+{
+	const size_t srcElemSize = srcCount * sizeof(float);
+	const size_t dstElemSize = dstCount * sizeof(float);
+
+	if (srcStride == srcElemSize && dstStride == dstElemSize && srcCount == dstCount)
+	{
+		memcpy(dst, src, dstElemSize * numParticles);
+		return;
+	}
+
+	const char* srcBytes = (const char*)src;
+	char* dstBytes = (char*)dst;
+
+#ifdef PARTIO_EXPORT_SSE
+	if (srcCount == 4 && dstCount == 3 && srcStride == srcElemSize && dstStride == dstElemSize)
+	{
+		// 4 -> 3 floats (i.e. Color4f -> Krakatoa float3), 4 particles at a time shuffled into 3 full stores so
+		// nothing is written past the last particle, the rest are copied one by one below
+		const int groups = numParticles / 4;
+		for (int g=0; g < groups; g++)
+		{
+			const float* in = src + size_t(g)*16;
+			float* out = dst + size_t(g)*12;
+			__m128 a = _mm_loadu_ps(in);
+			__m128 b = _mm_loadu_ps(in + 4);
+			__m128 c = _mm_loadu_ps(in + 8);
+			__m128 d = _mm_loadu_ps(in + 12);
+			__m128 ab = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0,0,2,2)); // z0 z0 x1 x1
+			__m128 cd = _mm_shuffle_ps(c, d, _MM_SHUFFLE(0,0,2,2)); // z2 z2 x3 x3
+			_mm_storeu_ps(out,     _mm_shuffle_ps(a, ab, _MM_SHUFFLE(2,0,1,0))); // x0 y0 z0 x1
+			_mm_storeu_ps(out + 4, _mm_shuffle_ps(b, c,  _MM_SHUFFLE(1,0,2,1))); // y1 z1 x2 y2
+			_mm_storeu_ps(out + 8, _mm_shuffle_ps(cd, d, _MM_SHUFFLE(2,1,2,0))); // z2 x3 y3 z3
+		}
+		srcBytes += size_t(groups)*4*srcStride;
+		dstBytes += size_t(groups)*4*dstStride;
+		numParticles -= groups*4;
+	}
+#endif
+
+	for (int i=0; i < numParticles; i++)
+	{
+		memcpy(dstBytes + i*dstStride, srcBytes + i*srcStride, dstElemSize);
+	}
+}
+
+// quaternions stored as w,x,y,z but exported as x,y,z,w
+inline void CopyQuaternionsWXYZ(const float* src, size_t srcStride, float* dst, size_t dstStride, int numParticles)
+{
+	const char* srcBytes = (const char*)src;
+	char* dstBytes = (char*)dst;
+	for (int i=0; i < numParticles; i++)
+	{
+		const float* q = (const float*)(srcBytes + i*srcStride);
+		float* out = (float*)(dstBytes + i*dstStride);
+#ifdef PARTIO_EXPORT_SSE
+		__m128 v = _mm_loadu_ps(q);
+		_mm_storeu_ps(out, _mm_shuffle_ps(v, v, _MM_SHUFFLE(0,3,2,1)));
+#else
+		out[0] = q[1];
+		out[1] = q[2];
+		out[2] = q[3];
+		out[3] = q[0];
+#endif
+	}
+}
+
+inline void CopyStrided(const char* src, size_t srcStride, char* dst, size_t dstStride, size_t elementSize, int count)
+{
+	if (srcStride == elementSize && dstStride == elementSize)
+	{
+		memcpy(dst, src, elementSize * count);
+		return;
+	}
+	for (int i=0; i < count; i++)
+	{
+		memcpy(dst + i*dstStride, src + i*srcStride, elementSize);
+	}
+}
+
+#endif
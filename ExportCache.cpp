@@ -0,0 +1,242 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by James Vecore
+// james.vecore@gmail.com
+
+
+#include "ExportCache.h"
+
+#include <cstdio>
+#include <cstdlib>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
+
+static ExportCache* sharedCache = NULL;
+static std::mutex sharedCacheMutex;
+
+static const char* indexFileName = ".partio_export_cache";
+static const char* indexHeader = "# partio export cache 2"; // 1 stored times in seconds
+
+namespace
+{
+	void SplitPath(const std::string& fileName, std::string& directory, std::string& name)
+	{
+		size_t slashPos = fileName.find_last_of("/\\");
+		directory = slashPos == std::string::npos ? std::string() : fileName.substr(0, slashPos + 1);
+		name = slashPos == std::string::npos ? fileName : fileName.substr(slashPos + 1);
+	}
+
+	// the modification time in nanoseconds (100 ns on windows), st_mtime alone would miss a file rewritten within the
+	// same second
+	bool GetFileStats(const std::string& fileName, long long& size, long long& modifiedTime)
+	{
+#ifdef _WIN32
+		WIN32_FILE_ATTRIBUTE_DATA info;
+		if (!GetFileAttributesExA(fileName.c_str(), GetFileExInfoStandard, &info))
+			return false;
+		size = ((long long)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+		modifiedTime = ((long long)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime; // 100 ns ticks, only compared
+#else
+		struct stat info;
+		if (stat(fileName.c_str(), &info) != 0)
+			return false;
+		size = (long long)info.st_size;
+#ifdef __APPLE__
+		modifiedTime = (long long)info.st_mtimespec.tv_sec * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+		modifiedTime = (long long)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+#endif
+		return true;
+	}
+}
+
+ExportCache::ExportCache()
+{
+}
+
+ExportCache::~ExportCache()
+{
+	Save();
+}
+
+ExportCache::Directory& ExportCache::GetDirectory(const std::string& directory)
+{
+	std::map<std::string, Directory>::iterator pos = m_directories.find(directory);
+	if (pos != m_directories.end())
+		return pos->second;
+
+	Directory& entries = m_directories[directory];
+
+	FILE* file = fopen((directory + indexFileName).c_str(), "r");
+	if (file == NULL)
+		return entries;
+
+	// <hash> <size> <modified time> <file name>, anything that doesn't parse is dropped. Indexes of another version are
+	// dropped entirely, their files are written again and the index replaced.
+	char line[4096];
+	const std::string header = std::string(indexHeader) + "\n";
+	if (fgets(line, sizeof(line), file) == NULL || header.compare(0, std::string::npos, line) != 0)
+	{
+		fclose(file);
+		return entries;
+	}
+	while (fgets(line, sizeof(line), file) != NULL)
+	{
+		unsigned long long hash;
+		long long size, modifiedTime;
+		int nameOffset = 0;
+		if (line[0] == '#' || sscanf(line, "%16llx %lld %lld %n", &hash, &size, &modifiedTime, &nameOffset) != 3 || nameOffset == 0)
+			continue;
+
+		std::string name(line + nameOffset);
+		while (!name.empty() && (name[name.size() - 1] == '\n' || name[name.size() - 1] == '\r'))
+		{
+			name.erase(name.size() - 1);
+		}
+		if (name.empty())
+			continue;
+
+		Entry entry = { hash, size, modifiedTime };
+		entries[name] = entry;
+	}
+	fclose(file);
+	return entries;
+}
+
+bool ExportCache::IsFileUnchanged(const std::string& fileName, HashValue hash)
+{
+	std::string directory, name;
+	SplitPath(fileName, directory, name);
+
+	Directory& entries = GetDirectory(directory);
+	Directory::const_iterator pos = entries.find(name);
+	if (pos == entries.end() || pos->second.Hash != hash)
+		return false;
+
+	long long size, modifiedTime;
+	return GetFileStats(fileName, size, modifiedTime) && size == pos->second.Size && modifiedTime == pos->second.ModifiedTime;
+}
+
+bool ExportCache::IsUnchanged(const std::string& fileName, const std::vector<std::string>& sidecars, HashValue hash)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!IsFileUnchanged(fileName, hash))
+		return false;
+
+	for (size_t i=0; i < sidecars.size(); i++)
+	{
+		if (!IsFileUnchanged(sidecars[i], hash))
+			return false;
+	}
+	return true;
+}
+
+// marks the directory of the file if its index has to be saved
+void ExportCache::UpdateEntry(const std::string& fileName, HashValue hash)
+{
+	std::string directory, name;
+	SplitPath(fileName, directory, name);
+
+	Directory& entries = GetDirectory(directory);
+	Entry entry = { hash, 0, 0 };
+	if (GetFileStats(fileName, entry.Size, entry.ModifiedTime))
+		entries[name] = entry;
+	else if (entries.erase(name) == 0)
+		return;
+
+	m_dirtyDirectories.insert(directory);
+}
+
+std::string ExportCache::SaveDirectory(const std::string& directory)
+{
+	const Directory& entries = GetDirectory(directory);
+
+	const std::string indexPath = directory + indexFileName;
+	FILE* file = fopen(indexPath.c_str(), "w");
+	if (file == NULL)
+		return "Failed to open file for writing: " + indexPath;
+
+	bool ok = fprintf(file, "%s\n", indexHeader) > 0;
+	for (Directory::const_iterator iter = entries.begin(); iter != entries.end() && ok; ++iter)
+	{
+		ok = fprintf(file, "%016llx %lld %lld %s\n", (unsigned long long)iter->second.Hash, iter->second.Size, iter->second.ModifiedTime, iter->first.c_str()) > 0;
+	}
+	ok = fclose(file) == 0 && ok;
+	if (!ok)
+		return "Failed to write export cache index: " + indexPath;
+	return std::string();
+}
+
+void ExportCache::Store(const std::string& fileName, const std::vector<std::string>& sidecars, HashValue hash)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	// a missing file (or sidecar) loses its entry, so it's never skipped
+	UpdateEntry(fileName, hash);
+	for (size_t i=0; i < sidecars.size(); i++)
+	{
+		UpdateEntry(sidecars[i], hash);
+	}
+}
+
+std::vector<std::string> ExportCache::Save()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	// a directory that failed stays dirty, the next call tries again
+	std::vector<std::string> errors;
+	std::set<std::string> failed;
+	for (std::set<std::string>::const_iterator iter = m_dirtyDirectories.begin(); iter != m_dirtyDirectories.end(); ++iter)
+	{
+		std::string error = SaveDirectory(*iter);
+		if (!error.empty())
+		{
+			errors.push_back(error);
+			failed.insert(*iter);
+		}
+	}
+	m_dirtyDirectories.swap(failed);
+	return errors;
+}
+
+ExportCache& ExportCache::Shared()
+{
+	std::lock_guard<std::mutex> lock(sharedCacheMutex);
+	if (sharedCache == NULL)
+		sharedCache = new ExportCache();
+	return *sharedCache;
+}
+
+void ExportCache::ShutdownShared()
+{
+	std::lock_guard<std::mutex> lock(sharedCacheMutex);
+	delete sharedCache;
+	sharedCache = NULL;
+}
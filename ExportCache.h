@@ -0,0 +1,93 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by James Vecore
+// james.vecore@gmail.com
+
+
+#ifndef PARTIO_EXPORT_EXPORT_CACHE_H
+#define PARTIO_EXPORT_EXPORT_CACHE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <mutex>
+
+#include "Hash.h"
+
+// Content hashes of the files the exporter wrote, for skip=on (see ExportOptions.h).
+//
+// Every output directory gets a small index file (".partio_export_cache") with one line per written file: the hash of
+// the data and export settings it was written from, and the size and modification time (as precise as the file system
+// keeps it, so a file rewritten within the same second is still noticed) the file had afterwards. A file is unchanged when its hash
+// matches and it is still on disk with that size and time, so files that were deleted, overwritten or touched by
+// something else are written again. Indexes are loaded on first use. Store() only changes them in memory, Save()
+// writes the ones that changed once per export batch and run and when the cache is shut down, so a long frame range
+// doesn't rewrite a growing index after every file. All calls are safe from any thread.
+//
+// Files written next to a file (the .idx of a sorted file, the .arr files of indexed arrays, the partitions of a split
+// file) are passed as its sidecars. They get their own lines with the same hash, and the file only counts as unchanged
+// if all of them do, so a deleted or overwritten sidecar gets the whole file written again.
+class ExportCache
+{
+public:
+	ExportCache();
+	~ExportCache();
+
+	bool IsUnchanged(const std::string& fileName, const std::vector<std::string>& sidecars, HashValue hash);
+
+	// remembers the hash of a file and its sidecars that were just written, the index is saved by the next Save()
+	void Store(const std::string& fileName, const std::vector<std::string>& sidecars, HashValue hash);
+
+	// writes the indexes of the directories that changed since the last call, returns an error message for each one
+	// that couldn't be saved
+	std::vector<std::string> Save();
+
+	static ExportCache& Shared();
+	static void ShutdownShared(); // saves the indexes that changed, errors are dropped (call Save() first to get them)
+
+private:
+	ExportCache(const ExportCache&);
+	ExportCache& operator=(const ExportCache&);
+
+	struct Entry
+	{
+		HashValue Hash;
+		long long Size;
+		long long ModifiedTime;
+	};
+
+	typedef std::map<std::string, Entry> Directory; // by file name without the directory
+
+	// called with m_mutex held
+	Directory& GetDirectory(const std::string& directory);
+	bool IsFileUnchanged(const std::string& fileName, HashValue hash);
+	void UpdateEntry(const std::string& fileName, HashValue hash);
+	std::string SaveDirectory(const std::string& directory);
+
+	std::map<std::string, Directory> m_directories;
+	std::set<std::string> m_dirtyDirectories; // changed since they were loaded or saved
+	std::mutex m_mutex;
+};
+
+#endif
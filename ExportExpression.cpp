@@ -0,0 +1,583 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by James Vecore
+// james.vecore@gmail.com
+
+#include "ExportExpression.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+#include <memory>
+
+#include "WorkerPool.h"
+
+// particles per register, small enough for all registers of a typical expression to stay in cache
+static const int blockSize = 256;
+
+static int GetComponentCount(ParticleDataType dataType)
+{
+	switch (dataType)
+	{
+	case ParticleDataVector2:    return 2;
+	case ParticleDataVector3:    return 3;
+	case ParticleDataVector4:
+	case ParticleDataQuaternion:
+	case ParticleDataColor4:
+	case ParticleDataRotation:   return 4;
+	case ParticleDataMatrix3:    return 9;
+	case ParticleDataMatrix4:    return 16;
+	default:                     return 1;
+	}
+}
+
+// Recursive descent parser that emits the instructions as it goes, every parse function returns the register holding
+// its value or -1 after an error. Lowest to highest precedence: || && comparisons + - * / % unary postfix.
+class ExpressionParser
+{
+public:
+	ExpressionParser(const std::string& text, ParticleSource& source, ExportExpression& expression)
+		: m_text(text), m_pos(0), m_source(source), m_expression(expression)
+	{
+	}
+
+	std::string Parse()
+	{
+		int result = ParseOr();
+		SkipSpaces();
+		if (result >= 0 && m_pos < m_text.size())
+			Fail("unexpected \"" + m_text.substr(m_pos) + "\"");
+		if (!m_error.empty())
+			return m_error;
+
+		m_expression.m_result = result;
+		m_expression.m_width = m_expression.m_registerWidths[result];
+		return std::string();
+	}
+
+private:
+	typedef ExportExpression::Operation Operation;
+
+	int Fail(const std::string& error)
+	{
+		if (m_error.empty())
+			m_error = error;
+		return -1;
+	}
+
+	void SkipSpaces()
+	{
+		while (m_pos < m_text.size() && isspace((unsigned char)m_text[m_pos]))
+			m_pos++;
+	}
+
+	bool Match(const char* token)
+	{
+		SkipSpaces();
+		size_t length = strlen(token);
+		if (m_text.compare(m_pos, length, token) != 0)
+			return false;
+		m_pos += length;
+		return true;
+	}
+
+	// the single character operators that don't start a longer one
+	bool MatchSingle(char c, char notFollowedBy)
+	{
+		SkipSpaces();
+		if (m_pos >= m_text.size() || m_text[m_pos] != c)
+			return false;
+		if (m_pos + 1 < m_text.size() && m_text[m_pos + 1] == notFollowedBy)
+			return false;
+		m_pos++;
+		return true;
+	}
+
+	std::string ParseIdentifier()
+	{
+		SkipSpaces();
+		size_t start = m_pos;
+		while (m_pos < m_text.size() && (isalnum((unsigned char)m_text[m_pos]) || m_text[m_pos] == '_'))
+			m_pos++;
+		return m_text.substr(start, m_pos - start);
+	}
+
+	int Emit(Operation op, int a, int b, int width, int component = 0, double value = 0.0)
+	{
+		ExportExpression::Instruction instruction = { op, (int)m_expression.m_registerWidths.size(), a, b, width, component, value };
+		m_expression.m_registerWidths.push_back(width);
+		m_expression.m_program.push_back(instruction);
+		return instruction.Result;
+	}
+
+	int Width(int reg) const
+	{
+		return m_expression.m_registerWidths[reg];
+	}
+
+	int EmitArithmetic(Operation op, int a, int b)
+	{
+		if (a < 0 || b < 0)
+			return -1;
+		if (Width(a) != Width(b) && Width(a) != 1 && Width(b) != 1)
+			return Fail("can't combine values with different numbers of components");
+		return Emit(op, a, b, std::max(Width(a), Width(b)));
+	}
+
+	int EmitComparison(Operation op, int a, int b)
+	{
+		if (a < 0 || b < 0)
+			return -1;
+		if (Width(a) != 1 || Width(b) != 1)
+			return Fail("comparisons and logic operators need single values, use a component or length()");
+		return Emit(op, a, b, 1);
+	}
+
+	int ParseOr()
+	{
+		int result = ParseAnd();
+		while (result >= 0 && Match("||"))
+			result = EmitComparison(ExportExpression::OpOr, result, ParseAnd());
+		return result;
+	}
+
+	int ParseAnd()
+	{
+		int result = ParseComparison();
+		while (result >= 0 && Match("&&"))
+			result = EmitComparison(ExportExpression::OpAnd, result, ParseComparison());
+		return result;
+	}
+
+	int ParseComparison()
+	{
+		int result = ParseAdditive();
+		while (result >= 0)
+		{
+			if (Match("<="))
+				result = EmitComparison(ExportExpression::OpLessEqual, result, ParseAdditive());
+			else if (Match(">="))
+				result = EmitComparison(ExportExpression::OpGreaterEqual, result, ParseAdditive());
+			else if (Match("=="))
+				result = EmitComparison(ExportExpression::OpEqual, result, ParseAdditive());
+			else if (Match("!="))
+				result = EmitComparison(ExportExpression::OpNotEqual, result, ParseAdditive());
+			else if (Match("<"))
+				result = EmitComparison(ExportExpression::OpLess, result, ParseAdditive());
+			else if (Match(">"))
+				result = EmitComparison(ExportExpression::OpGreater, result, ParseAdditive());
+			else
+				break;
+		}
+		return result;
+	}
+
+	int ParseAdditive()
+	{
+		int result = ParseMultiplicative();
+		while (result >= 0)
+		{
+			if (Match("+"))
+				result = EmitArithmetic(ExportExpression::OpAdd, result, ParseMultiplicative());
+			else if (Match("-"))
+				result = EmitArithmetic(ExportExpression::OpSubtract, result, ParseMultiplicative());
+			else
+				break;
+		}
+		return result;
+	}
+
+	int ParseMultiplicative()
+	{
+		int result = ParseUnary();
+		while (result >= 0)
+		{
+			if (Match("*"))
+				result = EmitArithmetic(ExportExpression::OpMultiply, result, ParseUnary());
+			else if (Match("/"))
+				result = EmitArithmetic(ExportExpression::OpDivide, result, ParseUnary());
+			else if (Match("%"))
+				result = EmitArithmetic(ExportExpression::OpModulo, result, ParseUnary());
+			else
+				break;
+		}
+		return result;
+	}
+
+	int ParseUnary()
+	{
+		if (Match("-"))
+		{
+			int operand = ParseUnary();
+			return operand < 0 ? -1 : Emit(ExportExpression::OpNegate, operand, -1, Width(operand));
+		}
+		if (MatchSingle('!', '='))
+		{
+			int operand = ParseUnary();
+			return operand < 0 ? -1 : EmitComparison(ExportExpression::OpNot, operand, operand);
+		}
+		return ParsePostfix();
+	}
+
+	int ParsePostfix()
+	{
+		int result = ParsePrimary();
+		while (result >= 0 && Match("."))
+		{
+			std::string name = ParseIdentifier();
+			int component = name.size() == 1 ? (int)std::string("xyzw").find(name[0]) : -1;
+			if (component < 0 && name.size() == 1)
+				component = (int)std::string("rgba").find(name[0]);
+			if (component < 0 || component >= Width(result))
+				return Fail("no component \"" + name + "\"");
+			result = Emit(ExportExpression::OpComponent, result, -1, 1, component);
+		}
+		return result;
+	}
+
+	int ParsePrimary()
+	{
+		SkipSpaces();
+		if (m_pos >= m_text.size())
+			return Fail("unexpected end of expression");
+
+		if (Match("("))
+		{
+			int result = ParseOr();
+			if (result >= 0 && !Match(")"))
+				return Fail("missing \")\"");
+			return result;
+		}
+
+		const char c = m_text[m_pos];
+		if (isdigit((unsigned char)c) || (c == '.' && m_pos + 1 < m_text.size() && isdigit((unsigned char)m_text[m_pos + 1])))
+		{
+			const char* start = m_text.c_str() + m_pos;
+			char* end;
+			double value = strtod(start, &end);
+			m_pos += end - start;
+			// whole numbers stay exact for int attributes, fractions are rounded like the float attributes they're
+			// compared with (Age == 0.1 has to match an Age of 0.1f)
+			if (value != floor(value))
+				value = (float)value;
+			return Emit(ExportExpression::OpConstant, -1, -1, 1, 0, value);
+		}
+
+		std::string name = ParseIdentifier();
+		if (name.empty())
+			return Fail("unexpected \"" + m_text.substr(m_pos) + "\"");
+
+		if (Match("("))
+		{
+			int argument = ParseOr();
+			if (argument >= 0 && !Match(")"))
+				return Fail("missing \")\" after the argument of " + name);
+			if (argument < 0)
+				return -1;
+
+			if (name == "length")
+				return Emit(ExportExpression::OpLength, argument, -1, 1);
+			if (name == "abs")
+				return Emit(ExportExpression::OpAbs, argument, -1, Width(argument));
+			if (name == "sqrt")
+				return Emit(ExportExpression::OpSqrt, argument, -1, Width(argument));
+			if (name == "floor")
+				return Emit(ExportExpression::OpFloor, argument, -1, Width(argument));
+			return Fail("unknown function \"" + name + "\"");
+		}
+
+		return EmitLoad(name);
+	}
+
+	int EmitLoad(const std::string& name)
+	{
+		for (int i=0; i < m_source.GetAttributeCount(); i++)
+		{
+			ParticleAttributeSource& attr = m_source.GetAttribute(i);
+			if (attr.GetName() != name)
+				continue;
+
+			const int width = GetComponentCount(attr.GetDataType());
+			if (!attr.IsPerPoint() || attr.IsArray() || attr.GetDataType() == ParticleDataUnsupported || width > 4)
+				return Fail("attribute \"" + name + "\" can't be used in expressions");
+
+			std::vector<int>& attributes = m_expression.m_attributes;
+			int input = (int)(std::find(attributes.begin(), attributes.end(), i) - attributes.begin());
+			if (input == (int)attributes.size())
+				attributes.push_back(i);
+			return Emit(ExportExpression::OpLoad, input, -1, width);
+		}
+		return Fail("no attribute \"" + name + "\"");
+	}
+
+	const std::string& m_text;
+	size_t m_pos;
+	ParticleSource& m_source;
+	ExportExpression& m_expression;
+	std::string m_error;
+};
+
+namespace
+{
+	struct Add      { double operator()(double a, double b) const { return a + b; } };
+	struct Subtract { double operator()(double a, double b) const { return a - b; } };
+	struct Multiply { double operator()(double a, double b) const { return a * b; } };
+	struct Divide   { double operator()(double a, double b) const { return a / b; } };
+	struct Modulo   { double operator()(double a, double b) const { return fmod(a, b); } };
+	struct Less         { double operator()(double a, double b) const { return a < b ? 1.0 : 0.0; } };
+	struct LessEqual    { double operator()(double a, double b) const { return a <= b ? 1.0 : 0.0; } };
+	struct Greater      { double operator()(double a, double b) const { return a > b ? 1.0 : 0.0; } };
+	struct GreaterEqual { double operator()(double a, double b) const { return a >= b ? 1.0 : 0.0; } };
+	struct Equal        { double operator()(double a, double b) const { return a == b ? 1.0 : 0.0; } };
+	struct NotEqual     { double operator()(double a, double b) const { return a != b ? 1.0 : 0.0; } };
+	struct And          { double operator()(double a, double b) const { return a != 0.0 && b != 0.0 ? 1.0 : 0.0; } };
+	struct Or           { double operator()(double a, double b) const { return a != 0.0 || b != 0.0 ? 1.0 : 0.0; } };
+	struct Negate { double operator()(double a) const { return -a; } };
+	struct Not    { double operator()(double a) const { return a == 0.0 ? 1.0 : 0.0; } };
+	struct Abs    { double operator()(double a) const { return fabs(a); } };
+	struct Sqrt   { double operator()(double a) const { return sqrt(a); } };
+	struct Floor  { double operator()(double a) const { return floor(a); } };
+
+	// a scalar operand is applied to every component of the other one
+	template <typename Fn>
+	void BinaryLoop(const double* a, int widthA, const double* b, int widthB, double* result, int count, Fn fn)
+	{
+		if (widthA == widthB)
+		{
+			for (int i=0; i < count * widthA; i++)
+				result[i] = fn(a[i], b[i]);
+		}
+		else if (widthA == 1)
+		{
+			for (int i=0; i < count; i++)
+				for (int c=0; c < widthB; c++)
+					result[i*widthB + c] = fn(a[i], b[i*widthB + c]);
+		}
+		else
+		{
+			for (int i=0; i < count; i++)
+				for (int c=0; c < widthA; c++)
+					result[i*widthA + c] = fn(a[i*widthA + c], b[i]);
+		}
+	}
+
+	template <typename Fn>
+	void UnaryLoop(const double* a, double* result, int values, Fn fn)
+	{
+		for (int i=0; i < values; i++)
+			result[i] = fn(a[i]);
+	}
+
+	// ints and floats are both exact as doubles, quaternions stored w first are read x,y,z,w
+	void LoadInput(const ParticleDataArray& data, const unsigned int* selection, int begin, int count, int width, double* result)
+	{
+		const char* base = (const char*)data.Data;
+		const int components = std::min(width, data.Components);
+		const int shift = data.WXYZ && components == 4 ? 1 : 0;
+		for (int i=0; i < count; i++)
+		{
+			const size_t particle = selection != NULL ? selection[begin + i] : size_t(begin + i);
+			const char* src = base + particle * data.Stride;
+			double* dst = result + i*width;
+			if (data.Int)
+			{
+				for (int c=0; c < components; c++)
+					dst[c] = ((const int*)src)[(c + shift) % 4];
+			}
+			else
+			{
+				for (int c=0; c < components; c++)
+					dst[c] = ((const float*)src)[(c + shift) % 4];
+			}
+			for (int c=components; c < width; c++)
+				dst[c] = 0.0;
+		}
+	}
+
+	// copies particles [begin, end) of selection
+	void CopySelected(const char* src, size_t stride, size_t elementSize, const unsigned int* selection, int begin, int end, char* dst)
+	{
+		for (int i=begin; i < end; i++)
+		{
+			memcpy(dst + i*elementSize, src + selection[i]*stride, elementSize);
+		}
+	}
+
+	void GatherTables(const unsigned int* first, const unsigned int* counts, const unsigned int* selection, int begin, int end, unsigned int* firstOut, unsigned int* countsOut)
+	{
+		for (int i=begin; i < end; i++)
+		{
+			firstOut[i] = first[selection[i]];
+			countsOut[i] = counts[selection[i]];
+		}
+	}
+}
+
+ExportExpression::ExportExpression()
+	: m_result(-1), m_width(0)
+{
+}
+
+std::string ExportExpression::Compile(const std::string& text, ParticleSource& source)
+{
+	*this = ExportExpression();
+	m_text = text;
+	std::string error = ExpressionParser(m_text, source, *this).Parse();
+	if (!error.empty())
+		*this = ExportExpression();
+	return error;
+}
+
+void ExportExpression::Run(const std::vector<ParticleDataArray>& inputs, const unsigned int* selection, int begin, int count, std::vector<double>& registers) const
+{
+	const size_t registerSize = 4 * blockSize;
+	for (size_t i=0; i < m_program.size(); i++)
+	{
+		const Instruction& instruction = m_program[i];
+		double* result = &registers[instruction.Result * registerSize];
+		const double* a = instruction.A >= 0 && instruction.Op != OpLoad ? &registers[instruction.A * registerSize] : NULL;
+		const double* b = instruction.B >= 0 ? &registers[instruction.B * registerSize] : NULL;
+		const int widthA = a != NULL ? m_registerWidths[instruction.A] : 0;
+		const int widthB = b != NULL ? m_registerWidths[instruction.B] : 0;
+		const int values = count * instruction.Width;
+
+		switch (instruction.Op)
+		{
+		case OpLoad:
+			LoadInput(inputs[instruction.A], selection, begin, count, instruction.Width, result);
+			break;
+		case OpConstant:
+			std::fill(result, result + count, instruction.Value);
+			break;
+		case OpComponent:
+			for (int p=0; p < count; p++)
+				result[p] = a[p*widthA + instruction.Component];
+			break;
+		case OpAdd:          BinaryLoop(a, widthA, b, widthB, result, count, Add()); break;
+		case OpSubtract:     BinaryLoop(a, widthA, b, widthB, result, count, Subtract()); break;
+		case OpMultiply:     BinaryLoop(a, widthA, b, widthB, result, count, Multiply()); break;
+		case OpDivide:       BinaryLoop(a, widthA, b, widthB, result, count, Divide()); break;
+		case OpModulo:       BinaryLoop(a, widthA, b, widthB, result, count, Modulo()); break;
+		case OpLess:         BinaryLoop(a, 1, b, 1, result, count, Less()); break;
+		case OpLessEqual:    BinaryLoop(a, 1, b, 1, result, count, LessEqual()); break;
+		case OpGreater:      BinaryLoop(a, 1, b, 1, result, count, Greater()); break;
+		case OpGreaterEqual: BinaryLoop(a, 1, b, 1, result, count, GreaterEqual()); break;
+		case OpEqual:        BinaryLoop(a, 1, b, 1, result, count, Equal()); break;
+		case OpNotEqual:     BinaryLoop(a, 1, b, 1, result, count, NotEqual()); break;
+		case OpAnd:          BinaryLoop(a, 1, b, 1, result, count, And()); break;
+		case OpOr:           BinaryLoop(a, 1, b, 1, result, count, Or()); break;
+		case OpNegate:       UnaryLoop(a, result, values, Negate()); break;
+		case OpNot:          UnaryLoop(a, result, values, Not()); break;
+		case OpAbs:          UnaryLoop(a, result, values, Abs()); break;
+		case OpSqrt:         UnaryLoop(a, result, values, Sqrt()); break;
+		case OpFloor:        UnaryLoop(a, result, values, Floor()); break;
+		case OpLength:
+			for (int p=0; p < count; p++)
+			{
+				double sum = 0.0;
+				for (int c=0; c < widthA; c++)
+					sum += a[p*widthA + c] * a[p*widthA + c];
+				result[p] = sqrt(sum);
+			}
+			break;
+		}
+	}
+}
+
+void ExportExpression::Evaluate(const std::vector<ParticleDataArray>& inputs, const unsigned int* selection, int begin, int end, float* out) const
+{
+	std::vector<double> registers(m_registerWidths.size() * 4 * blockSize);
+	const double* result = &registers[m_result * 4 * blockSize];
+	for (int blockBegin=begin; blockBegin < end; blockBegin += blockSize)
+	{
+		const int count = std::min(blockSize, end - blockBegin);
+		Run(inputs, selection, blockBegin, count, registers);
+		std::copy(result, result + count * m_width, out + size_t(blockBegin - begin) * m_width);
+	}
+}
+
+void ExportExpression::Select(const std::vector<ParticleDataArray>& inputs, int begin, int end, std::vector<unsigned int>& selection) const
+{
+	std::vector<double> registers(m_registerWidths.size() * 4 * blockSize);
+	const double* result = &registers[m_result * 4 * blockSize];
+	for (int blockBegin=begin; blockBegin < end; blockBegin += blockSize)
+	{
+		const int count = std::min(blockSize, end - blockBegin);
+		Run(inputs, NULL, blockBegin, count, registers);
+		for (int i=0; i < count; i++)
+		{
+			// the first component if it isn't a single value
+			const double value = result[i * m_width];
+			if (value != 0.0 && value == value)
+				selection.push_back(blockBegin + i);
+		}
+	}
+}
+
+ParticleDataArray SelectParticles(const ParticleDataArray& data, const std::vector<unsigned int>& selection)
+{
+	// constant data is the same for whatever is left
+	if (data.Stride == 0 || selection.empty())
+		return data;
+
+	static const int chunkSize = 64 * 1024;
+	const int count = (int)selection.size();
+	std::vector< std::function<void()> > tasks;
+	ParticleDataArray selected = data;
+
+	if (data.ArrayFirst != NULL)
+	{
+		std::shared_ptr< std::vector<unsigned int> > first(new std::vector<unsigned int>(count));
+		std::shared_ptr< std::vector<unsigned int> > counts(new std::vector<unsigned int>(count));
+		for (int begin=0; begin < count; begin += chunkSize)
+		{
+			tasks.push_back(std::bind(&GatherTables, data.ArrayFirst, data.ArrayCounts, &selection[0], begin, std::min(begin + chunkSize, count), &(*first)[0], &(*counts)[0]));
+		}
+		WorkerPool::Shared().Run(tasks);
+
+		std::shared_ptr< std::vector< std::shared_ptr<void> > > owners(new std::vector< std::shared_ptr<void> >());
+		owners->push_back(data.Owner);
+		owners->push_back(first);
+		owners->push_back(counts);
+		selected.ArrayFirst = &(*first)[0];
+		selected.ArrayCounts = &(*counts)[0];
+		selected.Owner = owners;
+		return selected;
+	}
+
+	const size_t elementSize = data.Components * sizeof(float); // ints and floats are both 4 bytes
+	std::shared_ptr< std::vector<float> > buffer(new std::vector<float>(size_t(count) * data.Components));
+	char* dst = (char*)&(*buffer)[0];
+	for (int begin=0; begin < count; begin += chunkSize)
+	{
+		tasks.push_back(std::bind(&CopySelected, (const char*)data.Data, data.Stride, elementSize, &selection[0], begin, std::min(begin + chunkSize, count), dst));
+	}
+	WorkerPool::Shared().Run(tasks);
+
+	selected.Data = dst;
+	selected.Stride = elementSize;
+	selected.Owner = buffer;
+	return selected;
+}
@@ -0,0 +1,105 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by James Vecore
+// james.vecore@gmail.com
+
+#ifndef PARTIO_EXPORT_EXPORT_EXPRESSION_H
+#define PARTIO_EXPORT_EXPORT_EXPRESSION_H
+
+#include <string>
+#include <vector>
+
+#include "ParticleSource.h"
+
+// A small per particle expression over the fetched attributes, for filter=... and channel=... (see ExportOptions.h).
+//
+//   Age < 2.0 && ID % 4 == 0
+//   length(PointVelocity)
+//   PointPosition.y * 2 - 1
+//
+// Values are numbers or vectors of up to 4 numbers, computed as doubles so int attributes (i.e. ID % 4 == 0 for IDs
+// past 2^24) and whole number constants are exact. Fractional constants are rounded to float like the float attributes
+// they're compared with, channel results are stored as floats. Operators are + - * / % (fmod) on values of the same
+// width or a value and a scalar, and < <= > >= == != && || ! on scalars, which give 1 or 0. Functions: length, abs, sqrt, floor. Components are .x .y .z .w (or .r .g .b .a).
+// Expressions can't contain commas, UserData is split on them.
+//
+// Compiling turns the text into a list of instructions over registers that each hold a block of particles, so
+// evaluating runs every instruction as a tight loop over the block instead of walking a tree per particle. Evaluate
+// and Select only read their inputs and can run on several threads at once.
+class ExportExpression
+{
+public:
+	ExportExpression();
+
+	// resolves attribute names through source, only per point attributes of at most 4 components can be read.
+	// Returns an empty string on success, otherwise an error message.
+	std::string Compile(const std::string& text, ParticleSource& source);
+
+	const std::string& GetText() const { return m_text; }
+	int GetWidth() const { return m_width; } // components of the result, 1 to 4
+	const std::vector<int>& GetAttributes() const { return m_attributes; } // the source attributes it reads
+
+	// Evaluates particles [begin, end) into out, GetWidth() floats per particle. inputs holds the fetched data of
+	// GetAttributes(). With a selection, particle i is selection[i] of the inputs.
+	void Evaluate(const std::vector<ParticleDataArray>& inputs, const unsigned int* selection, int begin, int end, float* out) const;
+
+	// appends the particles of [begin, end) the expression isn't 0 for to selection (NaN counts as 0)
+	void Select(const std::vector<ParticleDataArray>& inputs, int begin, int end, std::vector<unsigned int>& selection) const;
+
+private:
+	friend class ExpressionParser;
+
+	enum Operation
+	{
+		OpLoad, OpConstant, OpComponent,
+		OpAdd, OpSubtract, OpMultiply, OpDivide, OpModulo,
+		OpLess, OpLessEqual, OpGreater, OpGreaterEqual, OpEqual, OpNotEqual, OpAnd, OpOr,
+		OpNegate, OpNot, OpAbs, OpSqrt, OpFloor, OpLength
+	};
+
+	struct Instruction
+	{
+		Operation Op;
+		int Result; // register
+		int A;      // registers of the operands, or the input of a load
+		int B;
+		int Width;  // of the result
+		int Component;
+		double Value;
+	};
+
+	void Run(const std::vector<ParticleDataArray>& inputs, const unsigned int* selection, int begin, int count, std::vector<double>& registers) const;
+
+	std::string m_text;
+	std::vector<Instruction> m_program;
+	std::vector<int> m_registerWidths;
+	std::vector<int> m_attributes;
+	int m_result;
+	int m_width;
+};
+
+// the particles of data listed in selection, in that order. Per point arrays keep their elements and only get new
+// element tables. The copy is split over the pool.
+ParticleDataArray SelectParticles(const ParticleDataArray& data, const std::vector<unsigned int>& selection);
+
+#endif
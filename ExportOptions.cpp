@@ -0,0 +1,245 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "ExportOptions.h"
+
+#include <cstdlib>
+#include <sstream>
+#include <algorithm>
+
+namespace
+{
+	const int defaultStreamChunkSize = 1024 * 1024;
+	const int defaultGridResolution = 16;
+	const int defaultArraySize = 8;
+
+	std::string Trim(const std::string& s)
+	{
+		size_t begin = s.find_first_not_of(" \t");
+		if (begin == std::string::npos)
+			return std::string();
+		size_t end = s.find_last_not_of(" \t");
+		return s.substr(begin, end - begin + 1);
+	}
+
+	std::string Lower(std::string s)
+	{
+		std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+		return s;
+	}
+
+	bool ParseInt(const std::string& value, int& result)
+	{
+		char* end = NULL;
+		long parsed = strtol(value.c_str(), &end, 10);
+		if (value.empty() || *end != '\0')
+			return false;
+		result = (int)parsed;
+		return true;
+	}
+
+	bool ParseCompressionLevel(const std::string& value, int& level)
+	{
+		if (value == "fast")
+		{
+			level = 1;
+			return true;
+		}
+		return ParseInt(value, level) && level >= 0 && level <= 9;
+	}
+
+	int DefaultCompressionLevel()
+	{
+		const char* env = getenv("PARTIO_EXPORT_COMPRESSION_LEVEL");
+		int level;
+		if (env != NULL && ParseCompressionLevel(env, level))
+			return level;
+		return -1;
+	}
+}
+
+ExportOptions::ExportOptions()
+	: Compress(CompressionDefault), CompressionLevel(DefaultCompressionLevel()), HalfPrecision(false), BufferSize(0), MappedWrites(true), Rotation(RotationNative), ArrayMode(ArraysOff), ArraySize(defaultArraySize), Delta(false), StreamChunkSize(0), Sort(SpatialOrderNone), GridResolution(defaultGridResolution), SplitCount(1), SplitBy(SplitByTile), SkipUnchanged(false), Profile(false)
+{
+}
+
+void ParseExportOptions(const std::string& userData, ExportOptions& options)
+{
+	std::stringstream ss(userData);
+	std::string item;
+	while (std::getline(ss, item, ','))
+	{
+		size_t equalsPos = item.find('=');
+		if (equalsPos == std::string::npos)
+		{
+			options.Channels.push_back(item);
+			continue;
+		}
+
+		std::string key = Lower(Trim(item.substr(0, equalsPos)));
+		std::string value = Lower(Trim(item.substr(equalsPos + 1)));
+		bool valid = true;
+		int intValue;
+
+		if (key == "compress")
+		{
+			valid = value == "on" || value == "off";
+			if (valid)
+				options.Compress = value == "on" ? ExportOptions::CompressionOn : ExportOptions::CompressionOff;
+		}
+		else if (key == "level")
+		{
+			valid = ParseCompressionLevel(value, intValue);
+			if (valid)
+				options.CompressionLevel = intValue;
+		}
+		else if (key == "precision")
+		{
+			valid = value == "full" || value == "half";
+			if (valid)
+				options.HalfPrecision = value == "half";
+		}
+		else if (key == "half")
+		{
+			// channel names are case sensitive, take them from the untouched item
+			std::string channel = Trim(item.substr(equalsPos + 1));
+			valid = !channel.empty();
+			if (valid)
+				options.HalfChannels.push_back(channel);
+		}
+		else if (key == "buffer")
+		{
+			valid = ParseInt(value, intValue) && intValue >= 0;
+			if (valid)
+				options.BufferSize = size_t(intValue) * 1024;
+		}
+		else if (key == "mmap")
+		{
+			valid = value == "on" || value == "off";
+			if (valid)
+				options.MappedWrites = value == "on";
+		}
+		else if (key == "rotation")
+		{
+			valid = ParseRotationConvention(value, options.Rotation);
+		}
+		else if (key == "arrays")
+		{
+			valid = value == "off" || value == "fixed" || value == "indexed";
+			if (valid)
+				options.ArrayMode = value == "fixed" ? ExportOptions::ArraysFixed : (value == "indexed" ? ExportOptions::ArraysIndexed : ExportOptions::ArraysOff);
+		}
+		else if (key == "arraysize")
+		{
+			valid = ParseInt(value, intValue) && intValue >= 1 && intValue <= 1024;
+			if (valid)
+				options.ArraySize = intValue;
+		}
+		else if (key == "filter")
+		{
+			// attribute names are case sensitive, take the expression from the untouched item
+			std::string expression = Trim(item.substr(equalsPos + 1));
+			valid = !expression.empty();
+			if (valid)
+				options.Filters.push_back(expression);
+		}
+		else if (key == "channel")
+		{
+			std::string definition = item.substr(equalsPos + 1);
+			size_t nameEnd = definition.find('=');
+			ExportOptions::DerivedChannel channel;
+			if (nameEnd != std::string::npos)
+			{
+				channel.Name = Trim(definition.substr(0, nameEnd));
+				channel.Expression = Trim(definition.substr(nameEnd + 1));
+			}
+			valid = !channel.Name.empty() && !channel.Expression.empty();
+			if (valid)
+				options.DerivedChannels.push_back(channel);
+		}
+		else if (key == "delta")
+		{
+			valid = value == "on" || value == "off";
+			if (valid)
+				options.Delta = value == "on";
+		}
+		else if (key == "stream")
+		{
+			valid = value == "on" || value == "off" || (ParseInt(value, intValue) && intValue >= 0);
+			if (valid)
+				options.StreamChunkSize = value == "on" ? defaultStreamChunkSize : (value == "off" ? 0 : intValue);
+		}
+		else if (key == "sort")
+		{
+			valid = value == "off" || value == "morton" || value == "hilbert";
+			if (valid)
+				options.Sort = value == "morton" ? SpatialOrderMorton : (value == "hilbert" ? SpatialOrderHilbert : SpatialOrderNone);
+		}
+		else if (key == "grid")
+		{
+			valid = ParseInt(value, intValue) && intValue >= 1 && intValue <= 1024 && (intValue & (intValue - 1)) == 0;
+			if (valid)
+				options.GridResolution = intValue;
+		}
+		else if (key == "split")
+		{
+			valid = ParseInt(value, intValue) && intValue >= 1 && intValue <= 1024;
+			if (valid)
+				options.SplitCount = intValue;
+		}
+		else if (key == "splitby")
+		{
+			valid = value == "tile" || value == "id";
+			if (valid)
+				options.SplitBy = value == "id" ? ExportOptions::SplitById : ExportOptions::SplitByTile;
+		}
+		else if (key == "skip")
+		{
+			valid = value == "on" || value == "off";
+			if (valid)
+				options.SkipUnchanged = value == "on";
+		}
+		else if (key == "profile")
+		{
+			valid = value == "on" || value == "off";
+			if (valid)
+				options.Profile = value == "on";
+		}
+		else if (key == "trace")
+		{
+			// file names keep their case
+			std::string fileName = Trim(item.substr(equalsPos + 1));
+			valid = !fileName.empty();
+			if (valid)
+				options.TraceFile = fileName;
+		}
+		else
+		{
+			options.Warnings.push_back("Ignoring unknown export option: \"" + Trim(item) + "\"");
+			continue;
+		}
+
+		if (!valid)
+			options.Warnings.push_back("Ignoring export option with invalid value: \"" + Trim(item) + "\"");
+	}
+}
@@ -0,0 +1,132 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef PARTIO_EXPORT_EXPORT_OPTIONS_H
+#define PARTIO_EXPORT_EXPORT_OPTIONS_H
+
+#include <string>
+#include <vector>
+
+#include "SpatialSort.h"
+#include "Rotation.h"
+
+// Options carried in the UserData string of the export callbacks.
+//
+// UserData has always been a comma separated list of channels to export (that is what the cache manager puts there),
+// entries of the form key=value are now taken as options instead, i.e. "PointPosition,Color,compress=off,level=fast".
+//
+//   compress=on|off      on: let partio compress the formats it has a compressed variant for (i.e. gzipped bgeo)
+//                        off: also writes PRT data uncompressed (zlib level 0)
+//   level=0-9|fast       zlib level for PRT, fast is 1 (default from PARTIO_EXPORT_COMPRESSION_LEVEL or 6)
+//   precision=full|half  half writes all float channels at half precision
+//   half=<channel>       writes one channel at half precision, can be repeated (i.e. "half=Color,half=Age")
+//                        half precision channels are stored as 16 bit floats where the format supports it (PRT),
+//                        other formats store them as 32 bit floats rounded to the nearest half
+//   buffer=<KB>          output buffer size of the plugin's own writers (PRT)
+//   mmap=on|off          on (default): uncompressed PRT files are converted straight into a memory mapped file
+//                        (not sorted, split, streamed or half precision ones, verbose messages say why)
+//                        other formats always go through partio's writers
+//   rotation=<convention> how Quaternion and Rotation attributes are written: native (default, as ICE stores them),
+//                        xyzw, wxyz, axisangle (axis, angle) or euler<order> (eulerxyz, eulerzyx, ...), see Rotation.h
+//   arrays=off|fixed|indexed  how per point array attributes are written. off (default) skips them. fixed: <name> holds
+//                        the first arraysize elements of every particle, zero padded, and <name>Count how many are set.
+//                        indexed: <name>Offset and <name>Count point into a file with all elements (see ArrayFile.h)
+//   arraysize=<n>        elements per particle for arrays=fixed (1 to 1024, default 8)
+//   filter=<expression>  only exports the particles the expression is true (not 0) for, i.e. "filter=Age < 2" or
+//                        "filter=ID % 4 == 0". Can be repeated, particles have to pass every filter (see ExportExpression.h)
+//   channel=<name>=<expression>  adds a float channel computed from other attributes of each exported particle, i.e.
+//                        "channel=Speed=length(PointVelocity)". Can be repeated. Expressions can't contain commas
+//   delta=on|off         on: keeps each channel's converted data and only converts the chunks of particles whose ICE
+//                        data changed since the previous frame, files are still written complete
+//   stream=on|off|<n>    on: writes PRT files n particles at a time (default 1M) so only that many are ever held in
+//                        memory, for clouds that don't fit otherwise. Ignores delta, other formats are written whole
+//   sort=off|morton|hilbert  reorders the particles along a space filling curve through PointPosition and writes the
+//                        bounding box and a table of the particles in each grid cell next to the file (see SpatialSort.h)
+//   grid=<n>             cells per axis of that table, a power of two up to 1024 (default 16)
+//   split=<n>            writes every object as n files of about the same particle count (1 to 1024, default 1) and a
+//                        JSON manifest with their bounds next to them (see Partition.h)
+//   splitby=tile|id      tile: partitions are consecutive runs along the sort curve (hilbert unless sort says
+//                        otherwise), so each is a compact region of space. id: partitions are ranges of the ID channel
+//   skip=on|off          on: doesn't convert or write files whose data and settings hash the same as when they were
+//                        last written and that weren't changed since (see ExportCache.h). Ignored when streaming
+//   profile=on|off       logs how long each stage of every exported file took, and the totals of the run
+//   trace=<file>         also writes every stage to a Chrome trace file (implies profile=on)
+struct ExportOptions
+{
+	enum Compression
+	{
+		CompressionDefault,
+		CompressionOn,
+		CompressionOff
+	};
+
+	enum Split
+	{
+		SplitByTile,
+		SplitById
+	};
+
+	enum Arrays
+	{
+		ArraysOff,
+		ArraysFixed,
+		ArraysIndexed
+	};
+
+	struct DerivedChannel
+	{
+		std::string Name;
+		std::string Expression;
+	};
+
+	ExportOptions();
+
+	std::vector<std::string> Channels; // empty means all channels
+	Compression Compress;
+	int CompressionLevel; // -1 is zlib's default
+	bool HalfPrecision;
+	std::vector<std::string> HalfChannels; // ICE attribute names
+	size_t BufferSize; // bytes, 0 leaves the stdio default
+	bool MappedWrites;
+	RotationConvention Rotation;
+	Arrays ArrayMode;
+	int ArraySize; // elements per particle for arrays=fixed
+	std::vector<std::string> Filters; // expressions, all have to be true
+	std::vector<DerivedChannel> DerivedChannels;
+	bool Delta;
+	int StreamChunkSize; // particles, 0 disables streaming
+	SpatialOrder Sort;
+	int GridResolution;
+	int SplitCount; // 1 writes a single file
+	Split SplitBy;
+	bool SkipUnchanged;
+	bool Profile;
+	std::string TraceFile;
+
+	std::vector<std::string> Warnings; // unknown keys and bad values, reported by the caller
+};
+
+// parses a UserData string, anything not understood ends up in options.Warnings and is otherwise ignored
+void ParseExportOptions(const std::string& userData, ExportOptions& options);
+
+#endif
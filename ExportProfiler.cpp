@@ -0,0 +1,280 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by James Vecore
+// james.vecore@gmail.com
+
+
+
+#include "ExportProfiler.h"
+#include "Json.h"
+
+#include <sstream>
+#include <iomanip>
+
+static ExportProfiler* sharedProfiler = NULL;
+static std::mutex sharedProfilerMutex;
+
+static double Seconds(ExportProfiler::Clock::duration duration)
+{
+	return std::chrono::duration<double>(duration).count();
+}
+
+// i.e. "geometry 1.2 ms, fetch 10.5 ms, ..., 48.0 MB, 8.3 M particles/s"
+static std::string FormatStages(const double* stageSeconds, double particles, double bytes)
+{
+	std::ostringstream ss;
+	ss << std::fixed << std::setprecision(1);
+
+	double total = 0.0;
+	for (int i=0; i < ExportStageCount; i++)
+	{
+		ss << ExportProfiler::GetStageName((ExportStage)i) << " " << stageSeconds[i] * 1000.0 << " ms, ";
+		total += stageSeconds[i];
+	}
+	ss << bytes / (1024.0 * 1024.0) << " MB";
+	if (total > 0.0)
+		ss << ", " << particles / total / 1000000.0 << " M particles/s";
+	return ss.str();
+}
+
+static std::string FormatAttribute(const AttributeProfile& attr)
+{
+	std::ostringstream ss;
+	ss << std::fixed << std::setprecision(1);
+	ss << "    " << attr.Name << ": " << attr.Bytes / (1024.0 * 1024.0) << " MB, fetch " << attr.FetchSeconds * 1000.0 << " ms, convert " << attr.ConvertSeconds * 1000.0 << " ms";
+	return ss.str();
+}
+
+ExportProfiler::ExportProfiler()
+	: m_enabled(false), m_recordFrames(false), m_traceFile(NULL), m_traceEvents(0), m_epoch(Clock::now())
+{
+}
+
+ExportProfiler::~ExportProfiler()
+{
+	CloseTrace();
+}
+
+void ExportProfiler::Configure(bool enabled, const std::string& traceFile)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_enabled = enabled || !traceFile.empty();
+	if (traceFile == m_traceFileName)
+		return;
+
+	CloseTrace();
+	m_traceFileName = traceFile;
+	if (!m_traceFileName.empty())
+	{
+		m_traceFile = fopen(m_traceFileName.c_str(), "w");
+		if (m_traceFile != NULL)
+			fputs("[\n", m_traceFile);
+	}
+}
+
+std::shared_ptr<FrameProfile> ExportProfiler::BeginFrame(const std::string& target, const std::string& fileName)
+{
+	if (!m_enabled)
+		return std::shared_ptr<FrameProfile>();
+
+	std::shared_ptr<FrameProfile> frame(new FrameProfile);
+	frame->Target = target;
+	frame->FileName = fileName;
+	return frame;
+}
+
+void ExportProfiler::AddStage(FrameProfile* frame, ExportStage stage, Clock::time_point start, Clock::time_point end, int attribute)
+{
+	if (frame == NULL)
+		return;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	double seconds = Seconds(end - start);
+	frame->StageSeconds[stage] += seconds;
+
+	std::string name = GetStageName(stage);
+	if (attribute >= 0)
+	{
+		AttributeProfile& attr = frame->Attributes[attribute];
+		if (stage == ExportStageFetch)
+			attr.FetchSeconds += seconds;
+		else if (stage == ExportStageConvert)
+			attr.ConvertSeconds += seconds;
+		name += " " + attr.Name;
+	}
+
+	WriteTraceEvent(name, frame, start, end);
+}
+
+int ExportProfiler::AddAttribute(FrameProfile* frame, const std::string& name, size_t bytes)
+{
+	if (frame == NULL)
+		return -1;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	AttributeProfile attr = { name, bytes, 0.0, 0.0 };
+	frame->Attributes.push_back(attr);
+	frame->Bytes += bytes;
+	return (int)frame->Attributes.size() - 1;
+}
+
+void ExportProfiler::EndFrame(const std::shared_ptr<FrameProfile>& frame)
+{
+	if (!frame)
+		return;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_finished.push_back(frame);
+}
+
+void ExportProfiler::LogFinishedFrames(ExportLog& log)
+{
+	std::vector< std::shared_ptr<FrameProfile> > finished;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		finished.swap(m_finished);
+		if (m_traceFile != NULL)
+			fflush(m_traceFile);
+		if (m_recordFrames)
+			m_recorded.insert(m_recorded.end(), finished.begin(), finished.end());
+	}
+
+	for (size_t i=0; i < finished.size(); i++)
+	{
+		const FrameProfile& frame = *finished[i];
+
+		std::ostringstream ss;
+		ss << "Profile " << frame.FileName << ": " << frame.Particles << " particles, " << FormatStages(frame.StageSeconds, frame.Particles, (double)frame.Bytes);
+		log.Log(ss.str(), ExportLogInfo);
+
+		m_totals.Frames++;
+		m_totals.Particles += frame.Particles;
+		m_totals.Bytes += frame.Bytes;
+		for (int s=0; s < ExportStageCount; s++)
+		{
+			m_totals.StageSeconds[s] += frame.StageSeconds[s];
+		}
+
+		for (size_t a=0; a < frame.Attributes.size(); a++)
+		{
+			const AttributeProfile& attr = frame.Attributes[a];
+			log.Log(FormatAttribute(attr), ExportLogVerbose);
+
+			AttributeProfile& total = m_totals.Attributes[attr.Name];
+			total.Name = attr.Name;
+			total.Bytes += attr.Bytes;
+			total.FetchSeconds += attr.FetchSeconds;
+			total.ConvertSeconds += attr.ConvertSeconds;
+		}
+	}
+}
+
+void ExportProfiler::SetRecordFrames(bool record)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_recordFrames = record;
+	if (!record)
+		m_recorded.clear();
+}
+
+void ExportProfiler::TakeRecordedFrames(std::vector< std::shared_ptr<FrameProfile> >& frames)
+{
+	frames.clear();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	frames.swap(m_recorded);
+}
+
+void ExportProfiler::EndRun(ExportLog& log)
+{
+	LogFinishedFrames(log);
+
+	if (m_totals.Frames > 0)
+	{
+		std::ostringstream ss;
+		ss << std::fixed << std::setprecision(0);
+		ss << "Profile total: " << m_totals.Frames << " files, " << m_totals.Particles << " particles, " << FormatStages(m_totals.StageSeconds, m_totals.Particles, m_totals.Bytes);
+		log.Log(ss.str(), ExportLogInfo);
+
+		for (std::map<std::string, AttributeProfile>::const_iterator iter = m_totals.Attributes.begin(); iter != m_totals.Attributes.end(); ++iter)
+		{
+			log.Log(FormatAttribute(iter->second), ExportLogInfo);
+		}
+	}
+
+	m_totals = RunTotals();
+}
+
+ExportProfiler& ExportProfiler::Shared()
+{
+	std::lock_guard<std::mutex> lock(sharedProfilerMutex);
+	if (sharedProfiler == NULL)
+		sharedProfiler = new ExportProfiler();
+	return *sharedProfiler;
+}
+
+void ExportProfiler::ShutdownShared()
+{
+	std::lock_guard<std::mutex> lock(sharedProfilerMutex);
+	delete sharedProfiler;
+	sharedProfiler = NULL;
+}
+
+const char* ExportProfiler::GetStageName(ExportStage stage)
+{
+	static const char* names[ExportStageCount] = { "geometry", "fetch", "filter", "plan", "allocate", "convert", "sort", "write" };
+	return names[stage];
+}
+
+// called with m_mutex held
+void ExportProfiler::WriteTraceEvent(const std::string& name, const FrameProfile* frame, Clock::time_point start, Clock::time_point end)
+{
+	if (m_traceFile == NULL)
+		return;
+
+	std::map<std::thread::id, int>::iterator thread = m_threadIds.find(std::this_thread::get_id());
+	if (thread == m_threadIds.end())
+		thread = m_threadIds.insert(std::make_pair(std::this_thread::get_id(), (int)m_threadIds.size())).first;
+
+	long long ts = std::chrono::duration_cast<std::chrono::microseconds>(start - m_epoch).count();
+	long long dur = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+	fprintf(m_traceFile, "%s{\"name\":\"%s\",\"cat\":\"export\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%lld,\"dur\":%lld,\"args\":{\"target\":\"%s\",\"file\":\"%s\",\"particles\":%d}}\n",
+		m_traceEvents == 0 ? "" : ",", JsonEscape(name).c_str(), thread->second, ts, dur, JsonEscape(frame->Target).c_str(), JsonEscape(frame->FileName).c_str(), frame->Particles);
+	m_traceEvents++;
+}
+
+// called with m_mutex held
+void ExportProfiler::CloseTrace()
+{
+	if (m_traceFile != NULL)
+	{
+		fputs("]\n", m_traceFile);
+		fclose(m_traceFile);
+	}
+	m_traceFile = NULL;
+	m_traceEvents = 0;
+}
@@ -0,0 +1,179 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by James Vecore
+// james.vecore@gmail.com
+
+
+
+#ifndef PARTIO_EXPORT_EXPORT_PROFILER_H
+#define PARTIO_EXPORT_EXPORT_PROFILER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <cstdio>
+
+#include "ParticleSource.h"
+
+enum ExportStage
+{
+	ExportStageGeometry, // loading the object (GetGeometry)
+	ExportStageFetch,    // fetching the attribute data (GetDataArray)
+	ExportStageFilter,   // filter= and channel= expressions
+	ExportStagePlan,
+	ExportStageAllocate, // getting the partio particle set ready
+	ExportStageConvert,  // summed over the worker threads
+	ExportStageSort,     // sort=morton|hilbert, on the write thread
+	ExportStageWrite,
+	ExportStageCount
+};
+
+struct AttributeProfile
+{
+	std::string Name;
+	size_t Bytes;
+	double FetchSeconds;
+	double ConvertSeconds;
+};
+
+// timings of one exported file
+struct FrameProfile
+{
+	FrameProfile() : Particles(0), Bytes(0)
+	{
+		for (int i=0; i < ExportStageCount; i++)
+			StageSeconds[i] = 0.0;
+	}
+
+	std::string Target;
+	std::string FileName;
+	int Particles;
+	size_t Bytes; // converted data handed to the writer
+	double StageSeconds[ExportStageCount];
+	std::vector<AttributeProfile> Attributes;
+};
+
+// Stage timing for the export (profile=on, see ExportOptions.h). Stages are timed with a clock read at both ends, when
+// profiling is off every call returns right away. Frames are finished on the write threads, so their summaries are
+// only logged from the main thread by LogFinishedFrames(). With a trace file every stage is also streamed to it as a
+// Chrome trace event (chrome://tracing, Perfetto), one track per thread.
+class ExportProfiler
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	ExportProfiler();
+	~ExportProfiler();
+
+	// a trace file implies profiling, changing anything ends the current run (see EndRun)
+	void Configure(bool enabled, const std::string& traceFile);
+	bool IsEnabled() const { return m_enabled; }
+
+	// returns NULL when profiling is off, pass that along to the other calls
+	std::shared_ptr<FrameProfile> BeginFrame(const std::string& target, const std::string& fileName);
+	// attribute is the index of an attribute added with AddAttribute, or -1
+	void AddStage(FrameProfile* frame, ExportStage stage, Clock::time_point start, Clock::time_point end, int attribute = -1);
+	int AddAttribute(FrameProfile* frame, const std::string& name, size_t bytes);
+	void EndFrame(const std::shared_ptr<FrameProfile>& frame); // safe to call from any thread
+
+	// logs the summary of every frame finished since the last call and adds them to the run totals
+	void LogFinishedFrames(ExportLog& log);
+
+	// keeps every frame logged from now on until TakeRecordedFrames() hands them out, i.e. for a benchmark
+	void SetRecordFrames(bool record);
+	void TakeRecordedFrames(std::vector< std::shared_ptr<FrameProfile> >& frames);
+	// logs the totals of all frames since the last EndRun and resets them
+	void EndRun(ExportLog& log);
+
+	static ExportProfiler& Shared();
+	static void ShutdownShared();
+
+	static const char* GetStageName(ExportStage stage);
+
+private:
+	ExportProfiler(const ExportProfiler&);
+	ExportProfiler& operator=(const ExportProfiler&);
+
+	void WriteTraceEvent(const std::string& name, const FrameProfile* frame, Clock::time_point start, Clock::time_point end);
+	void CloseTrace();
+
+	struct RunTotals
+	{
+		RunTotals() : Frames(0), Particles(0), Bytes(0)
+		{
+			for (int i=0; i < ExportStageCount; i++)
+				StageSeconds[i] = 0.0;
+		}
+
+		int Frames;
+		double Particles;
+		double Bytes;
+		double StageSeconds[ExportStageCount];
+		std::map<std::string, AttributeProfile> Attributes;
+	};
+
+	bool m_enabled;
+	bool m_recordFrames;
+	std::string m_traceFileName;
+	FILE* m_traceFile;
+	int m_traceEvents;
+	Clock::time_point m_epoch;
+	std::map<std::thread::id, int> m_threadIds;
+	std::vector< std::shared_ptr<FrameProfile> > m_finished;
+	std::vector< std::shared_ptr<FrameProfile> > m_recorded;
+	RunTotals m_totals;
+	std::mutex m_mutex;
+};
+
+// times one stage from construction to destruction
+class ScopedStageTimer
+{
+public:
+	ScopedStageTimer(FrameProfile* frame, ExportStage stage, int attribute = -1)
+		: m_frame(frame), m_stage(stage), m_attribute(attribute)
+	{
+		if (m_frame != NULL)
+			m_start = ExportProfiler::Clock::now();
+	}
+
+	~ScopedStageTimer()
+	{
+		if (m_frame != NULL)
+			ExportProfiler::Shared().AddStage(m_frame, m_stage, m_start, ExportProfiler::Clock::now(), m_attribute);
+	}
+
+private:
+	ScopedStageTimer(const ScopedStageTimer&);
+	ScopedStageTimer& operator=(const ScopedStageTimer&);
+
+	FrameProfile* m_frame;
+	ExportStage m_stage;
+	int m_attribute;
+	ExportProfiler::Clock::time_point m_start;
+};
+
+#endif
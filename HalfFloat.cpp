@@ -0,0 +1,136 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "HalfFloat.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PARTIO_EXPORT_F16C
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#ifdef PARTIO_EXPORT_F16C
+
+// gcc and clang only emit the instructions for functions marked with the target, msvc always can
+#if defined(__GNUC__)
+#define F16C_TARGET __attribute__((target("avx,f16c")))
+#else
+#define F16C_TARGET
+#endif
+
+static bool DetectF16C()
+{
+	int info[4] = { 0, 0, 0, 0 };
+#ifdef _MSC_VER
+	__cpuid(info, 1);
+#else
+	__cpuid(1, info[0], info[1], info[2], info[3]);
+#endif
+	const bool f16c = (info[2] & (1 << 29)) != 0;
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	if (!f16c || !osxsave)
+		return false;
+
+	// the instructions are vex encoded, the os has to save the avx state for them to be usable
+#ifdef _MSC_VER
+	unsigned long long xcr0 = _xgetbv(0);
+#else
+	unsigned int eax, edx;
+	__asm__ ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	unsigned long long xcr0 = ((unsigned long long)edx << 32) | eax;
+#endif
+	return (xcr0 & 6) == 6;
+}
+
+F16C_TARGET static void FloatsToHalfsF16C(const float* src, unsigned short* dst, size_t count)
+{
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i halfs = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+		_mm_storeu_si128((__m128i*)(dst + i), halfs);
+	}
+	for (; i < count; i++)
+	{
+		dst[i] = FloatToHalf(src[i]);
+	}
+}
+
+F16C_TARGET static void RoundFloatsToHalfF16C(float* values, size_t count)
+{
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i halfs = _mm256_cvtps_ph(_mm256_loadu_ps(values + i), _MM_FROUND_TO_NEAREST_INT);
+		_mm256_storeu_ps(values + i, _mm256_cvtph_ps(halfs));
+	}
+	for (; i < count; i++)
+	{
+		values[i] = HalfToFloat(FloatToHalf(values[i]));
+	}
+}
+
+bool HasF16C()
+{
+	static const bool hasF16C = DetectF16C();
+	return hasF16C;
+}
+
+#else
+
+bool HasF16C()
+{
+	return false;
+}
+
+#endif
+
+void FloatsToHalfs(const float* src, unsigned short* dst, size_t count)
+{
+#ifdef PARTIO_EXPORT_F16C
+	if (HasF16C())
+		return FloatsToHalfsF16C(src, dst, count);
+#endif
+
+	for (size_t i=0; i < count; i++)
+	{
+		dst[i] = FloatToHalf(src[i]);
+	}
+}
+
+void RoundFloatsToHalf(float* values, size_t count)
+{
+#ifdef PARTIO_EXPORT_F16C
+	if (HasF16C())
+		return RoundFloatsToHalfF16C(values, count);
+#endif
+
+	for (size_t i=0; i < count; i++)
+	{
+		values[i] = HalfToFloat(FloatToHalf(values[i]));
+	}
+}
@@ -0,0 +1,102 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef PARTIO_EXPORT_HALF_FLOAT_H
+#define PARTIO_EXPORT_HALF_FLOAT_H
+
+#include <cstring>
+
+// IEEE 754 binary16 conversion with round to nearest even, the same results as the F16C instructions (NaNs keep the
+// top of their payload and become quiet). Based on Fabian Giesen's float_to_half_fast3_rtne.
+inline unsigned short FloatToHalf(float value)
+{
+	unsigned int f;
+	memcpy(&f, &value, sizeof(f));
+
+	const unsigned int sign = f & 0x80000000u;
+	f ^= sign;
+
+	unsigned int h;
+	if (f >= 0x47800000u) // 65536 and up, inf or nan
+	{
+		h = f > 0x7f800000u ? (0x7e00u | ((f >> 13) & 0x3ffu)) : 0x7c00u;
+	}
+	else if (f < 0x38800000u) // below the smallest normal half, let the fpu do the rounding into the subnormal range
+	{
+		const unsigned int denormMagicBits = ((127 - 15) + (23 - 10) + 1) << 23;
+		float denormMagic, magnitude;
+		memcpy(&denormMagic, &denormMagicBits, sizeof(float));
+		memcpy(&magnitude, &f, sizeof(float));
+		magnitude += denormMagic;
+		memcpy(&f, &magnitude, sizeof(float));
+		h = f - denormMagicBits;
+	}
+	else
+	{
+		const unsigned int mantissaOdd = (f >> 13) & 1;
+		f += ((unsigned int)(15 - 127) << 23) + 0xfffu; // rebias the exponent and round, carries into the exponent
+		f += mantissaOdd;                               // (and on to inf) when the mantissa overflows
+		h = f >> 13;
+	}
+
+	return (unsigned short)(h | (sign >> 16));
+}
+
+inline float HalfToFloat(unsigned short value)
+{
+	const unsigned int sign = (unsigned int)(value & 0x8000u) << 16;
+	const unsigned int exponent = (value >> 10) & 0x1fu;
+	const unsigned int mantissa = value & 0x3ffu;
+
+	unsigned int f;
+	if (exponent == 0x1f) // inf or nan, nans come out quiet like they do from F16C
+	{
+		f = sign | 0x7f800000u | (mantissa << 13) | (mantissa != 0 ? 0x400000u : 0);
+	}
+	else if (exponent == 0) // zero or subnormal, exact in float
+	{
+		float magnitude = (float)mantissa * (1.0f / 16777216.0f);
+		memcpy(&f, &magnitude, sizeof(f));
+		f |= sign;
+	}
+	else
+	{
+		f = sign | ((exponent + (127 - 15)) << 23) | (mantissa << 13);
+	}
+
+	float result;
+	memcpy(&result, &f, sizeof(result));
+	return result;
+}
+
+// Array versions, these use the F16C instructions when the cpu has them and the scalar code above otherwise. Both
+// give bit identical results.
+void FloatsToHalfs(const float* src, unsigned short* dst, size_t count);
+
+// rounds floats to the nearest value representable as a half, for formats that can only store 32 bit floats this
+// gives the same values as half storage and the zeroed low mantissa bits compress a lot better
+void RoundFloatsToHalf(float* values, size_t count);
+
+bool HasF16C();
+
+#endif
@@ -0,0 +1,130 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "Hash.h"
+
+#include <cstring>
+
+namespace
+{
+	const HashValue prime1 = 0x9E3779B185EBCA87ULL;
+	const HashValue prime2 = 0xC2B2AE3D27D4EB4FULL;
+	const HashValue prime3 = 0x165667B19E3779F9ULL;
+	const HashValue prime4 = 0x85EBCA77C2B2AE63ULL;
+	const HashValue prime5 = 0x27D4EB2F165667C5ULL;
+
+	inline HashValue RotateLeft(HashValue value, int bits)
+	{
+		return (value << bits) | (value >> (64 - bits));
+	}
+
+	// xxhash is defined on little endian reads, which is what every platform softimage runs on does
+	inline HashValue Read64(const unsigned char* p)
+	{
+		HashValue value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	inline HashValue Read32(const unsigned char* p)
+	{
+		unsigned int value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	inline HashValue Round(HashValue acc, HashValue input)
+	{
+		acc += input * prime2;
+		acc = RotateLeft(acc, 31);
+		return acc * prime1;
+	}
+
+	inline HashValue MergeRound(HashValue acc, HashValue value)
+	{
+		acc ^= Round(0, value);
+		return acc * prime1 + prime4;
+	}
+}
+
+HashValue Hash64(const void* data, size_t length, HashValue seed)
+{
+	const unsigned char* p = (const unsigned char*)data;
+	const unsigned char* end = p + length;
+	HashValue hash;
+
+	if (length >= 32)
+	{
+		HashValue v1 = seed + prime1 + prime2;
+		HashValue v2 = seed + prime2;
+		HashValue v3 = seed;
+		HashValue v4 = seed - prime1;
+
+		const unsigned char* limit = end - 32;
+		do
+		{
+			v1 = Round(v1, Read64(p));
+			v2 = Round(v2, Read64(p + 8));
+			v3 = Round(v3, Read64(p + 16));
+			v4 = Round(v4, Read64(p + 24));
+			p += 32;
+		}
+		while (p <= limit);
+
+		hash = RotateLeft(v1, 1) + RotateLeft(v2, 7) + RotateLeft(v3, 12) + RotateLeft(v4, 18);
+		hash = MergeRound(hash, v1);
+		hash = MergeRound(hash, v2);
+		hash = MergeRound(hash, v3);
+		hash = MergeRound(hash, v4);
+	}
+	else
+	{
+		hash = seed + prime5;
+	}
+
+	hash += (HashValue)length;
+
+	for (; p + 8 <= end; p += 8)
+	{
+		hash ^= Round(0, Read64(p));
+		hash = RotateLeft(hash, 27) * prime1 + prime4;
+	}
+	if (p + 4 <= end)
+	{
+		hash ^= Read32(p) * prime1;
+		hash = RotateLeft(hash, 23) * prime2 + prime3;
+		p += 4;
+	}
+	for (; p < end; p++)
+	{
+		hash ^= (*p) * prime5;
+		hash = RotateLeft(hash, 11) * prime1;
+	}
+
+	hash ^= hash >> 33;
+	hash *= prime2;
+	hash ^= hash >> 29;
+	hash *= prime3;
+	hash ^= hash >> 32;
+	return hash;
+}
@@ -0,0 +1,173 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by James Vecore
+// james.vecore@gmail.com
+
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef _WIN32
+static const MappedFileHandle noHandle = NULL;
+#else
+static const MappedFileHandle noHandle = -1;
+#endif
+
+MappedFile::MappedFile()
+	: m_data(NULL), m_size(0), m_file(noHandle), m_mapping(noHandle)
+{
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+
+std::string MappedFile::Create(const std::string& fileName, size_t size)
+{
+	Close();
+	m_fileName = fileName;
+
+	HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return "Failed to open file for writing: " + fileName;
+	m_file = file;
+
+	// setting the end of the file allocates the space for it
+	LARGE_INTEGER fileSize;
+	fileSize.QuadPart = (LONGLONG)size;
+	if (!SetFilePointerEx(file, fileSize, NULL, FILE_BEGIN) || !SetEndOfFile(file))
+	{
+		Close();
+		return "Not enough space to write file: " + fileName;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, (DWORD)((unsigned long long)size >> 32), (DWORD)size, NULL);
+	if (mapping == NULL)
+	{
+		Close();
+		return "Failed to map file for writing: " + fileName;
+	}
+	m_mapping = mapping;
+
+	m_data = (char*)MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size);
+	if (m_data == NULL)
+	{
+		Close();
+		return "Failed to map file for writing: " + fileName;
+	}
+	m_size = size;
+	return std::string();
+}
+
+std::string MappedFile::Close()
+{
+	// write errors of the mapped pages only show up when they are flushed, unmapping alone would hide them
+	bool ok = true;
+	if (m_data != NULL)
+	{
+		ok = FlushViewOfFile(m_data, 0) != 0;
+		ok = UnmapViewOfFile(m_data) != 0 && ok;
+	}
+	if (m_mapping != noHandle)
+		CloseHandle((HANDLE)m_mapping);
+	if (m_file != noHandle)
+	{
+		ok = FlushFileBuffers((HANDLE)m_file) != 0 && ok;
+		ok = CloseHandle((HANDLE)m_file) != 0 && ok;
+	}
+
+	m_data = NULL;
+	m_size = 0;
+	m_mapping = noHandle;
+	m_file = noHandle;
+	if (!ok)
+		return "Failed to write file: " + m_fileName;
+	return std::string();
+}
+
+#else
+
+std::string MappedFile::Create(const std::string& fileName, size_t size)
+{
+	Close();
+	m_fileName = fileName;
+
+	m_file = open(fileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0666);
+	if (m_file == noHandle)
+		return "Failed to open file for writing: " + fileName;
+
+	// a sparse file would only run out of space while the mapping is written to, and that is a SIGBUS
+	if (size > 0 && posix_fallocate(m_file, 0, (off_t)size) != 0)
+	{
+		Close();
+		return "Not enough space to write file: " + fileName;
+	}
+
+	if (size > 0)
+	{
+		void* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_file, 0);
+		if (data == MAP_FAILED)
+		{
+			Close();
+			return "Failed to map file for writing: " + fileName;
+		}
+		m_data = (char*)data;
+	}
+	m_size = size;
+	return std::string();
+}
+
+std::string MappedFile::Close()
+{
+	// write errors of the mapped pages (i.e. ENOSPC) only show up when they are flushed, unmapping alone would hide them
+	bool ok = true;
+	if (m_data != NULL)
+	{
+		ok = msync(m_data, m_size, MS_SYNC) == 0;
+		ok = munmap(m_data, m_size) == 0 && ok;
+	}
+	if (m_file != noHandle)
+		ok = close(m_file) == 0 && ok;
+
+	m_data = NULL;
+	m_size = 0;
+	m_file = noHandle;
+	if (!ok)
+		return "Failed to write file: " + m_fileName;
+	return std::string();
+}
+
+#endif
@@ -0,0 +1,67 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by James Vecore
+// james.vecore@gmail.com
+
+
+#ifndef PARTIO_EXPORT_MAPPED_FILE_H
+#define PARTIO_EXPORT_MAPPED_FILE_H
+
+#include <string>
+#include <cstddef>
+
+#ifdef _WIN32
+typedef void* MappedFileHandle;
+#else
+typedef int MappedFileHandle;
+#endif
+
+// A new file of a fixed size mapped into memory for writing. The disk space is reserved when the file is created, so
+// running out of space is reported by Create() instead of faulting while the mapping is written to.
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile(); // closes the file if Close() wasn't called
+
+	// creates (or truncates) fileName with size bytes and maps all of it, returns an error message on failure
+	std::string Create(const std::string& fileName, size_t size);
+
+	char* GetData() const { return m_data; }
+	size_t GetSize() const { return m_size; }
+
+	// writes the mapped data out, unmaps and closes the file. Fails if any of it couldn't be written
+	std::string Close();
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	std::string m_fileName;
+	char* m_data;
+	size_t m_size;
+	MappedFileHandle m_file;
+	MappedFileHandle m_mapping;
+};
+
+#endif
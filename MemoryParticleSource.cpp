@@ -0,0 +1,154 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by James Vecore
+// james.vecore@gmail.com
+
+
+
+#include "MemoryParticleSource.h"
+
+static ParticleRotationForm GetDefaultRotationForm(ParticleDataType dataType)
+{
+	return dataType == ParticleDataQuaternion || dataType == ParticleDataRotation ? ParticleRotationQuaternion : ParticleRotationNone;
+}
+
+MemoryAttributeSource::MemoryAttributeSource(const std::string& name, ParticleDataType dataType, const std::vector<float>& values, bool constant)
+	: m_name(name), m_dataType(dataType), m_perPoint(true), m_constant(constant), m_rotation(GetDefaultRotationForm(dataType)), m_floats(new std::vector<float>(values))
+{
+}
+
+MemoryAttributeSource::MemoryAttributeSource(const std::string& name, ParticleDataType dataType, const std::vector<int>& values, bool constant)
+	: m_name(name), m_dataType(dataType), m_perPoint(true), m_constant(constant), m_rotation(GetDefaultRotationForm(dataType)), m_ints(new std::vector<int>(values))
+{
+}
+
+void MemoryAttributeSource::GetData(ParticleDataArray& data)
+{
+	int components = GetComponentCount(m_dataType);
+
+	// the core reads the values in place, the shared buffer stays alive even if the source goes away first
+	if (m_ints)
+	{
+		data.Data = m_ints->empty() ? NULL : &(*m_ints)[0];
+		data.Stride = m_constant ? 0 : components * sizeof(int);
+		data.Int = true;
+		data.Owner = m_ints;
+	}
+	else
+	{
+		data.Data = m_floats->empty() ? NULL : &(*m_floats)[0];
+		data.Stride = m_constant ? 0 : components * sizeof(float);
+		data.Int = false;
+		data.Owner = m_floats;
+	}
+	data.Components = components;
+	data.Rotation = m_rotation;
+
+	if (m_arrayCounts)
+	{
+		data.ArrayFirst = m_arrayFirst->empty() ? NULL : &(*m_arrayFirst)[0];
+		data.ArrayCounts = m_arrayCounts->empty() ? NULL : &(*m_arrayCounts)[0];
+
+		std::shared_ptr< std::vector< std::shared_ptr<void> > > owners(new std::vector< std::shared_ptr<void> >());
+		owners->push_back(data.Owner);
+		owners->push_back(m_arrayFirst);
+		owners->push_back(m_arrayCounts);
+		data.Owner = owners;
+	}
+}
+
+void MemoryAttributeSource::GetDataChunk(int begin, int /*count*/, ParticleDataArray& data)
+{
+	// all particles are in memory already, a chunk is just the data of the whole attribute starting at begin
+	GetData(data);
+	if (m_arrayCounts)
+	{
+		// the elements stay where they are, only the per particle tables move
+		if (data.Stride != 0 && data.ArrayFirst != NULL)
+		{
+			data.ArrayFirst += begin;
+			data.ArrayCounts += begin;
+		}
+	}
+	else if (data.Data != NULL)
+	{
+		data.Data = (const char*)data.Data + begin * data.Stride;
+	}
+}
+
+void MemoryAttributeSource::SetArrayCounts(const std::vector<unsigned int>& counts)
+{
+	m_arrayCounts.reset(new std::vector<unsigned int>(counts));
+	m_arrayFirst.reset(new std::vector<unsigned int>(counts.size()));
+	unsigned int first = 0;
+	for (size_t i=0; i < counts.size(); i++)
+	{
+		(*m_arrayFirst)[i] = first;
+		first += counts[i];
+	}
+}
+
+int MemoryAttributeSource::GetComponentCount(ParticleDataType dataType)
+{
+	switch (dataType)
+	{
+	case ParticleDataVector2:    return 2;
+	case ParticleDataVector3:    return 3;
+	case ParticleDataVector4:
+	case ParticleDataQuaternion:
+	case ParticleDataColor4:
+	case ParticleDataRotation:   return 4;
+	case ParticleDataMatrix3:    return 9;
+	case ParticleDataMatrix4:    return 16;
+	default:                     return 1;
+	}
+}
+
+MemoryParticleSource::MemoryParticleSource(const std::string& target, int particleCount)
+	: m_target(target), m_particleCount(particleCount)
+{
+}
+
+MemoryAttributeSource& MemoryParticleSource::AddAttribute(const std::string& name, ParticleDataType dataType, const std::vector<float>& values, bool constant)
+{
+	m_attributes.push_back(std::unique_ptr<MemoryAttributeSource>(new MemoryAttributeSource(name, dataType, values, constant)));
+	return *m_attributes.back();
+}
+
+MemoryAttributeSource& MemoryParticleSource::AddAttribute(const std::string& name, ParticleDataType dataType, const std::vector<int>& values, bool constant)
+{
+	m_attributes.push_back(std::unique_ptr<MemoryAttributeSource>(new MemoryAttributeSource(name, dataType, values, constant)));
+	return *m_attributes.back();
+}
+
+StreamExportLog::StreamExportLog(std::ostream& stream, ExportLogSeverity maxSeverity)
+	: m_stream(stream), m_maxSeverity(maxSeverity)
+{
+}
+
+void StreamExportLog::Log(const std::string& message, ExportLogSeverity severity)
+{
+	static const char* prefixes[] = { "ERROR: ", "WARNING: ", "", "" };
+	if (severity <= m_maxSeverity)
+		m_stream << prefixes[severity] << message << std::endl;
+}
@@ -0,0 +1,109 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by James Vecore
+// james.vecore@gmail.com
+
+
+
+#ifndef PARTIO_EXPORT_MEMORY_PARTICLE_SOURCE_H
+#define PARTIO_EXPORT_MEMORY_PARTICLE_SOURCE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <ostream>
+
+#include "ParticleSource.h"
+
+// In-memory stand-ins for the Softimage side of the export (see ParticleSource.h), they let the export core run
+// headless, i.e. to measure it or check its output without a Softimage session.
+
+class MemoryAttributeSource : public ParticleAttributeSource
+{
+public:
+	// values holds GetComponentCount(dataType) values per particle, or a single particle's worth for a constant
+	// attribute. Bool, Long and Shape attributes take ints, everything else floats.
+	MemoryAttributeSource(const std::string& name, ParticleDataType dataType, const std::vector<float>& values, bool constant = false);
+	MemoryAttributeSource(const std::string& name, ParticleDataType dataType, const std::vector<int>& values, bool constant = false);
+
+	virtual std::string GetName() const { return m_name; }
+	virtual ParticleDataType GetDataType() const { return m_dataType; }
+	virtual bool IsPerPoint() const { return m_perPoint; }
+	virtual bool IsArray() const { return m_arrayCounts != NULL; }
+	virtual void GetData(ParticleDataArray& data);
+	virtual void GetDataChunk(int begin, int count, ParticleDataArray& data);
+
+	void SetPerPoint(bool perPoint) { m_perPoint = perPoint; }
+	// Quaternion and Rotation attributes default to x,y,z,w quaternions
+	void SetRotationForm(ParticleRotationForm form) { m_rotation = form; }
+	// makes this a per point array attribute: values holds the elements of all particles one after another, particle i
+	// has counts[i] of them (a constant attribute takes a single count)
+	void SetArrayCounts(const std::vector<unsigned int>& counts);
+
+	static int GetComponentCount(ParticleDataType dataType);
+
+private:
+	std::string m_name;
+	ParticleDataType m_dataType;
+	bool m_perPoint;
+	bool m_constant;
+	ParticleRotationForm m_rotation;
+	std::shared_ptr< std::vector<float> > m_floats;
+	std::shared_ptr< std::vector<int> > m_ints;
+	std::shared_ptr< std::vector<unsigned int> > m_arrayFirst;
+	std::shared_ptr< std::vector<unsigned int> > m_arrayCounts;
+};
+
+class MemoryParticleSource : public ParticleSource
+{
+public:
+	MemoryParticleSource(const std::string& target, int particleCount);
+
+	MemoryAttributeSource& AddAttribute(const std::string& name, ParticleDataType dataType, const std::vector<float>& values, bool constant = false);
+	MemoryAttributeSource& AddAttribute(const std::string& name, ParticleDataType dataType, const std::vector<int>& values, bool constant = false);
+
+	virtual std::string GetTarget() const { return m_target; }
+	virtual int GetParticleCount() { return m_particleCount; }
+	virtual int GetAttributeCount() { return (int)m_attributes.size(); }
+	virtual ParticleAttributeSource& GetAttribute(int index) { return *m_attributes[index]; }
+
+private:
+	std::string m_target;
+	int m_particleCount;
+	std::vector< std::unique_ptr<MemoryAttributeSource> > m_attributes;
+};
+
+// writes every message at or above a severity to a stream
+class StreamExportLog : public ExportLog
+{
+public:
+	StreamExportLog(std::ostream& stream, ExportLogSeverity maxSeverity = ExportLogInfo);
+
+	virtual void Log(const std::string& message, ExportLogSeverity severity);
+
+private:
+	std::ostream& m_stream;
+	ExportLogSeverity m_maxSeverity;
+};
+
+#endif
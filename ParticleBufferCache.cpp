@@ -0,0 +1,158 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "ParticleBufferCache.h"
+
+// with the write queue a few frames of the same target can be in flight, keep enough idle buffers to cover that
+static const size_t maxIdleBuffersPerTarget = 2;
+
+static ParticleBufferCache* sharedCache = NULL;
+static std::mutex sharedCacheMutex;
+
+ParticleBufferCache::ParticleBufferCache()
+{
+}
+
+ParticleBufferCache::~ParticleBufferCache()
+{
+	Clear();
+}
+
+bool ParticleBufferCache::MatchesLayout(Partio::ParticlesDataMutable* pPD, const std::vector<ChannelLayout>& layout)
+{
+	if (pPD->numAttributes() != (int)layout.size())
+		return false;
+
+	for (int i=0; i < pPD->numAttributes(); i++)
+	{
+		Partio::ParticleAttribute attr;
+		pPD->attributeInfo(i, attr);
+		if (attr.name != layout[i].Name || attr.type != layout[i].AttributeType || attr.count != layout[i].Count)
+			return false;
+	}
+	return true;
+}
+
+bool ParticleBufferCache::IsUsable(Partio::ParticlesDataMutable* pPD, const std::vector<ChannelLayout>& layout, int particleCount, bool allowLarger)
+{
+	return (allowLarger || pPD->numParticles() <= particleCount) && MatchesLayout(pPD, layout);
+}
+
+Partio::ParticlesDataMutable* ParticleBufferCache::Acquire(const std::string& target, const std::vector<ChannelLayout>& layout, int particleCount, bool allowLarger)
+{
+	typedef std::multimap<std::string, Partio::ParticlesDataMutable*>::iterator Iterator;
+
+	Partio::ParticlesDataMutable* pPD = NULL;
+	std::vector<Partio::ParticlesDataMutable*> stale;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		// the largest set that can be used, it has to grow the least (or not at all)
+		std::pair<Iterator, Iterator> range = m_idle.equal_range(target);
+		Iterator best = range.second;
+		for (Iterator iter = range.first; iter != range.second; ++iter)
+		{
+			if (!IsUsable(iter->second, layout, particleCount, allowLarger))
+				continue;
+			if (best == range.second || iter->second->numParticles() > best->second->numParticles())
+				best = iter;
+		}
+		if (best != range.second)
+		{
+			pPD = best->second;
+			m_idle.erase(best);
+		}
+
+		// another frame of this target is likely in flight, keep the spare sets for it
+		range = m_idle.equal_range(target);
+		size_t kept = 0;
+		for (Iterator iter = range.first; iter != range.second; )
+		{
+			if (kept < maxIdleBuffersPerTarget && IsUsable(iter->second, layout, particleCount, allowLarger))
+			{
+				kept++;
+				++iter;
+				continue;
+			}
+			stale.push_back(iter->second); // wrong layout, too many particles for an exact count or over the limit
+			m_idle.erase(iter++);
+		}
+	}
+
+	for (size_t i=0; i < stale.size(); i++)
+	{
+		stale[i]->release();
+	}
+
+	if (pPD == NULL)
+	{
+		pPD = Partio::create();
+		for (size_t i=0; i < layout.size(); i++)
+		{
+			pPD->addAttribute(layout[i].Name.c_str(), layout[i].AttributeType, layout[i].Count);
+		}
+	}
+
+	if (pPD->numParticles() < particleCount)
+		pPD->addParticles(particleCount - pPD->numParticles());
+
+	return pPD;
+}
+
+void ParticleBufferCache::Release(const std::string& target, Partio::ParticlesDataMutable* pPD)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_idle.count(target) < maxIdleBuffersPerTarget)
+		{
+			m_idle.insert(std::make_pair(target, pPD));
+			return;
+		}
+	}
+	pPD->release();
+}
+
+void ParticleBufferCache::Clear()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (std::multimap<std::string, Partio::ParticlesDataMutable*>::iterator iter = m_idle.begin(); iter != m_idle.end(); ++iter)
+	{
+		iter->second->release();
+	}
+	m_idle.clear();
+}
+
+ParticleBufferCache& ParticleBufferCache::Shared()
+{
+	std::lock_guard<std::mutex> lock(sharedCacheMutex);
+	if (sharedCache == NULL)
+		sharedCache = new ParticleBufferCache();
+	return *sharedCache;
+}
+
+void ParticleBufferCache::ShutdownShared()
+{
+	std::lock_guard<std::mutex> lock(sharedCacheMutex);
+	delete sharedCache;
+	sharedCache = NULL;
+}
@@ -0,0 +1,76 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef PARTIO_EXPORT_PARTICLE_BUFFER_CACHE_H
+#define PARTIO_EXPORT_PARTICLE_BUFFER_CACHE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+
+#include <Partio.h>
+
+struct ChannelLayout
+{
+	std::string Name;
+	Partio::ParticleAttributeType AttributeType;
+	int Count;
+};
+
+// Keeps the partio particle sets of previous frames around so a cache run doesn't create and free the whole particle
+// store for every frame. Buffers are kept per export target (i.e. per point cloud), a buffer is reused when its
+// attributes match the requested layout. Partio grows a particle set in place but can't remove particles, so a set
+// that has more particles than requested can only be reused by callers that write just the first particleCount of
+// them (allowLarger, the plugin's own PRT writers). For the formats partio writes a buffer is recreated when the
+// particle count goes down.
+class ParticleBufferCache
+{
+public:
+	ParticleBufferCache();
+	~ParticleBufferCache();
+
+	// returns a particle set with the attributes in layout and exactly particleCount particles, or with allowLarger at
+	// least particleCount (the largest idle set of the target, so particle counts that go up and down reuse it)
+	Partio::ParticlesDataMutable* Acquire(const std::string& target, const std::vector<ChannelLayout>& layout, int particleCount, bool allowLarger);
+
+	// hands a buffer back once its frame has been written, safe to call from any thread
+	void Release(const std::string& target, Partio::ParticlesDataMutable* pPD);
+
+	void Clear();
+
+	static ParticleBufferCache& Shared();
+	static void ShutdownShared();
+
+private:
+	ParticleBufferCache(const ParticleBufferCache&);
+	ParticleBufferCache& operator=(const ParticleBufferCache&);
+
+	static bool MatchesLayout(Partio::ParticlesDataMutable* pPD, const std::vector<ChannelLayout>& layout);
+	static bool IsUsable(Partio::ParticlesDataMutable* pPD, const std::vector<ChannelLayout>& layout, int particleCount, bool allowLarger);
+
+	std::multimap<std::string, Partio::ParticlesDataMutable*> m_idle;
+	std::mutex m_mutex;
+};
+
+#endif
@@ -0,0 +1,1805 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by James Vecore
+// james.vecore@gmail.com
+
+
+
+#include "ParticleExporter.h"
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <functional>
+#include <cmath>
+#include <climits>
+
+#include "ConvertKernels.h"
+#include "WorkerPool.h"
+#include "WriteQueue.h"
+#include "ParticleBufferCache.h"
+#include "PrtWriter.h"
+#include "HalfFloat.h"
+#include "Hash.h"
+#include "ExportProfiler.h"
+#include "SpatialSort.h"
+#include "Partition.h"
+#include "Rotation.h"
+#include "ArrayFile.h"
+#include "ExportCache.h"
+#include "ExportExpression.h"
+
+
+static DataMap int1Map    = { Partio::INT   , 1 };
+static DataMap float1Map  = { Partio::FLOAT , 1 };
+static DataMap float2Map  = { Partio::FLOAT , 2 };
+static DataMap float3Map  = { Partio::FLOAT , 3 };
+static DataMap float4Map  = { Partio::FLOAT , 4 };
+static DataMap vector3Map = { Partio::VECTOR, 3 };
+static DataMap matrix3Map = { Partio::FLOAT , 9 };
+static DataMap matrix4Map = { Partio::FLOAT , 16 };
+
+static std::map<std::string, std::string> defaultChannelNameMap;
+static std::map<ParticleDataType, DataMap> defaultDataMapping;
+
+static ExportFormat prtFormat;
+static ExportFormat bgeoFormat;
+static ExportFormat binFormat;
+static ExportFormat pdaFormat;
+
+void InitDefaults()
+{
+	if (defaultChannelNameMap.size() == 0)
+	{
+		// these are basically .PRT channels names by default, everything else should map 1:1 (i.e. ID -> ID automatically, Density -> Density etc)
+		defaultChannelNameMap["PointPosition"] = "Position";
+		defaultChannelNameMap["PointVelocity"] = "Velocity";
+		defaultChannelNameMap["PointNormal"]   = "Normal";
+		defaultChannelNameMap["PointUV"]       = "TextureCoord";
+	}
+	
+	if (defaultDataMapping.size() == 0)
+	{
+		defaultDataMapping[ParticleDataBool]       = int1Map;
+		defaultDataMapping[ParticleDataLong]       = int1Map;
+		defaultDataMapping[ParticleDataFloat]      = float1Map;
+		defaultDataMapping[ParticleDataVector2]    = float2Map;
+		defaultDataMapping[ParticleDataVector3]    = vector3Map;
+		defaultDataMapping[ParticleDataVector4]    = float4Map;
+		defaultDataMapping[ParticleDataQuaternion] = float4Map;
+		defaultDataMapping[ParticleDataColor4]     = float4Map;
+		defaultDataMapping[ParticleDataShape]      = int1Map;
+		defaultDataMapping[ParticleDataRotation]   = float4Map;
+		defaultDataMapping[ParticleDataMatrix3]    = matrix3Map;
+		defaultDataMapping[ParticleDataMatrix4]    = matrix4Map;
+	}
+}
+
+void InitFormats()
+{
+	InitDefaults();
+
+	if (prtFormat.DataMapping.size() != 0)
+		return;
+
+	prtFormat.ChannelNameMapping = defaultChannelNameMap;
+	prtFormat.DataMapping = defaultDataMapping;
+	// this is a special case for Krakatoa which expects 3 float color no alpha
+	prtFormat.DataMapping[ParticleDataColor4] = float3Map;
+
+	std::map<std::string, std::string>& bgeoNames = bgeoFormat.ChannelNameMapping;
+	bgeoNames["PointPosition"]   = "position"; // this has to be 'position' and not 'P' or the bgeo writer for partio will fail (LAME)...
+	bgeoNames["PointVelocity"]   = "v";
+	bgeoNames["PointNormal"]     = "N";
+	bgeoNames["PointUpVector"]   = "up";
+	bgeoNames["PointUV"]         = "uv";
+	bgeoNames["Color"]           = "Cd";
+	bgeoNames["Mass"]            = "mass";
+	bgeoNames["Size"]            = "pscale";
+	bgeoNames["Scale"]           = "scalef";
+	bgeoNames["DragCoefficient"] = "drag";
+
+	bgeoFormat.DataMapping = defaultDataMapping;
+	bgeoFormat.DataMapping[ParticleDataColor4] = float3Map;
+
+	// bin format partio writer expects very specific attribute names and only supports these channels
+	std::map<std::string, std::string>& binNames = binFormat.ChannelNameMapping;
+	binNames["PointPosition"] = "position"; 
+	binNames["PointVelocity"] = "velocity";
+	binNames["PointNormal"]   = "normal";
+	binNames["Force"]         = "force";
+	binNames["Vorticity"]     = "vorticity";
+	binNames["Neighbors"]     = "neighbors";
+	binNames["PointUV"]       = "uvw";
+	binNames["Age"]           = "age";
+	binNames["IsolationTime"] = "isolationTime";
+	binNames["Viscosity"]     = "viscosity";
+	binNames["Density"]       = "density";
+	binNames["Pressure"]      = "pressure";
+	binNames["Mass"]          = "mass";
+	binNames["Temperature"  ] = "temperature";
+	binNames["ID"]            = "id";
+
+	// the default data map should work just fine
+	binFormat.DataMapping = defaultDataMapping;
+
+	// guess based on this: http://download.autodesk.com/us/maya/2009help/index.html?url=Dynamics_Nodes_List_of_particle_attributes.htm,topicNumber=d0e413301
+	// not really tested could use some feedback/pull requests here
+	std::map<std::string, std::string>& pdaNames = pdaFormat.ChannelNameMapping;
+	pdaNames["PointPosition"] = "position"; // this has to be 'position' and not 'P' or the bgeo writer for partio will fail (LAME)...
+	pdaNames["PointVelocity"] = "velocity";
+	pdaNames["PointNormal"]   = "normalDir";
+	pdaNames["PointUpVector"] = "upDir";
+	pdaNames["Acceleration"]  = "acceleration";
+	pdaNames["Force"]         = "force";
+	pdaNames["PointUV"]       = "uv";
+	pdaNames["Color"]         = "objectColor";
+	pdaNames["Mass"]          = "mass";
+	pdaNames["Radius"]        = "radius";
+	pdaNames["Size"]          = "pointSize";
+	pdaNames["Age"]           = "age";
+	pdaNames["ID"]            = "id";
+
+	// the pda family has always been exported with the default data map (4 float color)
+	pdaFormat.DataMapping = defaultDataMapping;
+}
+
+const ExportFormat& GetExportFormat(ExportFormatFamily family)
+{
+	InitFormats(); // just in case these are not already initialized (i.e. if the dll was unloaded by softimage between calls)
+
+	switch (family)
+	{
+	case ExportFormatBGEO: return bgeoFormat;
+	case ExportFormatBIN:  return binFormat;
+	case ExportFormatPDA:  return pdaFormat;
+	default:               return prtFormat;
+	}
+}
+
+bool GetExportFormatFamily(const std::string& extension, ExportFormatFamily& family)
+{
+	std::string ext = extension.substr(extension.size() > 0 && extension[0] == '.' ? 1 : 0);
+	std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+
+	if (ext == "prt")
+		family = ExportFormatPRT;
+	else if (ext == "bgeo" || ext == "geo")
+		family = ExportFormatBGEO;
+	else if (ext == "bin")
+		family = ExportFormatBIN;
+	else if (ext == "pda" || ext == "pdb" || ext == "pdc")
+		family = ExportFormatPDA;
+	else
+		return false;
+	return true;
+}
+
+// returns the byte distance between two consecutive particles of a partio attribute
+template <typename PrimativeType>
+inline size_t PartioStride(Partio::ParticlesDataMutable* pPD, Partio::ParticleAttribute& partioAttr)
+{
+	if (pPD->numParticles() < 2)
+		return sizeof(PrimativeType) * partioAttr.count;
+	return (char*)pPD->dataWrite<PrimativeType>(partioAttr, 1) - (char*)pPD->dataWrite<PrimativeType>(partioAttr, 0);
+}
+
+// partio data access is type checked, these go through the attribute's real type for code that only moves bytes
+char* PartioData(Partio::ParticlesDataMutable* pPD, Partio::ParticleAttribute& partioAttr)
+{
+	if (partioAttr.type == Partio::INT)
+		return (char*)pPD->dataWrite<int>(partioAttr, 0);
+	return (char*)pPD->dataWrite<float>(partioAttr, 0);
+}
+
+size_t PartioAttributeStride(Partio::ParticlesDataMutable* pPD, Partio::ParticleAttribute& partioAttr)
+{
+	if (partioAttr.type == Partio::INT)
+		return PartioStride<int>(pPD, partioAttr);
+	return PartioStride<float>(pPD, partioAttr);
+}
+
+// attributes bigger than this are split into several tasks so a few large channels don't serialize the export
+static const int conversionChunkSize = 256 * 1024;
+
+// Converted data of one channel from the previous frame for delta=on (see ExportOptions.h), kept per conversion chunk
+// along with a hash of the source data it was converted from. A chunk whose source hasn't changed is copied from here
+// instead of being converted again. Everything is reset when the particle count or the channel layout changes.
+struct DeltaChannel
+{
+	DeltaChannel() : ParticleCount(-1), ElementSize(0) {}
+
+	void Prepare(int particleCount, size_t elementSize)
+	{
+		size_t chunkCount = (particleCount + conversionChunkSize - 1) / conversionChunkSize;
+		if (particleCount != ParticleCount || elementSize != ElementSize)
+		{
+			ParticleCount = particleCount;
+			ElementSize = elementSize;
+			ChunkHashes.assign(chunkCount, 0);
+			ChunkValid.assign(chunkCount, 0);
+			Converted.resize(size_t(particleCount) * elementSize);
+		}
+		ChunkReused.assign(chunkCount, 0);
+	}
+
+	int ParticleCount;
+	size_t ElementSize;
+	std::vector<HashValue> ChunkHashes;
+	std::vector<char> ChunkValid;
+	std::vector<char> ChunkReused; // for this frame's stats
+	std::vector<char> Converted;
+};
+
+// Where converted values go: particle i is at Data + (i / BlockParticles) * BlockStride + (i % BlockParticles) * Stride.
+// A partio attribute is a single block, mapped PRT files are split into blocks (see PrtMappedWriter).
+struct ConvertTarget
+{
+	char* Data;
+	size_t Stride;
+	int BlockParticles;
+	size_t BlockStride;
+
+	char* GetParticle(int index) const
+	{
+		return Data + size_t(index / BlockParticles) * BlockStride + size_t(index % BlockParticles) * Stride;
+	}
+
+	// the end of the run of particles from index on that are in the same block
+	int GetRunEnd(int index, int end) const
+	{
+		return (int)std::min((long long)end, (long long)(index / BlockParticles + 1) * BlockParticles);
+	}
+};
+
+// What a channel filled from a per point array attribute holds (arrays=fixed|indexed, see ExportOptions.h)
+enum ArrayChannel
+{
+	ArrayChannelNone,   // not an array attribute
+	ArrayChannelValues, // the first ArraySize elements, zero padded
+	ArrayChannelCount,  // the element count, at most ArraySize unless that is 0
+	ArrayChannelOffset  // the first element in the array file
+};
+
+ConvertTarget GetPartioTarget(Partio::ParticlesDataMutable* pPD, Partio::ParticleAttribute& partioAttr)
+{
+	ConvertTarget target = { PartioData(pPD, partioAttr), PartioAttributeStride(pPD, partioAttr), INT_MAX, 0 };
+	return target;
+}
+
+ConvertTarget GetMappedTarget(const PrtMappedChannel& channel)
+{
+	ConvertTarget target = { channel.Data, channel.Stride, channel.BlockParticles, channel.BlockStride };
+	return target;
+}
+
+// Holds the fetched data for one attribute until it is converted into its partio attribute or mapped file. The data
+// is fetched on the calling (main) thread when the converter is created, ConvertChunk() only touches the fetched
+// array, the converter's target and its own delta channel so separate chunks can be converted from the worker pool.
+class AttributeConverter
+{
+public:
+	// pPD can be NULL if the target is set later (SetTarget)
+	AttributeConverter(ParticleAttributeSource& source, Partio::ParticlesDataMutable* pPD, Partio::ParticleAttribute& partioAttr)
+		: m_partioAttr(partioAttr), m_rotation(RotationNative), m_arrayChannel(ArrayChannelNone), m_arraySize(0), m_delta(NULL), m_profile(NULL), m_profileAttribute(-1)
+	{
+		source.GetData(m_data);
+		if (pPD != NULL)
+			SetTarget(GetPartioTarget(pPD, partioAttr));
+	}
+
+	// another channel of an attribute that has already been fetched (the values and element count of an array)
+	AttributeConverter(const ParticleDataArray& data, Partio::ParticlesDataMutable* pPD, Partio::ParticleAttribute& partioAttr)
+		: m_data(data), m_partioAttr(partioAttr), m_rotation(RotationNative), m_arrayChannel(ArrayChannelNone), m_arraySize(0), m_delta(NULL), m_profile(NULL), m_profileAttribute(-1)
+	{
+		if (pPD != NULL)
+			SetTarget(GetPartioTarget(pPD, partioAttr));
+	}
+
+	// converts the source particles [begin, begin + count) into the first count particles of pPD
+	AttributeConverter(ParticleAttributeSource& source, int begin, int count, Partio::ParticlesDataMutable* pPD, Partio::ParticleAttribute& partioAttr)
+		: m_partioAttr(partioAttr), m_rotation(RotationNative), m_arrayChannel(ArrayChannelNone), m_arraySize(0), m_delta(NULL), m_profile(NULL), m_profileAttribute(-1)
+	{
+		source.GetDataChunk(begin, count, m_data);
+		SetTarget(GetPartioTarget(pPD, partioAttr));
+	}
+
+	void SetTarget(const ConvertTarget& target)
+	{
+		m_target = target;
+	}
+
+	// only applies to rotation data
+	void SetRotationConvention(RotationConvention convention)
+	{
+		m_rotation = convention;
+	}
+
+	// only applies to per point array data
+	void SetArrayChannel(ArrayChannel channel, int arraySize)
+	{
+		m_arrayChannel = channel;
+		m_arraySize = arraySize;
+	}
+
+	const ParticleDataArray& GetData() const
+	{
+		return m_data;
+	}
+
+	void SetProfile(FrameProfile* profile, int attribute)
+	{
+		m_profile = profile;
+		m_profileAttribute = attribute;
+	}
+
+	void SetDelta(DeltaChannel* delta, int particleCount)
+	{
+		m_delta = delta;
+		m_delta->Prepare(particleCount, m_partioAttr.count * sizeof(float));
+	}
+
+	// begin has to be a multiple of conversionChunkSize
+	void ConvertChunk(int begin, int end)
+	{
+		ScopedStageTimer timer(m_profile, ExportStageConvert, m_profileAttribute);
+
+		if (m_delta == NULL)
+			return Convert(begin, end);
+
+		const int chunk = begin / conversionChunkSize;
+		const HashValue hash = HashSource(begin, end);
+
+		if (m_delta->ChunkValid[chunk] && m_delta->ChunkHashes[chunk] == hash)
+		{
+			CopyCached(begin, end, true);
+			m_delta->ChunkReused[chunk] = 1;
+			return;
+		}
+
+		Convert(begin, end);
+		CopyCached(begin, end, false);
+		m_delta->ChunkHashes[chunk] = hash;
+		m_delta->ChunkValid[chunk] = 1;
+	}
+
+	// hash of the fetched data of particles [begin, end), for delta=on and skip=on. Rotations are seeded with their form
+	// so the same floats read as a different representation don't match.
+	HashValue HashSource(int begin, int end)
+	{
+		const size_t elementSize = m_data.Components * sizeof(float); // ints and floats are both 4 bytes
+		const char* src = (const char*)m_data.Data;
+		const HashValue seed = m_data.Rotation;
+		if (m_data.ArrayFirst != NULL)
+			return HashArrays(begin, end, seed);
+		if (m_data.Stride == 0)
+			return Hash64(src, elementSize, seed + 1); // constant array
+		if (m_data.Stride == elementSize)
+			return Hash64(src + begin*m_data.Stride, (end - begin) * elementSize, seed);
+
+		HashValue hash = seed;
+		for (int i=begin; i < end; i++)
+		{
+			hash = Hash64(src + i*m_data.Stride, elementSize, hash);
+		}
+		return hash;
+	}
+
+	void HashChunk(int begin, int end, HashValue* hash)
+	{
+		*hash = HashSource(begin, end);
+	}
+
+private:
+	// the element tables and the elements they point at, in one piece when the particles' elements are back to back
+	HashValue HashArrays(int begin, int end, HashValue seed)
+	{
+		const size_t elementSize = m_data.Components * sizeof(float);
+		const char* src = (const char*)m_data.Data;
+		if (m_data.Stride == 0)
+		{
+			begin = 0;
+			end = 1;
+		}
+
+		HashValue hash = Hash64(m_data.ArrayCounts + begin, (end - begin) * sizeof(unsigned int), seed);
+		hash = Hash64(m_data.ArrayFirst + begin, (end - begin) * sizeof(unsigned int), hash);
+
+		bool packed = true;
+		for (int i=begin; i < end-1 && packed; i++)
+		{
+			packed = m_data.ArrayFirst[i] + m_data.ArrayCounts[i] == m_data.ArrayFirst[i+1];
+		}
+		if (packed)
+			return Hash64(src + m_data.ArrayFirst[begin] * elementSize, size_t(m_data.ArrayFirst[end-1] + m_data.ArrayCounts[end-1] - m_data.ArrayFirst[begin]) * elementSize, hash);
+
+		for (int i=begin; i < end; i++)
+		{
+			hash = Hash64(src + m_data.ArrayFirst[i] * elementSize, m_data.ArrayCounts[i] * elementSize, hash);
+		}
+		return hash;
+	}
+
+	// one run per block of the target
+	void Convert(int begin, int end)
+	{
+		for (int runBegin=begin; runBegin < end; )
+		{
+			int runEnd = m_target.GetRunEnd(runBegin, end);
+			ConvertRun(runBegin, runEnd, m_target.GetParticle(runBegin));
+			runBegin = runEnd;
+		}
+	}
+
+	// copies particles [begin, end) from the delta channel to the target, or the other way around
+	void CopyCached(int begin, int end, bool toTarget)
+	{
+		const size_t elementSize = m_delta->ElementSize;
+		for (int runBegin=begin; runBegin < end; )
+		{
+			int runEnd = m_target.GetRunEnd(runBegin, end);
+			char* cached = &m_delta->Converted[0] + size_t(runBegin) * elementSize;
+			char* dst = m_target.GetParticle(runBegin);
+			if (toTarget)
+				CopyStrided(cached, elementSize, dst, m_target.Stride, elementSize, runEnd - runBegin);
+			else
+				CopyStrided(dst, m_target.Stride, cached, elementSize, elementSize, runEnd - runBegin);
+			runBegin = runEnd;
+		}
+	}
+
+	void ConvertRun(int begin, int end, char* dst)
+	{
+		const char* src = (const char*)m_data.Data + begin * m_data.Stride;
+		const size_t dstStride = m_target.Stride;
+		int count = std::min(m_partioAttr.count, m_data.Components);
+
+		if (m_arrayChannel != ArrayChannelNone)
+		{
+			ConvertArrayRun(begin, end, dst);
+		}
+		else if (m_data.Int || m_partioAttr.type == Partio::INT)
+		{
+			CopyStrided(src, m_data.Stride, dst, dstStride, count * sizeof(int), end - begin);
+		}
+		else if (m_data.Rotation != ParticleRotationNone && m_rotation != RotationNative && count == 4)
+		{
+			ConvertRotations((const float*)src, m_data.Stride, m_data.Rotation, m_data.WXYZ, m_rotation, (float*)dst, dstStride, end - begin);
+		}
+		else if (m_data.WXYZ && count == 4)
+		{
+			CopyQuaternionsWXYZ((const float*)src, m_data.Stride, (float*)dst, dstStride, end - begin);
+		}
+		else
+		{
+			CopyFloatsBulk((const float*)src, m_data.Stride, m_data.Components, (float*)dst, dstStride, count, end - begin);
+		}
+	}
+
+	// Per point arrays are copied through their element tables, a whole particle's elements at a time when the channel
+	// stores them as they are (every element's values are kept, no Color4 -> float3 style narrowing)
+	void ConvertArrayRun(int begin, int end, char* dst)
+	{
+		const size_t dstStride = m_target.Stride;
+		const size_t tableStride = m_data.Stride != 0 ? 1 : 0;
+		const unsigned int* first = m_data.ArrayFirst + begin * tableStride;
+		const unsigned int* counts = m_data.ArrayCounts + begin * tableStride;
+
+		if (m_arrayChannel == ArrayChannelCount || m_arrayChannel == ArrayChannelOffset)
+		{
+			const unsigned int limit = m_arraySize > 0 ? (unsigned int)m_arraySize : UINT_MAX;
+			for (int i=0; i < end - begin; i++)
+			{
+				const size_t index = i * tableStride;
+				*(int*)(dst + i*dstStride) = (int)(m_arrayChannel == ArrayChannelOffset ? first[index] : std::min(counts[index], limit));
+			}
+			return;
+		}
+
+		const size_t elementSize = m_data.Components * sizeof(float);
+		const int dstComponents = m_partioAttr.count / m_arraySize;
+		const size_t dstElementSize = dstComponents * sizeof(float);
+		const char* src = (const char*)m_data.Data;
+		for (int i=0; i < end - begin; i++)
+		{
+			const size_t index = i * tableStride;
+			const int elements = (int)std::min(counts[index], (unsigned int)m_arraySize);
+			const char* elementSrc = src + first[index] * elementSize;
+			char* particleDst = dst + i*dstStride;
+			if (dstComponents == m_data.Components)
+			{
+				memcpy(particleDst, elementSrc, elements * elementSize);
+			}
+			else
+			{
+				for (int e=0; e < elements; e++)
+				{
+					memset(particleDst + e*dstElementSize, 0, dstElementSize);
+					memcpy(particleDst + e*dstElementSize, elementSrc + e*elementSize, std::min(elementSize, dstElementSize));
+				}
+			}
+			memset(particleDst + elements*dstElementSize, 0, (m_arraySize - elements) * dstElementSize);
+		}
+	}
+
+	ParticleDataArray m_data;
+	ConvertTarget m_target;
+	Partio::ParticleAttribute m_partioAttr;
+	RotationConvention m_rotation;
+	ArrayChannel m_arrayChannel;
+	int m_arraySize;
+	DeltaChannel* m_delta;
+	FrameProfile* m_profile;
+	int m_profileAttribute;
+};
+
+// arrays=indexed: the elements of an array attribute, written next to the particle file
+struct PendingArrayFile
+{
+	std::string FileName;
+	ParticleDataArray Data;
+};
+
+// An object whose data has been fetched on the main thread and is waiting to be converted and written
+struct PendingExport
+{
+	PendingExport() : pPD(NULL), particleCount(0), split(false), mapped(false), settingsHash(0), contentHash(0) {}
+	~PendingExport()
+	{
+		if (pPD != NULL)
+			ParticleBufferCache::Shared().Release(target, pPD); // only if it never made it to the write queue
+	}
+
+	std::string target;
+	ExportOptions options;
+	std::vector<std::string> halfChannels;
+	Partio::ParticlesDataMutable* pPD;
+	int particleCount;
+	std::vector< std::unique_ptr<AttributeConverter> > converters;
+	std::vector<DeltaChannel*> deltaChannels;
+	std::string outputFName;
+	std::string positionChannel; // partio names of PointPosition and ID for sorting and splitting, empty if not exported
+	std::string idChannel;
+	bool split; // split=<n> and the channel it splits by is exported
+	bool mapped; // converted straight into mappedFile instead of pPD, see CanWriteMapped()
+	std::vector<Partio::ParticleAttribute> mappedAttributes;
+	std::unique_ptr<PrtMappedWriter> mappedFile; // opened in ExportBatch::Finish()
+	std::string cacheFileName; // the file whose hash is kept for skip=on (the manifest if split), empty when off
+	std::vector<std::string> cacheSidecars; // the other files written with it (index, array files, partitions)
+	HashValue settingsHash; // channel layout and output options
+	HashValue contentHash; // settingsHash and the fetched data
+	std::vector<PendingArrayFile> arrayFiles;
+	std::shared_ptr<FrameProfile> profile; // NULL unless profiling
+};
+
+// per target, per channel, only filled while delta=on
+static std::map< std::string, std::map<std::string, DeltaChannel> > deltaChannels;
+
+// one task per attribute, or per chunk of particles for large attributes
+void AddConvertTasks(std::vector< std::unique_ptr<AttributeConverter> >& converters, int particleCount, std::vector< std::function<void()> >& tasks)
+{
+	for (size_t i=0; i < converters.size(); i++)
+	{
+		for (int begin=0; begin < particleCount; begin += conversionChunkSize)
+		{
+			int end = std::min(begin + conversionChunkSize, particleCount);
+			tasks.push_back(std::bind(&AttributeConverter::ConvertChunk, converters[i].get(), begin, end));
+		}
+	}
+}
+
+// Converts all fetched attributes on the shared worker pool. Every task writes to its own partio attribute / particle
+// range so they are independent, which also lets all objects of a model export be converted in the same batch.
+void ConvertAttributes(std::vector< std::unique_ptr<PendingExport> >& exports)
+{
+	std::vector< std::function<void()> > tasks;
+	for (size_t exportIndex=0; exportIndex < exports.size(); exportIndex++)
+	{
+		AddConvertTasks(exports[exportIndex]->converters, exports[exportIndex]->particleCount, tasks);
+	}
+
+	WorkerPool::Shared().Run(tasks);
+}
+
+// approximate memory held by a particle set, used to budget the write queue
+size_t PartioDataSize(Partio::ParticlesDataMutable* pPD)
+{
+	size_t bytesPerParticle = 0;
+	for (int i=0; i < pPD->numAttributes(); i++)
+	{
+		Partio::ParticleAttribute attr;
+		pPD->attributeInfo(i, attr);
+		bytesPerParticle += attr.count * sizeof(float); // all attribute types are 4 bytes per component
+	}
+	return bytesPerParticle * pPD->numParticles();
+}
+
+// partio formats only store 32 bit floats, half precision channels are rounded to the nearest half instead
+void RoundHalfChannels(Partio::ParticlesDataMutable* pPD, const ExportOptions& options, const std::vector<std::string>& halfChannels)
+{
+	int numParticles = pPD->numParticles();
+	for (int i=0; i < pPD->numAttributes() && numParticles > 0; i++)
+	{
+		Partio::ParticleAttribute attr;
+		pPD->attributeInfo(i, attr);
+		if (attr.type != Partio::FLOAT && attr.type != Partio::VECTOR)
+			continue;
+		if (!options.HalfPrecision && std::find(halfChannels.begin(), halfChannels.end(), attr.name) == halfChannels.end())
+			continue;
+
+		float* data = pPD->dataWrite<float>(attr, 0);
+		size_t stride = PartioStride<float>(pPD, attr);
+		if (stride == attr.count * sizeof(float))
+		{
+			RoundFloatsToHalf(data, size_t(numParticles) * attr.count);
+			continue;
+		}
+
+		for (int p=0; p < numParticles; p++)
+		{
+			RoundFloatsToHalf((float*)((char*)data + p*stride), attr.count);
+		}
+	}
+}
+
+bool HasExtension(const std::string& fileName, const std::string& ext)
+{
+	return fileName.size() >= ext.size() && fileName.compare(fileName.size() - ext.size(), ext.size(), ext) == 0;
+}
+
+// moves one attribute's particles into the order given by permutation (the original index of every sorted particle)
+void PermuteAttribute(Partio::ParticlesDataMutable* pPD, int attributeIndex, const std::vector<unsigned int>* permutation)
+{
+	Partio::ParticleAttribute attr;
+	pPD->attributeInfo(attributeIndex, attr);
+	const int numParticles = (int)permutation->size();
+	const size_t elementSize = attr.count * sizeof(float); // all attribute types are 4 bytes per component
+	const size_t stride = PartioAttributeStride(pPD, attr);
+	char* data = PartioData(pPD, attr);
+
+	std::vector<char> sorted(size_t(numParticles) * elementSize);
+	for (int i=0; i < numParticles; i++)
+	{
+		memcpy(&sorted[0] + i*elementSize, data + (*permutation)[i]*stride, elementSize);
+	}
+	CopyStrided(&sorted[0], elementSize, data, stride, elementSize, numParticles);
+}
+
+// reorders the first permutation.size() particles of all attributes, one task per attribute
+void PermuteParticles(Partio::ParticlesDataMutable* pPD, const std::vector<unsigned int>& permutation)
+{
+	std::vector< std::function<void()> > tasks;
+	for (int i=0; i < pPD->numAttributes(); i++)
+	{
+		tasks.push_back(std::bind(&PermuteAttribute, pPD, i, &permutation));
+	}
+	WorkerPool::Shared().Run(tasks);
+}
+
+// sort=morton|hilbert: reorders the particles along the curve through positionChannel
+void SortParticles(Partio::ParticlesDataMutable* pPD, int numParticles, const std::string& positionChannel, SpatialOrder order, int resolution, SpatialIndex& index)
+{
+	std::vector<unsigned int> permutation;
+	if (numParticles == 0)
+	{
+		ComputeSpatialOrder(NULL, 0, 0, order, resolution, permutation, index, WorkerPool::Shared());
+		return;
+	}
+
+	Partio::ParticleAttribute position;
+	pPD->attributeInfo(positionChannel.c_str(), position);
+	ComputeSpatialOrder(PartioData(pPD, position), PartioAttributeStride(pPD, position), numParticles, order, resolution, permutation, index, WorkerPool::Shared());
+	PermuteParticles(pPD, permutation);
+}
+
+// splitby=id: orders the particles by their ID, particles with the same ID keep their order
+void SortParticlesById(Partio::ParticlesDataMutable* pPD, int numParticles, const std::string& idChannel)
+{
+	Partio::ParticleAttribute id;
+	pPD->attributeInfo(idChannel.c_str(), id);
+	if (numParticles == 0)
+		return;
+
+	const char* ids = PartioData(pPD, id);
+	const size_t stride = PartioAttributeStride(pPD, id);
+
+	// the ID with its sign bit flipped sorts the same as an unsigned number, the particle index goes in the low bits
+	std::vector<unsigned long long> keys(numParticles);
+	for (int i=0; i < numParticles; i++)
+	{
+		unsigned int key = *(const unsigned int*)(ids + i*stride) ^ 0x80000000u;
+		keys[i] = ((unsigned long long)key << 32) | (unsigned int)i;
+	}
+	std::sort(keys.begin(), keys.end());
+
+	std::vector<unsigned int> permutation(numParticles);
+	for (int i=0; i < numParticles; i++)
+	{
+		permutation[i] = (unsigned int)keys[i];
+	}
+	PermuteParticles(pPD, permutation);
+}
+
+// writes and releases a finished frame, runs on the write queue's thread so it must not touch the SDK
+// Writes the first particleCount particles of pPD. Partio writes every particle of a set, so for other formats than PRT
+// pPD has to have exactly that many (see ParticleBufferCache::Acquire).
+std::string WritePartioFile(Partio::ParticlesDataMutable* pPD, int particleCount, const std::string& fileName, const std::string& target, const ExportOptions& options, const std::vector<std::string>& halfChannels)
+{
+	// PRT has its own writer that compresses on the worker pool and can store float16
+	if (HasExtension(fileName, ".prt"))
+	{
+		std::string error = WritePRT(fileName, *pPD, particleCount, options, halfChannels, WorkerPool::Shared());
+		ParticleBufferCache::Shared().Release(target, pPD);
+		return error;
+	}
+
+	RoundHalfChannels(pPD, options, halfChannels);
+
+	// partio only reports failures on stderr, remove the old file first so we can tell if the write made it to disk
+	remove(fileName.c_str());
+
+	Partio::write(fileName.c_str(), *pPD, options.Compress == ExportOptions::CompressionOn);
+	ParticleBufferCache::Shared().Release(target, pPD); // kept around for the next frame of the same target
+
+	FILE* file = fopen(fileName.c_str(), "rb");
+	if (file == NULL)
+		return "Failed to write particle file: " + fileName;
+
+	fclose(file);
+	return std::string();
+}
+
+// copies one partition (a range of the ordered particles) into its own particle set and writes it, runs on the pool
+void WritePartition(Partio::ParticlesDataMutable* pPD, const std::string& target, int partitionIndex, const ExportOptions* options, const std::vector<std::string>* halfChannels, const std::string* positionChannel, const std::string* idChannel, PartitionInfo* partition, std::string* error)
+{
+	std::vector<ChannelLayout> layout(pPD->numAttributes());
+	for (int i=0; i < pPD->numAttributes(); i++)
+	{
+		Partio::ParticleAttribute attr;
+		pPD->attributeInfo(i, attr);
+		ChannelLayout channel = { attr.name, attr.type, attr.count };
+		layout[i] = channel;
+	}
+
+	// kept per partition so the next frame can reuse the buffer
+	std::ostringstream ss;
+	ss << target << "|part" << partitionIndex;
+	const std::string partitionTarget = ss.str();
+	Partio::ParticlesDataMutable* partPD = ParticleBufferCache::Shared().Acquire(partitionTarget, layout, partition->ParticleCount, HasExtension(partition->FileName, ".prt"));
+
+	for (int i=0; i < pPD->numAttributes() && partition->ParticleCount > 0; i++)
+	{
+		Partio::ParticleAttribute attr, partAttr;
+		pPD->attributeInfo(i, attr);
+		partPD->attributeInfo(attr.name.c_str(), partAttr);
+		const size_t elementSize = attr.count * sizeof(float);
+		const size_t stride = PartioAttributeStride(pPD, attr);
+		CopyStrided(PartioData(pPD, attr) + partition->FirstParticle*stride, stride, PartioData(partPD, partAttr), PartioAttributeStride(partPD, partAttr), elementSize, partition->ParticleCount);
+	}
+
+	Partio::ParticleAttribute attr;
+	if (!positionChannel->empty() && partPD->attributeInfo(positionChannel->c_str(), attr))
+	{
+		for (int p=0; p < partition->ParticleCount; p++)
+		{
+			const float* position = partPD->data<float>(attr, p);
+			if (!std::isfinite(position[0]) || !std::isfinite(position[1]) || !std::isfinite(position[2]))
+				continue;
+			for (int a=0; a < 3; a++)
+			{
+				partition->Min[a] = partition->HasBounds ? std::min(partition->Min[a], position[a]) : position[a];
+				partition->Max[a] = partition->HasBounds ? std::max(partition->Max[a], position[a]) : position[a];
+			}
+			partition->HasBounds = true;
+		}
+	}
+	if (!idChannel->empty() && partPD->attributeInfo(idChannel->c_str(), attr))
+	{
+		for (int p=0; p < partition->ParticleCount; p++)
+		{
+			const int id = *partPD->data<int>(attr, p);
+			partition->MinId = partition->HasIds ? std::min(partition->MinId, id) : id;
+			partition->MaxId = partition->HasIds ? std::max(partition->MaxId, id) : id;
+			partition->HasIds = true;
+		}
+	}
+
+	*error = WritePartioFile(partPD, partition->ParticleCount, partition->FileName, partitionTarget, *options, *halfChannels);
+}
+
+// split=<n>: orders the particles by tile or ID and writes n consecutive ranges of about the same size as separate
+// files, all at the same time on the worker pool, followed by the manifest
+std::string WritePartitions(Partio::ParticlesDataMutable* pPD, int numParticles, const std::string& fileName, const std::string& target, const ExportOptions& options, const std::vector<std::string>& halfChannels, const std::string& positionChannel, const std::string& idChannel, FrameProfile* profile)
+{
+	{
+		ScopedStageTimer timer(profile, ExportStageSort);
+		if (options.SplitBy == ExportOptions::SplitById)
+		{
+			SortParticlesById(pPD, numParticles, idChannel);
+		}
+		else
+		{
+			SpatialIndex index;
+			SortParticles(pPD, numParticles, positionChannel, options.Sort != SpatialOrderNone ? options.Sort : SpatialOrderHilbert, 1, index);
+		}
+	}
+
+	ScopedStageTimer timer(profile, ExportStageWrite);
+
+	std::vector<PartitionInfo> partitions(options.SplitCount);
+	std::vector<std::string> errors(options.SplitCount);
+	std::vector< std::function<void()> > tasks;
+	for (int i=0; i < options.SplitCount; i++)
+	{
+		partitions[i].FileName = GetPartitionFileName(fileName, i, options.SplitCount);
+		partitions[i].FirstParticle = int((long long)numParticles * i / options.SplitCount);
+		partitions[i].ParticleCount = int((long long)numParticles * (i + 1) / options.SplitCount) - partitions[i].FirstParticle;
+		tasks.push_back(std::bind(&WritePartition, pPD, target, i, &options, &halfChannels, &positionChannel, &idChannel, &partitions[i], &errors[i]));
+	}
+	WorkerPool::Shared().Run(tasks);
+	ParticleBufferCache::Shared().Release(target, pPD);
+
+	for (int i=0; i < options.SplitCount; i++)
+	{
+		if (!errors[i].empty())
+			return errors[i];
+	}
+	if (options.SplitBy == ExportOptions::SplitById)
+		return WritePartitionManifest(fileName, "id", std::string(), partitions);
+	return WritePartitionManifest(fileName, "tile", options.Sort == SpatialOrderMorton ? "morton" : "hilbert", partitions);
+}
+
+// Writes a converted export, sorted or split if asked for, and releases its particle set. Runs on the write queue's
+// thread so it must not touch the SDK. Finishes the frame's profile.
+std::string WriteFrame(const std::shared_ptr<PendingExport>& pending)
+{
+	Partio::ParticlesDataMutable* pPD = pending->pPD;
+	pending->pPD = NULL; // released by the writers
+	const std::string& fileName = pending->outputFName;
+	const ExportOptions& options = pending->options;
+	FrameProfile* profile = pending->profile.get();
+
+	std::string error;
+	if (pending->split)
+	{
+		error = WritePartitions(pPD, pending->particleCount, fileName, pending->target, options, pending->halfChannels, pending->positionChannel, pending->idChannel, profile);
+	}
+	else
+	{
+		const bool sort = options.Sort != SpatialOrderNone && !pending->positionChannel.empty();
+		SpatialIndex index;
+		if (sort)
+		{
+			ScopedStageTimer timer(profile, ExportStageSort);
+			SortParticles(pPD, pending->particleCount, pending->positionChannel, options.Sort, options.GridResolution, index);
+		}
+
+		ScopedStageTimer timer(profile, ExportStageWrite);
+		if (pending->mappedFile)
+		{
+			// the data is already in the file, this only adds the checksum
+			error = pending->mappedFile->Close(WorkerPool::Shared());
+			pending->mappedFile.reset();
+			if (!error.empty())
+				remove(fileName.c_str());
+		}
+		else
+		{
+			error = WritePartioFile(pPD, pending->particleCount, fileName, pending->target, options, pending->halfChannels);
+		}
+
+		// the index and manifest of an earlier sorted or split export would no longer match the file
+		const std::string indexFileName = fileName + ".idx";
+		if (error.empty() && sort)
+			error = WriteSpatialIndex(indexFileName, index);
+		else
+			remove(indexFileName.c_str());
+		remove(GetPartitionManifestFileName(fileName).c_str());
+	}
+
+	if (!pending->arrayFiles.empty())
+	{
+		ScopedStageTimer timer(profile, ExportStageWrite);
+		for (size_t i=0; i < pending->arrayFiles.size() && error.empty(); i++)
+		{
+			error = WriteArrayFile(pending->arrayFiles[i].FileName, pending->arrayFiles[i].Data, pending->particleCount);
+		}
+		pending->arrayFiles.clear();
+	}
+
+	if (error.empty() && !pending->cacheFileName.empty())
+		ExportCache::Shared().Store(pending->cacheFileName, pending->cacheSidecars, pending->contentHash);
+
+	ExportProfiler::Shared().EndFrame(pending->profile);
+	return error;
+}
+
+struct ExportPlanChannel
+{
+	int AttributeIndex; // index into ParticleSource::GetAttribute(), -1 for expression channels
+	ArrayChannel Array;
+	int ArraySize; // elements per particle of array values, 0 if the count isn't limited
+	std::string ArrayFile; // arrays=indexed: the name of the offset channel's array file, without the file name
+	int Expression; // channel=: index into ExportPlan::Expressions, -1 for attribute channels
+};
+
+// The result of matching an object's attributes against an export format and channel selection: which attributes
+// are exported and under what name and type. Resolving this means a lot of string lookups, so the plan is compiled
+// once per target and reused for every frame until the attribute set, the format or the channel selection changes.
+struct ExportPlan
+{
+	ExportPlan() : Format(NULL), ArrayMode(ExportOptions::ArraysOff), ArraySize(0), IndexedArrays(false) {}
+
+	const ExportFormat* Format;
+	std::vector<std::string> ChannelsToExport;
+	std::vector<std::string> HalfChannelsToExport; // as given in the options, source attribute names
+	ExportOptions::Arrays ArrayMode; // as given in the options
+	int ArraySize;
+	bool IndexedArrays; // some channels point into array files
+	std::string ExpressionKey; // filter= and channel= options, see GetExpressionKey
+	ExportExpression Filter; // all filters in one, not compiled if there aren't any
+	std::vector<ExportExpression> Expressions; // of the channel= channels
+	std::vector<std::string> AttributeSignature; // name, type and context of every attribute, used to spot changes
+	std::vector<ExportPlanChannel> Channels;
+	std::vector<ChannelLayout> Layout; // partio attribute for each entry of Channels
+	std::vector<std::string> HalfChannels; // partio names of the channels to write at half precision
+	std::string PositionChannel; // partio names of PointPosition and ID, empty if they aren't exported
+	std::string IdChannel;
+	std::vector<std::string> Warnings;
+};
+
+static std::map<std::string, ExportPlan> exportPlans;
+
+std::string GetAttributeSignature(ParticleAttributeSource& attr)
+{
+	std::ostringstream ss;
+	ss << attr.GetName() << ":" << attr.GetDataType() << ":" << attr.IsPerPoint() << ":" << attr.IsArray();
+	return ss.str();
+}
+
+// arrays=fixed: <name> holds the first arraysize elements of every particle and <name>Count how many of them are set.
+// arrays=indexed: <name>Offset and <name>Count say where each particle's elements are in the array file.
+void AddArrayChannels(ExportPlan& plan, const ExportOptions& options, int attributeIndex, const std::string& attrName, const std::string& destName, const DataMap& dataMap)
+{
+	if (options.ArrayMode == ExportOptions::ArraysIndexed)
+	{
+		ExportPlanChannel offsets = { attributeIndex, ArrayChannelOffset, 0, destName, -1 };
+		ChannelLayout offsetLayout = { destName + "Offset", Partio::INT, 1 };
+		plan.Channels.push_back(offsets);
+		plan.Layout.push_back(offsetLayout);
+		plan.IndexedArrays = true;
+	}
+	else
+	{
+		ExportPlanChannel values = { attributeIndex, ArrayChannelValues, options.ArraySize, std::string(), -1 };
+		ChannelLayout valueLayout = { destName, dataMap.AttributeType == Partio::INT ? Partio::INT : Partio::FLOAT, dataMap.Count * options.ArraySize };
+		plan.Channels.push_back(values);
+		plan.Layout.push_back(valueLayout);
+
+		if (std::find(options.HalfChannels.begin(), options.HalfChannels.end(), attrName) != options.HalfChannels.end())
+			plan.HalfChannels.push_back(destName);
+	}
+
+	ExportPlanChannel counts = { attributeIndex, ArrayChannelCount, options.ArrayMode == ExportOptions::ArraysIndexed ? 0 : options.ArraySize, std::string(), -1 };
+	ChannelLayout countLayout = { destName + "Count", Partio::INT, 1 };
+	plan.Channels.push_back(counts);
+	plan.Layout.push_back(countLayout);
+}
+
+std::string GetExpressionKey(const ExportOptions& options)
+{
+	std::string key;
+	for (size_t i=0; i < options.Filters.size(); i++)
+	{
+		key += "filter:" + options.Filters[i] + "\n";
+	}
+	for (size_t i=0; i < options.DerivedChannels.size(); i++)
+	{
+		key += "channel:" + options.DerivedChannels[i].Name + "=" + options.DerivedChannels[i].Expression + "\n";
+	}
+	return key;
+}
+
+// filter= and channel=: the filters are checked one at a time for the warnings and compiled into one expression
+void CompileExpressions(ParticleSource& source, const ExportOptions& options, ExportPlan& plan)
+{
+	std::string filters;
+	for (size_t i=0; i < options.Filters.size(); i++)
+	{
+		ExportExpression filter;
+		std::string error = filter.Compile(options.Filters[i], source);
+		if (error.empty() && filter.GetWidth() != 1)
+			error = "it has to be a single value";
+		if (!error.empty())
+		{
+			plan.Warnings.push_back("Ignoring filter \"" + options.Filters[i] + "\": " + error);
+			continue;
+		}
+		filters += (filters.empty() ? "(" : " && (") + options.Filters[i] + ")";
+	}
+	if (!filters.empty())
+		plan.Filter.Compile(filters, source);
+
+	for (size_t i=0; i < options.DerivedChannels.size(); i++)
+	{
+		const ExportOptions::DerivedChannel& derived = options.DerivedChannels[i];
+		bool exists = false;
+		for (size_t c=0; c < plan.Layout.size() && !exists; c++)
+		{
+			exists = plan.Layout[c].Name == derived.Name;
+		}
+		if (exists)
+		{
+			plan.Warnings.push_back("Skipping channel \"" + derived.Name + "\" because there already is a channel with that name");
+			continue;
+		}
+
+		ExportExpression expression;
+		std::string error = expression.Compile(derived.Expression, source);
+		if (!error.empty())
+		{
+			plan.Warnings.push_back("Skipping channel \"" + derived.Name + "\": " + error);
+			continue;
+		}
+
+		ExportPlanChannel channel = { -1, ArrayChannelNone, 0, std::string(), (int)plan.Expressions.size() };
+		ChannelLayout layout = { derived.Name, Partio::FLOAT, expression.GetWidth() };
+		plan.Channels.push_back(channel);
+		plan.Layout.push_back(layout);
+		plan.Expressions.push_back(expression);
+
+		if (std::find(options.HalfChannels.begin(), options.HalfChannels.end(), derived.Name) != options.HalfChannels.end())
+			plan.HalfChannels.push_back(derived.Name);
+	}
+}
+
+void CompileExportPlan(ParticleSource& source, const ExportFormat& format, const ExportOptions& options, ExportPlan& plan)
+{
+	const std::vector<std::string>& channelsToExport = options.Channels;
+
+	plan.Format = &format;
+	plan.ChannelsToExport = channelsToExport;
+	plan.HalfChannelsToExport = options.HalfChannels;
+	plan.ArrayMode = options.ArrayMode;
+	plan.ArraySize = options.ArraySize;
+	plan.IndexedArrays = false;
+	plan.ExpressionKey = GetExpressionKey(options);
+	plan.Filter = ExportExpression();
+	plan.Expressions.clear();
+	plan.Channels.clear();
+	plan.Layout.clear();
+	plan.HalfChannels.clear();
+	plan.PositionChannel.clear();
+	plan.IdChannel.clear();
+	plan.Warnings.clear();
+
+	for (int i=0; i < source.GetAttributeCount(); i++)
+	{
+		ParticleAttributeSource& attr = source.GetAttribute(i);
+		if (!attr.IsPerPoint())
+			continue;
+
+		std::string attrName = attr.GetName();
+		if (attr.IsArray() && options.ArrayMode == ExportOptions::ArraysOff)
+		{
+			plan.Warnings.push_back("Skipping ICEAttribute: \"" + attrName + "\" because it is a per point array (see the arrays option)");
+			continue;
+		}
+
+		std::map<ParticleDataType,DataMap>::const_iterator pos = format.DataMapping.find(attr.GetDataType());
+		if (pos == format.DataMapping.end())
+		{
+			// unmapped data type, have to skip for now
+			plan.Warnings.push_back("Skipping ICEAttribute: \"" + attrName + "\" due to unsupported data type");
+			continue;
+		}
+		DataMap dataMap = pos->second;
+
+		// if (channelsToExport.size() == 0) then export all channels, else
+		if (channelsToExport.size() != 0 && channelsToExport.end() == std::find(channelsToExport.begin(), channelsToExport.end(), attrName))
+		{
+			plan.Warnings.push_back("Skipping ICEAttribute: \"" + attrName + "\" because it was not selected for export");
+			continue;
+		}
+
+		std::string destName(attrName);
+		std::map<std::string,std::string>::const_iterator namePos = format.ChannelNameMapping.find(destName);
+		if (namePos != format.ChannelNameMapping.end())
+		{
+			destName = namePos->second;
+		}
+
+		if (attr.IsArray())
+		{
+			AddArrayChannels(plan, options, i, attrName, destName, dataMap);
+			continue;
+		}
+
+		ExportPlanChannel channel = { i, ArrayChannelNone, 0, std::string(), -1 };
+		ChannelLayout layout = { destName, dataMap.AttributeType, dataMap.Count };
+		plan.Channels.push_back(channel);
+		plan.Layout.push_back(layout);
+
+		if (std::find(options.HalfChannels.begin(), options.HalfChannels.end(), attrName) != options.HalfChannels.end())
+			plan.HalfChannels.push_back(destName);
+
+		if (attrName == "PointPosition" && dataMap.AttributeType != Partio::INT && dataMap.Count >= 3)
+			plan.PositionChannel = destName;
+		if (attrName == "ID" && dataMap.AttributeType == Partio::INT && dataMap.Count == 1)
+			plan.IdChannel = destName;
+	}
+
+	CompileExpressions(source, options, plan);
+}
+
+// returns the cached plan for a target, recompiling it if anything it depends on changed
+ExportPlan& GetExportPlan(ParticleSource& source, const ExportFormat& format, const ExportOptions& options)
+{
+	std::vector<std::string> signature;
+	for (int i=0; i < source.GetAttributeCount(); i++)
+	{
+		signature.push_back(GetAttributeSignature(source.GetAttribute(i)));
+	}
+
+	ExportPlan& plan = exportPlans[source.GetTarget()];
+	if (plan.Format != &format || plan.ChannelsToExport != options.Channels || plan.HalfChannelsToExport != options.HalfChannels || plan.ArrayMode != options.ArrayMode || plan.ArraySize != options.ArraySize || plan.ExpressionKey != GetExpressionKey(options) || plan.AttributeSignature != signature)
+	{
+		CompileExportPlan(source, format, options, plan);
+		plan.AttributeSignature.swap(signature);
+	}
+	return plan;
+}
+
+// stream=on: fetches, converts and writes an object one chunk of particles at a time, so only one chunk is ever held
+// in memory no matter how many particles there are. Runs on the calling thread, with the conversion and compression
+// of each chunk on the worker pool. Filters, expression channels and indexed arrays need every particle at once, the
+// caller writes those in one piece.
+std::string StreamExport(ParticleSource& source, const ExportPlan& plan, const ExportOptions& options, const std::string& target, const std::string& fileName, int particleCount, FrameProfile* profile)
+{
+	if (!plan.Filter.GetText().empty() || !plan.Expressions.empty() || plan.IndexedArrays)
+		return "Filters, expression channels and indexed arrays can't be streamed: " + fileName;
+
+	ExportProfiler& profiler = ExportProfiler::Shared();
+	const int chunkSize = std::max(1, std::min(options.StreamChunkSize, particleCount));
+
+	Partio::ParticlesDataMutable* pPD;
+	{
+		ScopedStageTimer timer(profile, ExportStageAllocate);
+		pPD = ParticleBufferCache::Shared().Acquire(target, plan.Layout, chunkSize, true); // writes count particles of it per chunk
+	}
+
+	std::vector<Partio::ParticleAttribute> partioAttrs(plan.Channels.size());
+	std::vector<int> profileAttributes(plan.Channels.size());
+	for (size_t i=0; i < plan.Channels.size(); i++)
+	{
+		pPD->attributeInfo(plan.Layout[i].Name.c_str(), partioAttrs[i]);
+		profileAttributes[i] = profiler.AddAttribute(profile, plan.Layout[i].Name, size_t(particleCount) * partioAttrs[i].count * sizeof(float));
+	}
+
+	PrtStreamWriter writer(WorkerPool::Shared());
+	std::string error;
+	{
+		ScopedStageTimer timer(profile, ExportStageWrite);
+		error = writer.Open(fileName, *pPD, particleCount, options, plan.HalfChannels);
+	}
+
+	for (int begin=0; begin < particleCount && error.empty(); begin += chunkSize)
+	{
+		int count = std::min(chunkSize, particleCount - begin);
+
+		std::vector< std::unique_ptr<AttributeConverter> > converters;
+		for (size_t i=0; i < plan.Channels.size(); i++)
+		{
+			ScopedStageTimer timer(profile, ExportStageFetch, profileAttributes[i]);
+			if (i > 0 && plan.Channels[i].AttributeIndex == plan.Channels[i-1].AttributeIndex)
+				converters.push_back(std::unique_ptr<AttributeConverter>(new AttributeConverter(converters.back()->GetData(), pPD, partioAttrs[i])));
+			else
+				converters.push_back(std::unique_ptr<AttributeConverter>(new AttributeConverter(source.GetAttribute(plan.Channels[i].AttributeIndex), begin, count, pPD, partioAttrs[i])));
+			converters.back()->SetProfile(profile, profileAttributes[i]);
+			converters.back()->SetRotationConvention(options.Rotation);
+			converters.back()->SetArrayChannel(plan.Channels[i].Array, plan.Channels[i].ArraySize);
+		}
+
+		std::vector< std::function<void()> > tasks;
+		AddConvertTasks(converters, count, tasks);
+		WorkerPool::Shared().Run(tasks);
+		converters.clear();
+
+		ScopedStageTimer timer(profile, ExportStageWrite);
+		error = writer.Write(*pPD, count);
+	}
+
+	if (error.empty())
+	{
+		ScopedStageTimer timer(profile, ExportStageWrite);
+		error = writer.Close();
+	}
+
+	ParticleBufferCache::Shared().Release(target, pPD);
+	return error;
+}
+
+// skip=on: everything besides the channel data that ends up in the file, bump the version when the output changes
+HashValue HashExportSettings(const ExportPlan& plan, const ExportOptions& options, int particleCount)
+{
+	std::ostringstream ss;
+	ss << "partio export 1|" << particleCount << "|" << options.Compress << "|" << options.CompressionLevel << "|" << options.HalfPrecision;
+	ss << "|" << options.Sort << "|" << options.GridResolution << "|" << options.SplitCount << "|" << options.SplitBy;
+	for (size_t i=0; i < plan.Channels.size(); i++)
+	{
+		const ExportPlanChannel& channel = plan.Channels[i];
+		ss << "|" << (channel.Expression >= 0 ? "expression:" + plan.Expressions[channel.Expression].GetText() : plan.AttributeSignature[channel.AttributeIndex]) << ">" << plan.Layout[i].Name << ":" << plan.Layout[i].AttributeType << ":" << plan.Layout[i].Count;
+	}
+	for (size_t i=0; i < plan.HalfChannels.size(); i++)
+	{
+		ss << "|half:" << plan.HalfChannels[i];
+	}
+	if (options.Rotation != RotationNative)
+		ss << "|rotation:" << GetRotationConventionName(options.Rotation);
+	if (!plan.Filter.GetText().empty())
+		ss << "|filter:" << plan.Filter.GetText();
+	const std::string settings = ss.str();
+	return Hash64(settings.data(), settings.size());
+}
+
+// skip=on: hashes the fetched data of every export on the worker pool and drops the ones whose files are unchanged
+void SkipUnchangedExports(std::vector< std::unique_ptr<PendingExport> >& exports, ExportLog& log)
+{
+	std::vector< std::vector<HashValue> > chunkHashes(exports.size());
+	std::vector< std::function<void()> > tasks;
+	for (size_t exportIndex=0; exportIndex < exports.size(); exportIndex++)
+	{
+		PendingExport& pending = *exports[exportIndex];
+		if (pending.cacheFileName.empty())
+			continue;
+
+		const int chunkCount = (pending.particleCount + conversionChunkSize - 1) / conversionChunkSize;
+		chunkHashes[exportIndex].resize(pending.converters.size() * chunkCount);
+		for (size_t i=0; i < pending.converters.size(); i++)
+		{
+			for (int chunk=0; chunk < chunkCount; chunk++)
+			{
+				int begin = chunk * conversionChunkSize;
+				int end = std::min(begin + conversionChunkSize, pending.particleCount);
+				tasks.push_back(std::bind(&AttributeConverter::HashChunk, pending.converters[i].get(), begin, end, &chunkHashes[exportIndex][i*chunkCount + chunk]));
+			}
+		}
+	}
+	WorkerPool::Shared().Run(tasks);
+
+	std::vector< std::unique_ptr<PendingExport> > remaining;
+	for (size_t exportIndex=0; exportIndex < exports.size(); exportIndex++)
+	{
+		PendingExport& pending = *exports[exportIndex];
+		if (!pending.cacheFileName.empty())
+		{
+			const std::vector<HashValue>& hashes = chunkHashes[exportIndex];
+			pending.contentHash = hashes.empty() ? pending.settingsHash : Hash64(&hashes[0], hashes.size() * sizeof(HashValue), pending.settingsHash);
+			if (ExportCache::Shared().IsUnchanged(pending.cacheFileName, pending.cacheSidecars, pending.contentHash))
+			{
+				log.Log("Skipping unchanged file: " + pending.cacheFileName, ExportLogInfo);
+				ExportProfiler::Shared().EndFrame(pending.profile);
+				continue; // releases the particle set
+			}
+		}
+		remaining.push_back(std::move(exports[exportIndex]));
+	}
+	exports.swap(remaining);
+}
+
+// Uncompressed PRT files that are written as they are converted (not sorted, split or rounded to half precision) are
+// converted straight into a mapped file, see PrtMappedWriter. With mmap=on, reason says why a file isn't.
+bool CanWriteMapped(const std::string& fileName, const ExportOptions& options, const ExportPlan& plan, bool split, std::string& reason)
+{
+	// mmap=on is the default, so other formats don't need a reason
+	reason.clear();
+	if (!options.MappedWrites || !HasExtension(fileName, ".prt"))
+		return false;
+
+	if (options.Compress != ExportOptions::CompressionOff && options.CompressionLevel != 0)
+		reason = "compressed PRT files can't be written through a memory mapping (use compress=off or level=0)";
+	else if (options.HalfPrecision || !plan.HalfChannels.empty())
+		reason = "half precision channels can't be written through a memory mapping";
+	else if (split)
+		reason = "split files can't be written through a memory mapping";
+	else if (options.Sort != SpatialOrderNone && !plan.PositionChannel.empty())
+		reason = "sorted files can't be written through a memory mapping";
+	return reason.empty();
+}
+
+// creates the mapped files of the exports that weren't skipped and points their converters at them, falls back to a
+// regular particle set if a file can't be mapped
+void OpenMappedFiles(std::vector< std::unique_ptr<PendingExport> >& exports, ExportLog& log)
+{
+	for (size_t exportIndex=0; exportIndex < exports.size(); exportIndex++)
+	{
+		PendingExport& pending = *exports[exportIndex];
+		if (!pending.mapped)
+			continue;
+
+		ScopedStageTimer timer(pending.profile.get(), ExportStageAllocate);
+		pending.mappedFile.reset(new PrtMappedWriter());
+		std::string error = pending.mappedFile->Open(pending.outputFName, pending.mappedAttributes, pending.particleCount);
+		if (error.empty())
+		{
+			for (size_t i=0; i < pending.converters.size(); i++)
+			{
+				pending.converters[i]->SetTarget(GetMappedTarget(pending.mappedFile->GetChannel((int)i)));
+			}
+			continue;
+		}
+
+		log.Log(error + ", writing it without mapping", ExportLogWarning);
+		pending.mappedFile.reset();
+		pending.mapped = false;
+
+		std::vector<ChannelLayout> layout;
+		for (size_t i=0; i < pending.mappedAttributes.size(); i++)
+		{
+			ChannelLayout channel = { pending.mappedAttributes[i].name, pending.mappedAttributes[i].type, pending.mappedAttributes[i].count };
+			layout.push_back(channel);
+		}
+		pending.pPD = ParticleBufferCache::Shared().Acquire(pending.target, layout, pending.particleCount, true); // only PRT is mapped
+		for (size_t i=0; i < pending.converters.size(); i++)
+		{
+			Partio::ParticleAttribute partioAttr;
+			pending.pPD->attributeInfo((int)i, partioAttr);
+			pending.converters[i]->SetTarget(GetPartioTarget(pending.pPD, partioAttr));
+		}
+	}
+}
+
+// the fetched data of the attributes an expression reads, in the order of its GetAttributes()
+std::vector<ParticleDataArray> GetExpressionInputs(ParticleSource& source, const ExportExpression& expression, std::map<int, ParticleDataArray>& fetched, FrameProfile* profile)
+{
+	std::vector<ParticleDataArray> inputs;
+	for (size_t i=0; i < expression.GetAttributes().size(); i++)
+	{
+		const int attributeIndex = expression.GetAttributes()[i];
+		std::map<int, ParticleDataArray>::iterator pos = fetched.find(attributeIndex);
+		if (pos == fetched.end())
+		{
+			ScopedStageTimer timer(profile, ExportStageFetch);
+			pos = fetched.insert(std::make_pair(attributeIndex, ParticleDataArray())).first;
+			source.GetAttribute(attributeIndex).GetData(pos->second);
+		}
+		inputs.push_back(pos->second);
+	}
+	return inputs;
+}
+
+// filter= and channel=: fetches the attributes the expressions read, puts the particles that pass the filter into
+// selection and evaluates the expression channels for them. Both run on the worker pool, a conversion chunk per task.
+void EvaluateExpressions(ParticleSource& source, const ExportPlan& plan, int particleCount, std::map<int, ParticleDataArray>& fetched, std::vector<unsigned int>& selection, std::vector<ParticleDataArray>& channels, FrameProfile* profile)
+{
+	const bool filtered = !plan.Filter.GetText().empty();
+	std::vector< std::vector<ParticleDataArray> > inputs;
+	std::vector< std::function<void()> > tasks;
+
+	if (filtered)
+	{
+		inputs.push_back(GetExpressionInputs(source, plan.Filter, fetched, profile));
+
+		ScopedStageTimer timer(profile, ExportStageFilter);
+		std::vector< std::vector<unsigned int> > chunkSelections((particleCount + conversionChunkSize - 1) / conversionChunkSize);
+		for (int begin=0; begin < particleCount; begin += conversionChunkSize)
+		{
+			tasks.push_back(std::bind(&ExportExpression::Select, &plan.Filter, std::cref(inputs.back()), begin, std::min(begin + conversionChunkSize, particleCount), std::ref(chunkSelections[begin / conversionChunkSize])));
+		}
+		WorkerPool::Shared().Run(tasks);
+		tasks.clear();
+
+		selection.clear();
+		for (size_t i=0; i < chunkSelections.size(); i++)
+		{
+			selection.insert(selection.end(), chunkSelections[i].begin(), chunkSelections[i].end());
+		}
+	}
+
+	// the inputs have to stay where they are while the tasks run
+	const size_t filterInputs = inputs.size();
+	for (size_t i=0; i < plan.Expressions.size(); i++)
+	{
+		inputs.push_back(GetExpressionInputs(source, plan.Expressions[i], fetched, profile));
+	}
+
+	ScopedStageTimer timer(profile, ExportStageFilter);
+	const int count = filtered ? (int)selection.size() : particleCount;
+	const unsigned int* selected = filtered && count > 0 ? &selection[0] : NULL;
+	channels.resize(plan.Expressions.size());
+	for (size_t i=0; i < plan.Expressions.size() && count > 0; i++)
+	{
+		const ExportExpression& expression = plan.Expressions[i];
+		const int width = expression.GetWidth();
+		std::shared_ptr< std::vector<float> > buffer(new std::vector<float>(size_t(count) * width));
+		for (int begin=0; begin < count; begin += conversionChunkSize)
+		{
+			tasks.push_back(std::bind(&ExportExpression::Evaluate, &expression, std::cref(inputs[filterInputs + i]), selected, begin, std::min(begin + conversionChunkSize, count), &(*buffer)[size_t(begin) * width]));
+		}
+
+		channels[i].Data = &(*buffer)[0];
+		channels[i].Stride = width * sizeof(float);
+		channels[i].Components = width;
+		channels[i].Owner = buffer;
+	}
+	WorkerPool::Shared().Run(tasks);
+}
+
+ExportBatch::ExportBatch(ExportLog& log)
+	: m_log(log)
+{
+}
+
+ExportBatch::~ExportBatch()
+{
+}
+
+// fetches everything needed to export an object, this is the part that has to run on the main thread
+bool ExportBatch::Add(ParticleSource& source, const ExportFormat& format, const ExportOptions& options, const std::string& fileName)
+{
+	std::unique_ptr<PendingExport> pending(new PendingExport);
+
+	ExportProfiler& profiler = ExportProfiler::Shared();
+	profiler.Configure(options.Profile, options.TraceFile);
+	pending->profile = profiler.BeginFrame(source.GetTarget(), fileName);
+	FrameProfile* profile = pending->profile.get();
+
+	int particleCount;
+	{
+		ScopedStageTimer timer(profile, ExportStageGeometry); // sources load their geometry on first use
+		particleCount = source.GetParticleCount();
+	}
+	if (profile != NULL)
+		profile->Particles = particleCount;
+
+	pending->target = source.GetTarget();
+	ExportPlan* plan;
+	{
+		ScopedStageTimer timer(profile, ExportStagePlan);
+		plan = &GetExportPlan(source, format, options);
+	}
+
+	for (std::vector<std::string>::const_iterator iter = plan->Warnings.begin(); iter != plan->Warnings.end(); ++iter)
+	{
+		m_log.Log(*iter, ExportLogWarning);
+	}
+
+	if (options.StreamChunkSize > 0 && particleCount > 0)
+	{
+		if (HasExtension(fileName, ".prt") && plan->IndexedArrays)
+		{
+			m_log.Log("Indexed arrays need all particles in memory, writing " + fileName + " in one piece", ExportLogWarning);
+		}
+		else if (HasExtension(fileName, ".prt") && (!plan->Filter.GetText().empty() || !plan->Expressions.empty()))
+		{
+			m_log.Log("Filters and expression channels need all particles in memory, writing " + fileName + " in one piece", ExportLogWarning);
+		}
+		else if (HasExtension(fileName, ".prt"))
+		{
+			std::ostringstream ss;
+			ss << "Streaming " << particleCount << " particles with " << plan->Layout.size() << " channels to file at path: " << fileName;
+			m_log.Log(ss.str(), ExportLogInfo);
+
+			if (options.Sort != SpatialOrderNone)
+				m_log.Log("Sorting needs all particles in memory, streaming " + fileName + " unsorted", ExportLogWarning);
+			if (options.SplitCount > 1)
+				m_log.Log("Splitting needs all particles in memory, streaming " + fileName + " as one file", ExportLogWarning);
+			if (options.SkipUnchanged)
+				m_log.Log("Unchanged files can't be skipped when streaming, writing " + fileName, ExportLogWarning);
+			if (options.MappedWrites && (options.Compress == ExportOptions::CompressionOff || options.CompressionLevel == 0))
+				m_log.Log("mmap=on: streamed files can't be written through a memory mapping, writing " + fileName + " the regular way", ExportLogVerbose);
+
+			std::string error = StreamExport(source, *plan, options, pending->target, fileName, particleCount, profile);
+			profiler.EndFrame(pending->profile);
+			if (error.empty())
+				return true;
+
+			remove(fileName.c_str());
+			m_log.Log(error, ExportLogError);
+			return false;
+		}
+		else
+		{
+			m_log.Log("Streaming is only supported for PRT files, writing " + fileName + " in one piece", ExportLogWarning);
+		}
+	}
+
+	// filter= and channel=, the converters below only see the particles that passed the filters
+	std::map<int, ParticleDataArray> fetched;
+	std::vector<unsigned int> selection;
+	std::vector<ParticleDataArray> expressionChannels;
+	const bool filtered = !plan->Filter.GetText().empty() && particleCount > 0;
+	if (particleCount > 0 && (filtered || !plan->Expressions.empty()))
+	{
+		EvaluateExpressions(source, *plan, particleCount, fetched, selection, expressionChannels, profile);
+		if (filtered)
+			particleCount = (int)selection.size();
+		if (profile != NULL)
+			profile->Particles = particleCount;
+	}
+
+	pending->particleCount = particleCount;
+	pending->outputFName = fileName;
+	pending->options = options;
+	pending->halfChannels = plan->HalfChannels;
+
+	pending->positionChannel = plan->PositionChannel;
+	pending->idChannel = plan->IdChannel;
+	if (options.SplitCount > 1)
+	{
+		pending->split = !(options.SplitBy == ExportOptions::SplitById ? plan->IdChannel : plan->PositionChannel).empty();
+		if (options.SplitBy == ExportOptions::SplitById && plan->IdChannel.empty())
+			m_log.Log("Splitting by ID needs the ID channel, writing " + fileName + " as one file", ExportLogWarning);
+		else if (options.SplitBy == ExportOptions::SplitByTile && plan->PositionChannel.empty())
+			m_log.Log("Splitting by tile needs the PointPosition channel, writing " + fileName + " as one file", ExportLogWarning);
+	}
+	else if (options.Sort != SpatialOrderNone && plan->PositionChannel.empty())
+	{
+		m_log.Log("Sorting needs the PointPosition channel, writing " + fileName + " unsorted", ExportLogWarning);
+	}
+
+	if (options.SkipUnchanged)
+	{
+		pending->cacheFileName = pending->split ? GetPartitionManifestFileName(fileName) : fileName;
+		pending->settingsHash = HashExportSettings(*plan, options, particleCount);
+		if (pending->split)
+		{
+			for (int i=0; i < options.SplitCount; i++)
+				pending->cacheSidecars.push_back(GetPartitionFileName(fileName, i, options.SplitCount));
+		}
+		else if (options.Sort != SpatialOrderNone && !plan->PositionChannel.empty())
+		{
+			pending->cacheSidecars.push_back(fileName + ".idx");
+		}
+	}
+
+	std::string unmappedReason;
+	pending->mapped = CanWriteMapped(fileName, options, *plan, pending->split, unmappedReason);
+	if (!unmappedReason.empty())
+		m_log.Log("mmap=on: " + unmappedReason + ", writing " + fileName + " the regular way", ExportLogVerbose);
+	if (pending->mapped)
+	{
+		for (size_t i=0; i < plan->Layout.size(); i++)
+		{
+			Partio::ParticleAttribute attr;
+			attr.name = plan->Layout[i].Name;
+			attr.type = plan->Layout[i].AttributeType;
+			attr.count = plan->Layout[i].Count;
+			attr.attributeIndex = (int)i;
+			pending->mappedAttributes.push_back(attr);
+		}
+	}
+	else
+	{
+		// reuses the particle set of a previous frame if the channels haven't changed
+		ScopedStageTimer timer(profile, ExportStageAllocate);
+		pending->pPD = ParticleBufferCache::Shared().Acquire(pending->target, plan->Layout, particleCount, HasExtension(fileName, ".prt"));
+	}
+
+	Partio::ParticlesDataMutable* pPD = pending->pPD;
+
+	if (!options.Delta)
+		deltaChannels.erase(pending->target);
+
+	// don't try to access the data if the particle count is 0, it will just generate error 2392
+	for (size_t i=0; i < plan->Channels.size() && particleCount > 0; i++)
+	{
+		const ExportPlanChannel& channel = plan->Channels[i];
+
+		Partio::ParticleAttribute partioAttr;
+		if (pPD != NULL)
+			pPD->attributeInfo(plan->Layout[i].Name.c_str(), partioAttr);
+		else
+			partioAttr = pending->mappedAttributes[i];
+
+		int profileAttribute = profiler.AddAttribute(profile, plan->Layout[i].Name, size_t(particleCount) * partioAttr.count * sizeof(float));
+		if (channel.Expression >= 0)
+		{
+			pending->converters.push_back(std::unique_ptr<AttributeConverter>(new AttributeConverter(expressionChannels[channel.Expression], pPD, partioAttr)));
+		}
+		else if (i > 0 && channel.AttributeIndex == plan->Channels[i-1].AttributeIndex)
+		{
+			// the other channel of an array attribute
+			pending->converters.push_back(std::unique_ptr<AttributeConverter>(new AttributeConverter(pending->converters.back()->GetData(), pPD, partioAttr)));
+		}
+		else if (filtered || fetched.count(channel.AttributeIndex) != 0)
+		{
+			ParticleDataArray data;
+			std::map<int, ParticleDataArray>::const_iterator pos = fetched.find(channel.AttributeIndex);
+			if (pos != fetched.end())
+			{
+				data = pos->second;
+			}
+			else
+			{
+				ScopedStageTimer timer(profile, ExportStageFetch, profileAttribute);
+				source.GetAttribute(channel.AttributeIndex).GetData(data);
+			}
+
+			if (filtered)
+			{
+				ScopedStageTimer timer(profile, ExportStageFilter);
+				data = SelectParticles(data, selection);
+			}
+			pending->converters.push_back(std::unique_ptr<AttributeConverter>(new AttributeConverter(data, pPD, partioAttr)));
+		}
+		else
+		{
+			ScopedStageTimer timer(profile, ExportStageFetch, profileAttribute);
+			pending->converters.push_back(std::unique_ptr<AttributeConverter>(new AttributeConverter(source.GetAttribute(channel.AttributeIndex), pPD, partioAttr)));
+		}
+		pending->converters.back()->SetProfile(profile, profileAttribute);
+		pending->converters.back()->SetRotationConvention(options.Rotation);
+		pending->converters.back()->SetArrayChannel(channel.Array, channel.ArraySize);
+
+		if (channel.Array == ArrayChannelOffset)
+		{
+			PendingArrayFile arrayFile = { GetArrayFileName(fileName, channel.ArrayFile), pending->converters.back()->GetData() };
+			pending->arrayFiles.push_back(arrayFile);
+			if (!pending->cacheFileName.empty())
+				pending->cacheSidecars.push_back(arrayFile.FileName);
+		}
+
+		if (options.Delta)
+		{
+			// keyed by the source attribute and rotation convention too so a channel filled differently starts over
+			std::string sourceName = channel.Expression >= 0 ? "expression:" + plan->Expressions[channel.Expression].GetText() : source.GetAttribute(channel.AttributeIndex).GetName();
+			std::string key = plan->Layout[i].Name + "|" + sourceName + "|" + GetRotationConventionName(options.Rotation);
+			DeltaChannel* delta = &deltaChannels[pending->target][key];
+			pending->converters.back()->SetDelta(delta, particleCount);
+			pending->deltaChannels.push_back(delta);
+		}
+	}
+
+	m_exports.push_back(std::move(pending));
+	return true;
+}
+
+// converts the fetched data and queues the files for writing
+// writes the skip=on indexes that changed since the last call, returns true if one couldn't be saved
+bool SaveExportCache(ExportLog& log)
+{
+	std::vector<std::string> errors = ExportCache::Shared().Save();
+	for (std::vector<std::string>::const_iterator iter = errors.begin(); iter != errors.end(); ++iter)
+	{
+		log.Log(*iter, ExportLogError);
+	}
+	return errors.size() != 0;
+}
+
+void ExportBatch::Finish()
+{
+	SkipUnchangedExports(m_exports, m_log);
+	OpenMappedFiles(m_exports, m_log);
+	ConvertAttributes(m_exports);
+
+	for (size_t i=0; i < m_exports.size(); i++)
+	{
+		PendingExport& pending = *m_exports[i];
+		pending.converters.clear(); // releases the fetched data before writing
+
+		if (!pending.deltaChannels.empty())
+		{
+			size_t reused = 0, total = 0;
+			for (size_t c=0; c < pending.deltaChannels.size(); c++)
+			{
+				const std::vector<char>& chunkReused = pending.deltaChannels[c]->ChunkReused;
+				reused += std::count(chunkReused.begin(), chunkReused.end(), 1);
+				total += chunkReused.size();
+			}
+			std::ostringstream ss;
+			ss << "Reused " << reused << " of " << total << " unchanged channel chunks from the previous frame";
+			m_log.Log(ss.str(), ExportLogVerbose);
+		}
+
+		const int channelCount = pending.pPD != NULL ? pending.pPD->numAttributes() : (int)pending.mappedAttributes.size();
+		std::ostringstream ss;
+		ss << "Writing " << pending.particleCount << " particles with " << channelCount << " channels to file at path: " << pending.outputFName;
+		m_log.Log(ss.str(), ExportLogInfo);
+
+		// the write and release happen on the write queue's thread, we can start on the next frame right away
+		const size_t bytes = pending.mappedFile ? pending.mappedFile->GetFileSize() : PartioDataSize(pending.pPD);
+		std::shared_ptr<PendingExport> write(m_exports[i].release());
+		WriteQueue::Shared().Push(std::bind(&WriteFrame, write), bytes);
+	}
+
+	m_exports.clear();
+
+	// frames written in the background show up on a later call, so do their skip=on index entries
+	ExportProfiler::Shared().LogFinishedFrames(m_log);
+	SaveExportCache(m_log);
+}
+
+bool ExportParticles(ParticleSource& source, const ExportFormat& format, const ExportOptions& options, const std::string& fileName, ExportLog& log)
+{
+	ExportBatch batch(log);
+	bool ok = batch.Add(source, format, options, fileName);
+	batch.Finish();
+	return ok;
+}
+
+// UserData is the same for every frame of a cache run, so only parse it when it changes
+const ExportOptions& GetExportOptions(const std::string& userData, ExportLog& log)
+{
+	static std::string parsedUserData;
+	static ExportOptions options;
+	static bool parsed = false;
+
+	if (!parsed || userData != parsedUserData)
+	{
+		// different options usually mean a new cache run, the profile totals are per run
+		if (ExportProfiler::Shared().IsEnabled())
+		{
+			WriteQueue::Shared().Flush();
+			ExportProfiler::Shared().EndRun(log);
+		}
+
+		options = ExportOptions();
+		ParseExportOptions(userData, options);
+		parsedUserData = userData;
+		parsed = true;
+
+		for (std::vector<std::string>::const_iterator iter = options.Warnings.begin(); iter != options.Warnings.end(); ++iter)
+		{
+			log.Log(*iter, ExportLogWarning);
+		}
+	}
+	return options;
+}
+
+bool LogWriteErrors(ExportLog& log)
+{
+	std::vector<std::string> writeErrors = WriteQueue::Shared().TakeErrors();
+	for (std::vector<std::string>::const_iterator iter = writeErrors.begin(); iter != writeErrors.end(); ++iter)
+	{
+		log.Log(*iter, ExportLogError);
+	}
+	return writeErrors.size() != 0;
+}
+
+bool FinishExportRun(ExportLog& log)
+{
+	WriteQueue::Shared().Flush();
+	bool writeFailed = LogWriteErrors(log);
+	writeFailed = SaveExportCache(log) || writeFailed;
+	ExportProfiler::Shared().EndRun(log);
+	return !writeFailed;
+}
+
+void ShutdownExporter(ExportLog& log)
+{
+	WriteQueue::Shared().Flush(); // finish any frames still being written
+	LogWriteErrors(log);
+	SaveExportCache(log);
+	WriteQueue::ShutdownShared();
+	ExportProfiler::Shared().EndRun(log);
+	ExportProfiler::ShutdownShared();
+	ExportCache::ShutdownShared();
+	ParticleBufferCache::ShutdownShared();
+	exportPlans.clear();
+	deltaChannels.clear();
+	WorkerPool::ShutdownShared();
+}
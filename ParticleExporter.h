@@ -0,0 +1,109 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by James Vecore
+// james.vecore@gmail.com
+
+
+
+#ifndef PARTIO_EXPORT_PARTICLE_EXPORTER_H
+#define PARTIO_EXPORT_PARTICLE_EXPORTER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+
+#include <Partio.h>
+
+#include "ParticleSource.h"
+#include "ExportOptions.h"
+
+// The export core: matches a particle source's attributes against an output format, converts them into partio
+// particle sets on the worker pool and queues the files for writing. Nothing in here depends on the Softimage SDK.
+
+struct DataMap
+{
+	Partio::ParticleAttributeType AttributeType;
+	int Count;
+};
+
+// channel naming and data type mapping for one output format, built once and shared by all frames
+struct ExportFormat
+{
+	std::map<std::string, std::string> ChannelNameMapping;
+	std::map<ParticleDataType, DataMap> DataMapping;
+};
+
+enum ExportFormatFamily
+{
+	ExportFormatPRT,
+	ExportFormatBGEO, // bgeo and geo
+	ExportFormatBIN,
+	ExportFormatPDA   // pda, pdb and pdc
+};
+
+const ExportFormat& GetExportFormat(ExportFormatFamily family);
+
+// the format family for a file extension (i.e. ".bgeo", case insensitive), false if it isn't supported
+bool GetExportFormatFamily(const std::string& extension, ExportFormatFamily& family);
+
+struct PendingExport;
+
+// Exports several objects of the same frame together: Add() fetches the data of each object on the calling (main)
+// thread, Finish() converts all of them in one batch on the worker pool and queues the files for writing. Streamed
+// objects (stream=on) are written by Add() right away. Add() returns false if an object failed to export, errors of
+// the queued writes are reported by LogWriteErrors() later on.
+class ExportBatch
+{
+public:
+	ExportBatch(ExportLog& log);
+	~ExportBatch();
+
+	bool Add(ParticleSource& source, const ExportFormat& format, const ExportOptions& options, const std::string& fileName);
+	void Finish();
+
+private:
+	ExportBatch(const ExportBatch&);
+	ExportBatch& operator=(const ExportBatch&);
+
+	ExportLog& m_log;
+	std::vector< std::unique_ptr<PendingExport> > m_exports;
+};
+
+// exports a single object
+bool ExportParticles(ParticleSource& source, const ExportFormat& format, const ExportOptions& options, const std::string& fileName, ExportLog& log);
+
+// parses UserData (see ExportOptions.h), the result is cached until UserData changes, warnings are logged once
+const ExportOptions& GetExportOptions(const std::string& userData, ExportLog& log);
+
+// logs the errors of any failed background writes, returns true if there were any
+bool LogWriteErrors(ExportLog& log);
+
+// waits for the queued writes of a run, saves their skip=on indexes and logs their errors and the run's profile, returns
+// false if a write or index failed
+bool FinishExportRun(ExportLog& log);
+
+// finishes pending writes and frees everything kept between frames
+void ShutdownExporter(ExportLog& log);
+
+#endif
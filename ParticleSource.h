@@ -0,0 +1,130 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by James Vecore
+// james.vecore@gmail.com
+
+
+
+#ifndef PARTIO_EXPORT_PARTICLE_SOURCE_H
+#define PARTIO_EXPORT_PARTICLE_SOURCE_H
+
+#include <string>
+#include <memory>
+
+// The export core (see ParticleExporter.h) only talks to the host application through the interfaces in this file,
+// so it builds and runs without the Softimage SDK. The plugin implements them on top of Geometry/ICEAttribute,
+// MemoryParticleSource.h has an in-memory version for running the export headless.
+
+// ICE data types the exporter knows how to convert
+enum ParticleDataType
+{
+	ParticleDataBool,
+	ParticleDataLong,
+	ParticleDataFloat,
+	ParticleDataVector2,
+	ParticleDataVector3,
+	ParticleDataVector4,
+	ParticleDataQuaternion,
+	ParticleDataColor4,
+	ParticleDataShape,
+	ParticleDataRotation,
+	ParticleDataMatrix3, // 9 floats, row by row
+	ParticleDataMatrix4, // 16 floats, row by row
+	ParticleDataUnsupported
+};
+
+// How the values of Quaternion and Rotation attributes are stored, the core converts them to the convention the
+// export asks for (see Rotation.h). ICE rotations can use any of these, Euler angles in x,y,z order.
+enum ParticleRotationForm
+{
+	ParticleRotationNone,       // not a rotation
+	ParticleRotationQuaternion, // x,y,z,w (w,x,y,z with WXYZ)
+	ParticleRotationAxisAngle,  // axis x,y,z, angle in radians
+	ParticleRotationEulerXYZ    // angles about x,y,z in radians applied in that order, w unused
+};
+
+// Per point data of one attribute, fetched on the main thread and read from the conversion tasks afterwards. Data
+// points at Components ints or floats per particle, Stride bytes apart (0 when all particles share one value). Sources
+// whose native layout differs convert to this layout when the data is fetched.
+//
+// Per point arrays (ParticleAttributeSource::IsArray) hold a variable number of elements per particle instead: Data
+// points at packed elements of Components values, particle i has ArrayCounts[i] of them starting at element
+// ArrayFirst[i]. Stride is the element size, or 0 when all particles share the arrays of particle 0.
+struct ParticleDataArray
+{
+	ParticleDataArray() : Data(NULL), Stride(0), Components(0), Int(false), WXYZ(false), Rotation(ParticleRotationNone), ArrayFirst(NULL), ArrayCounts(NULL) {}
+
+	const void* Data;
+	size_t Stride;
+	int Components;
+	bool Int;
+	bool WXYZ; // quaternion stored w first, exported x,y,z,w
+	ParticleRotationForm Rotation;
+	const unsigned int* ArrayFirst; // NULL unless the attribute is a per point array
+	const unsigned int* ArrayCounts;
+	std::shared_ptr<void> Owner; // keeps Data alive
+};
+
+class ParticleAttributeSource
+{
+public:
+	virtual ~ParticleAttributeSource() {}
+
+	virtual std::string GetName() const = 0;
+	virtual ParticleDataType GetDataType() const = 0;
+	virtual bool IsPerPoint() const = 0; // only per point attributes are exported
+	virtual bool IsArray() const = 0; // an array of values per point rather than a single one
+	virtual void GetData(ParticleDataArray& data) = 0;
+	// only the particles [begin, begin + count), used by streaming exports (stream=on, see ExportOptions.h)
+	virtual void GetDataChunk(int begin, int count, ParticleDataArray& data) = 0;
+};
+
+// one object at one frame
+class ParticleSource
+{
+public:
+	virtual ~ParticleSource() {}
+
+	virtual std::string GetTarget() const = 0; // unique name of the object, per object state is cached under it
+	virtual int GetParticleCount() = 0;
+	virtual int GetAttributeCount() = 0;
+	virtual ParticleAttributeSource& GetAttribute(int index) = 0;
+};
+
+enum ExportLogSeverity
+{
+	ExportLogError,
+	ExportLogWarning,
+	ExportLogInfo,
+	ExportLogVerbose
+};
+
+class ExportLog
+{
+public:
+	virtual ~ExportLog() {}
+
+	virtual void Log(const std::string& message, ExportLogSeverity severity) = 0;
+};
+
+#endif
@@ -31,86 +31,35 @@
 #include <xsi_point.h>
 #include <xsi_iceattribute.h>
 #include <xsi_iceattributedataarray.h>
+#include <xsi_iceattributedataarray2D.h>
 #include <xsi_vector2f.h>
 #include <xsi_vector3f.h>
 #include <xsi_vector4f.h>
 #include <xsi_quaternionf.h>
 #include <xsi_color4f.h>
+#include <xsi_matrix3f.h>
+#include <xsi_matrix4f.h>
 #include <xsi_pluginregistrar.h>
+#include <xsi_command.h>
+#include <xsi_argument.h>
+#include <xsi_uitoolkit.h>
+#include <xsi_progressbar.h>
 #include <xsi_status.h>
 
 using namespace XSI; 
 using namespace XSI::MATH;
 
-#include <map>
 #include <string>
 #include <vector>
-#include <sstream>
 #include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <memory>
+#include <type_traits>
 
-#include <Partio.h>
+#include "ParticleExporter.h"
 
 
-struct DataMap
-{
-	Partio::ParticleAttributeType AttributeType;
-	int Count;
-};
-
-static DataMap int1Map    = { Partio::INT   , 1 };
-static DataMap float1Map  = { Partio::FLOAT , 1 };
-static DataMap float2Map  = { Partio::FLOAT , 2 };
-static DataMap float3Map  = { Partio::FLOAT , 3 };
-static DataMap float4Map  = { Partio::FLOAT , 4 };
-static DataMap vector3Map = { Partio::VECTOR, 3 };
-
-static std::map<std::string, std::string> defaultChannelNameMap;
-static std::map<siICENodeDataType, DataMap> defaultDataMapping;
-
-void InitDefaults()
-{
-	if (defaultChannelNameMap.size() == 0)
-	{
-		// these are basically .PRT channels names by default, everything else should map 1:1 (i.e. ID -> ID automatically, Density -> Density etc)
-		defaultChannelNameMap["PointPosition"] = "Position";
-		defaultChannelNameMap["PointVelocity"] = "Velocity";
-		defaultChannelNameMap["PointNormal"]   = "Normal";
-		defaultChannelNameMap["PointUV"]       = "TextureCoord";
-	}
-	
-	if (defaultDataMapping.size() == 0)
-	{
-		defaultDataMapping[siICENodeDataBool]       = int1Map;
-		defaultDataMapping[siICENodeDataLong]       = int1Map;
-		defaultDataMapping[siICENodeDataFloat]      = float1Map;
-		defaultDataMapping[siICENodeDataVector2]    = float2Map;
-		defaultDataMapping[siICENodeDataVector3]    = vector3Map;
-		defaultDataMapping[siICENodeDataVector4]    = float4Map;
-		defaultDataMapping[siICENodeDataQuaternion] = float4Map;
-		defaultDataMapping[siICENodeDataColor4]     = float4Map;
-		defaultDataMapping[siICENodeDataShape]      = int1Map;
-		defaultDataMapping[siICENodeDataRotation]   = float4Map;
-	}
-}
-
-// split grabbed from stackoverflow...
-// http://stackoverflow.com/questions/236129/how-to-split-a-string-in-c
-std::vector<std::string> &split(const std::string &s, char delim, std::vector<std::string> &elems) {
-    std::stringstream ss(s);
-    std::string item;
-    while(std::getline(ss, item, delim)) {
-        elems.push_back(item);
-    }
-    return elems;
-}
-
-// split grabbed from stackoverflow...
-// http://stackoverflow.com/questions/236129/how-to-split-a-string-in-c
-std::vector<std::string> split(const std::string &s, char delim) {
-    std::vector<std::string> elems;
-    return split(s, delim, elems);
-}
-
 // default implementation when the types match exactly or auto-convert without warning (i.e. bool -> int)
 template <typename ArrayValueType,typename PrimativeType>
 inline void StoreDataRaw(ArrayValueType& dataArrayValue, PrimativeType* partioDataPtr, int count = 1)
@@ -176,164 +125,525 @@ inline void StoreDataRaw<const CShape, int>(const CShape& dataArrayValue, int* p
 }
 
 template <>
-inline void StoreDataRaw<CRotationf,float>(CRotationf& dataArrayValue, float* partioDataPtr, int count)
+inline void StoreDataRaw<CMatrix3f, float>(CMatrix3f& dataArrayValue, float* partioDataPtr, int count)
 {
-    // For now this is just a default behavior that matches the current ice storage format
-    // TODO: in the future this should be customizable per output type
+	for (short row=0; row < 3; row++)
+	{
+		for (short col=0; col < 3; col++)
+			partioDataPtr[row*3 + col] = dataArrayValue.GetValue(row, col);
+	}
+}
 
-    switch (dataArrayValue.GetRepresentation())
-    {
-    case CRotationf::siQuaternionRot:
-        dataArrayValue.GetQuaternion().Get(partioDataPtr[3],partioDataPtr[0],partioDataPtr[1],partioDataPtr[2]);
-        break;
-    case CRotationf::siAxisAngleRot:
-        dataArrayValue.GetAxisAngle(partioDataPtr[3]).Get(partioDataPtr[0],partioDataPtr[1],partioDataPtr[2]);
-        break;
-    case CRotationf::siEulerRot:
-        dataArrayValue.GetXYZAngles().Get(partioDataPtr[0],partioDataPtr[1],partioDataPtr[2]);
-        break;
-    }
+template <>
+inline void StoreDataRaw<CMatrix4f, float>(CMatrix4f& dataArrayValue, float* partioDataPtr, int count)
+{
+	for (short row=0; row < 4; row++)
+	{
+		for (short col=0; col < 4; col++)
+			partioDataPtr[row*4 + col] = dataArrayValue.GetValue(row, col);
+	}
+}
+
+// Rotations are stored in the representation they use, the core converts them to the convention of the export
+// (rotation=..., see Rotation.h). One of these is picked per array so the loop doesn't branch on every element.
+struct StoreRotationQuaternion
+{
+	void operator()(CRotationf& rotation, float* partioDataPtr) const
+	{
+		rotation.GetQuaternion().Get(partioDataPtr[3],partioDataPtr[0],partioDataPtr[1],partioDataPtr[2]);
+	}
+};
+
+struct StoreRotationAxisAngle
+{
+	void operator()(CRotationf& rotation, float* partioDataPtr) const
+	{
+		rotation.GetAxisAngle(partioDataPtr[3]).Get(partioDataPtr[0],partioDataPtr[1],partioDataPtr[2]);
+	}
+};
+
+struct StoreRotationEuler
+{
+	void operator()(CRotationf& rotation, float* partioDataPtr) const
+	{
+		rotation.GetXYZAngles().Get(partioDataPtr[0],partioDataPtr[1],partioDataPtr[2]);
+	}
+};
+
+// Adapter between the SDK and the export core (see ParticleSource.h)
+//
+// The core reads every attribute as a plain int or float array. The ICE arrays are handed over in place whenever
+// their memory already looks like that, everything else is converted with StoreDataRaw when the data is fetched.
+
+// Handing the ICE math types over in place treats them as plain float arrays. Rather than rely on the SDK's private
+// member layout we check it once at runtime against the accessors and fall back to StoreDataRaw if it ever differs.
+template <typename T>
+inline bool MatchesFloatLayout(const T& value, float a, float b, float c = 0.0f, float d = 0.0f)
+{
+	const float expected[4] = { a, b, c, d };
+	return memcmp(&value, expected, sizeof(T)) == 0;
+}
+
+static bool IsPackedVector2f()
+{
+	static const bool packed = sizeof(CVector2f) == 2*sizeof(float) && MatchesFloatLayout(CVector2f(1.0f,2.0f), 1.0f,2.0f);
+	return packed;
 }
 
+static bool IsPackedVector3f()
+{
+	static const bool packed = sizeof(CVector3f) == 3*sizeof(float) && MatchesFloatLayout(CVector3f(1.0f,2.0f,3.0f), 1.0f,2.0f,3.0f);
+	return packed;
+}
+
+static bool IsPackedVector4f()
+{
+	static const bool packed = sizeof(CVector4f) == 4*sizeof(float) && MatchesFloatLayout(CVector4f(1.0f,2.0f,3.0f,4.0f), 1.0f,2.0f,3.0f,4.0f);
+	return packed;
+}
+
+static bool IsPackedColor4f()
+{
+	static const bool packed = sizeof(CColor4f) == 4*sizeof(float) && MatchesFloatLayout(CColor4f(1.0f,2.0f,3.0f,4.0f), 1.0f,2.0f,3.0f,4.0f);
+	return packed;
+}
+
+enum QuaternionLayout
+{
+	QuaternionLayoutUnknown,
+	QuaternionLayoutXYZW,
+	QuaternionLayoutWXYZ
+};
+
+static QuaternionLayout DetectQuaternionLayout()
+{
+	CQuaternionf q(1.0f,2.0f,3.0f,4.0f);
+	if (sizeof(CQuaternionf) != 4*sizeof(float))
+		return QuaternionLayoutUnknown;
+	if (MatchesFloatLayout(q, q.GetX(), q.GetY(), q.GetZ(), q.GetW()))
+		return QuaternionLayoutXYZW;
+	if (MatchesFloatLayout(q, q.GetW(), q.GetX(), q.GetY(), q.GetZ()))
+		return QuaternionLayoutWXYZ;
+	return QuaternionLayoutUnknown;
+}
+
+static QuaternionLayout GetQuaternionLayout()
+{
+	static const QuaternionLayout layout = DetectQuaternionLayout();
+	return layout;
+}
+
+// fetches the whole array, or only the particles [begin, begin + count) when count isn't -1
+template <typename ArrayType>
+void FetchDataArray(const ICEAttribute& iceAttr, int begin, int count, ArrayType& dataArray)
+{
+	if (count == -1)
+		iceAttr.GetDataArray(dataArray);
+	else
+		iceAttr.GetDataArrayChunk(begin, count, dataArray);
+}
+
+// hands the ICE array over without copying, the array object itself is kept alive through ParticleDataArray::Owner
+template <typename ArrayType>
+void FetchInPlace(const ICEAttribute& iceAttr, int begin, int count, int components, bool isInt, ParticleDataArray& data)
+{
+	std::shared_ptr<ArrayType> dataArray(new ArrayType);
+	FetchDataArray(iceAttr, begin, count, *dataArray);
+
+	// an empty array or chunk has no element 0 to point at
+	const bool empty = !dataArray->IsConstant() && dataArray->GetCount() == 0;
+	data.Data = empty ? NULL : &(*dataArray)[0];
+	data.Stride = dataArray->IsConstant() ? 0 : sizeof((*dataArray)[0]);
+	data.Components = components;
+	data.Int = isInt;
+	data.Owner = dataArray;
+}
+
+// converts the whole array into a new buffer. The elements are read through the SDK's array accessor, so this runs on
+// the calling (main) thread, the worker pool only ever sees the plain buffer this produces.
 template <typename ArrayType,typename PrimativeType>
-CStatus StoreData(ICEAttribute& iceAttr, Partio::ParticlesDataMutable* pPD, Partio::ParticleAttribute& partioAttr)
+void FetchConverted(const ICEAttribute& iceAttr, int begin, int count, int components, ParticleDataArray& data)
 {
-    // copy data from iceAttr to partioAttr
+	ArrayType dataArray;
+	FetchDataArray(iceAttr, begin, count, dataArray);
 
-    ArrayType dataArray;
-    iceAttr.GetDataArray(dataArray);
+	const int size = dataArray.IsConstant() ? 1 : (int)dataArray.GetCount();
+	std::shared_ptr< std::vector<PrimativeType> > buffer(new std::vector<PrimativeType>(size_t(size) * components));
+	PrimativeType* dst = buffer->empty() ? NULL : &(*buffer)[0];
 
-	int count = partioAttr.count;
-    for (int i=0; i < pPD->numParticles(); i++)
-    {
-        PrimativeType* value = pPD->dataWrite<PrimativeType>(partioAttr, i);
-        StoreDataRaw(dataArray[i], value, count);
-    }
-    
-    return CStatus::OK;
+	for (int i=0; i < size; i++)
+	{
+		StoreDataRaw(dataArray[i], dst + size_t(i) * components, components);
+	}
+
+	data.Data = dst;
+	data.Stride = dataArray.IsConstant() ? 0 : components * sizeof(PrimativeType);
+	data.Components = components;
+	data.Int = std::is_integral<PrimativeType>::value;
+	data.Owner = buffer;
 }
 
-CStatus ExportPrimitive(Primitive& prim, int frame, std::map<std::string,std::string>& channelNameMapping, std::map<siICENodeDataType,DataMap>& dataMapping, std::vector<std::string> channelsToExport, CString& outputFName)
+// reads the raw representation out of the SDK's rotations on the main thread, converting it to the convention of the
+// export is left to the core's Rotation.cpp kernels, which run on the worker pool
+template <typename Store>
+void StoreRotations(CICEAttributeDataArrayRotationf& dataArray, int size, float* dst, Store store)
 {
-    if (prim.GetType() != "pointcloud")
-    {
-        Application().LogMessage(L"Unsupported Primitive type: " + prim.GetType(),siErrorMsg);
-        return CStatus::Abort;
-    }
+	for (int i=0; i < size; i++)
+	{
+		store(dataArray[i], dst + size_t(i) * 4);
+	}
+}
 
-    CStatus res;
-    
-    Geometry geom = prim.GetGeometry((double)frame);
-        
-    CPointRefArray points( geom.GetPoints() );
-    LONG particleCount = points.GetCount();
+// The representation is checked once per array: if every element uses the same one the array is stored in it,
+// otherwise everything is stored as quaternions which every representation converts to.
+void FetchRotations(const ICEAttribute& iceAttr, int begin, int count, ParticleDataArray& data)
+{
+	CICEAttributeDataArrayRotationf dataArray;
+	FetchDataArray(iceAttr, begin, count, dataArray);
 
-    Partio::ParticlesDataMutable* pPD = Partio::create();
+	const int size = dataArray.IsConstant() ? 1 : (int)dataArray.GetCount();
+	std::shared_ptr< std::vector<float> > buffer(new std::vector<float>(size_t(size) * 4));
+	float* dst = buffer->empty() ? NULL : &(*buffer)[0];
 
-    pPD->addParticles(particleCount);
+	int representation = size > 0 ? dataArray[0].GetRepresentation() : CRotationf::siQuaternionRot;
+	for (int i=1; i < size && representation != CRotationf::siQuaternionRot; i++)
+	{
+		if (dataArray[i].GetRepresentation() != representation)
+			representation = CRotationf::siQuaternionRot;
+	}
 
-    std::vector<std::string> skippedChanelWarnings;
+	switch (representation)
+	{
+	case CRotationf::siAxisAngleRot:
+		StoreRotations(dataArray, size, dst, StoreRotationAxisAngle());
+		data.Rotation = ParticleRotationAxisAngle;
+		break;
+	case CRotationf::siEulerRot:
+		StoreRotations(dataArray, size, dst, StoreRotationEuler());
+		data.Rotation = ParticleRotationEulerXYZ;
+		break;
+	default:
+		StoreRotations(dataArray, size, dst, StoreRotationQuaternion());
+		data.Rotation = ParticleRotationQuaternion;
+		break;
+	}
 
-    CRefArray attributesRefArray = geom.GetICEAttributes();
-    for (int i=0; i < attributesRefArray.GetCount(); i++)
-    {
-        ICEAttribute attr(attributesRefArray[i]);
-        if (attr.IsDefined() == false || attr.GetContextType() != siICENodeContextComponent0D)
-            continue;
+	data.Data = dst;
+	data.Stride = dataArray.IsConstant() ? 0 : 4 * sizeof(float);
+	data.Components = 4;
+	data.Int = false;
+	data.Owner = buffer;
+}
 
-        siICENodeDataType dataType = attr.GetDataType();
-        std::map<siICENodeDataType,DataMap>::const_iterator pos = dataMapping.find(dataType);
-        if ( dataMapping.find(dataType) == dataMapping.end())
-        {
-            // unmapped data type, have to skip for now
-            std::ostringstream ss;
-            ss << "Skipping ICEAttribute: \"" << attr.GetName().GetAsciiString() << "\" due to unsupported data type: " << attr.GetDataType();
-            skippedChanelWarnings.push_back(ss.str());
-            continue;
-        }
-        DataMap dataMap = pos->second;
+template <typename SubArrayType>
+inline const void* GetElementData(SubArrayType& subArray)
+{
+	return &subArray[0];
+}
 
-        
-        // if (channelsToExport.size() == 0) then export all channels, else
-        if (channelsToExport.size() != 0 && channelsToExport.end() == std::find(channelsToExport.begin(), channelsToExport.end(), attr.GetName().GetAsciiString()))
-        {
-            std::ostringstream ss;
-            ss << "Skipping ICEAttribute: \"" << attr.GetName().GetAsciiString() << "\" because it was not selected for export";
-            skippedChanelWarnings.push_back(ss.str());
-            continue;
-        }
-            
-        std::string destName (attr.GetName().GetAsciiString()); // need to store copy in std::string, otherwise the result sometimes gets lost
-        std::map<std::string,std::string>::const_iterator namePos = channelNameMapping.find(attr.GetName().GetAsciiString());
-        if (namePos != channelNameMapping.end())
-        {
-            destName = namePos->second;
-        }
-        
-        Partio::ParticleAttribute partioAttr = pPD->addAttribute(destName.c_str(),dataMap.AttributeType, dataMap.Count);
+// bool arrays don't hand out references to their elements, they are never packed
+inline const void* GetElementData(CICEAttributeDataArrayBool& subArray)
+{
+	return NULL;
+}
 
-		// don't try to access the data if the particle count is 0, it will just generate error 2392
-		if (particleCount > 0)
+// Per point arrays: the sub array of every point is looked up once and appended to one packed buffer, in a single copy
+// when the ICE elements are already laid out as plain values (packed)
+template <typename Array2DType, typename SubArrayType, typename PrimativeType>
+void FetchArray(const ICEAttribute& iceAttr, int begin, int count, int components, bool packed, ParticleDataArray& data)
+{
+	Array2DType dataArray;
+	if (count == -1)
+		iceAttr.GetDataArray2D(dataArray);
+	else
+		iceAttr.GetDataArray2DChunk(begin, count, dataArray);
+
+	const int size = dataArray.IsConstant() ? 1 : (int)dataArray.GetCount();
+	std::shared_ptr< std::vector<unsigned int> > first(new std::vector<unsigned int>(size));
+	std::shared_ptr< std::vector<unsigned int> > counts(new std::vector<unsigned int>(size));
+	std::shared_ptr< std::vector<PrimativeType> > values(new std::vector<PrimativeType>());
+
+	SubArrayType subArray;
+	for (int i=0; i < size; i++)
+	{
+		dataArray.GetSubArray(i, subArray);
+		const unsigned int elements = subArray.GetCount();
+		const size_t offset = values->size();
+		(*first)[i] = (unsigned int)(offset / components);
+		(*counts)[i] = elements;
+		if (elements == 0)
+			continue;
+
+		values->resize(offset + size_t(elements) * components);
+		if (packed)
 		{
+			memcpy(&(*values)[offset], GetElementData(subArray), size_t(elements) * components * sizeof(PrimativeType));
+			continue;
+		}
+		for (unsigned int e=0; e < elements; e++)
+		{
+			auto value = subArray[e];
+			StoreDataRaw(value, &(*values)[offset + size_t(e) * components], components);
+		}
+	}
 
-			switch (attr.GetDataType())
-			{
-			case siICENodeDataBool:
-				StoreData<CICEAttributeDataArrayBool, int>(attr, pPD, partioAttr);
-				break;
-			case siICENodeDataLong:
-				StoreData<CICEAttributeDataArrayLong, int>(attr, pPD, partioAttr);
-				break;
-			case siICENodeDataFloat:
-				StoreData<CICEAttributeDataArrayFloat, float>(attr, pPD, partioAttr);
-				break;
-			case siICENodeDataVector2:
-				StoreData<CICEAttributeDataArrayVector2f, float>(attr, pPD, partioAttr);
-				break;
-			case siICENodeDataVector3:
-				StoreData<CICEAttributeDataArrayVector3f, float>(attr, pPD, partioAttr);
-				break;
-			case siICENodeDataVector4:
-				StoreData<CICEAttributeDataArrayVector4f, float>(attr, pPD, partioAttr);
-				break;
-			case siICENodeDataQuaternion:
-				StoreData<CICEAttributeDataArrayQuaternionf, float>(attr, pPD, partioAttr);
-				break;
-			case siICENodeDataColor4:
-				StoreData<CICEAttributeDataArrayColor4f, float>(attr, pPD, partioAttr);
-				break;
-			case siICENodeDataShape:
-				StoreData<CICEAttributeDataArrayShape, int>(attr, pPD, partioAttr);
-				break;
-			case siICENodeDataRotation:
-				StoreData<CICEAttributeDataArrayRotationf, float>(attr, pPD, partioAttr);
-				break;
-			default:
-				std::ostringstream ss;
-				ss << "Skipping ICEAttribute: \"" << attr.GetName().GetAsciiString() << "\" due to unsupported data type";
-				skippedChanelWarnings.push_back(ss.str());
-				break;
-			}
+	std::shared_ptr< std::vector< std::shared_ptr<void> > > owners(new std::vector< std::shared_ptr<void> >());
+	owners->push_back(values);
+	owners->push_back(first);
+	owners->push_back(counts);
+
+	data.Data = values->empty() ? NULL : &(*values)[0];
+	data.Stride = dataArray.IsConstant() ? 0 : components * sizeof(PrimativeType);
+	data.Components = components;
+	data.Int = std::is_integral<PrimativeType>::value;
+	data.ArrayFirst = first->empty() ? NULL : &(*first)[0];
+	data.ArrayCounts = counts->empty() ? NULL : &(*counts)[0];
+	data.Owner = owners;
+}
+
+// bool arrays don't hand out references to their elements
+template <>
+void FetchConverted<CICEAttributeDataArrayBool, int>(const ICEAttribute& iceAttr, int begin, int count, int components, ParticleDataArray& data)
+{
+	CICEAttributeDataArrayBool dataArray;
+	FetchDataArray(iceAttr, begin, count, dataArray);
+
+	const int size = dataArray.IsConstant() ? 1 : (int)dataArray.GetCount();
+	std::shared_ptr< std::vector<int> > buffer(new std::vector<int>(size));
+	for (int i=0; i < size; i++)
+	{
+		(*buffer)[i] = dataArray[i] ? 1 : 0;
+	}
+
+	data.Data = buffer->empty() ? NULL : &(*buffer)[0];
+	data.Stride = dataArray.IsConstant() ? 0 : sizeof(int);
+	data.Components = 1;
+	data.Int = true;
+	data.Owner = buffer;
+}
+
+ParticleDataType GetParticleDataType(siICENodeDataType dataType)
+{
+	switch (dataType)
+	{
+	case siICENodeDataBool:       return ParticleDataBool;
+	case siICENodeDataLong:       return ParticleDataLong;
+	case siICENodeDataFloat:      return ParticleDataFloat;
+	case siICENodeDataVector2:    return ParticleDataVector2;
+	case siICENodeDataVector3:    return ParticleDataVector3;
+	case siICENodeDataVector4:    return ParticleDataVector4;
+	case siICENodeDataQuaternion: return ParticleDataQuaternion;
+	case siICENodeDataColor4:     return ParticleDataColor4;
+	case siICENodeDataShape:      return ParticleDataShape;
+	case siICENodeDataRotation:   return ParticleDataRotation;
+	case siICENodeDataMatrix33:   return ParticleDataMatrix3;
+	case siICENodeDataMatrix44:   return ParticleDataMatrix4;
+	default:                      return ParticleDataUnsupported;
+	}
+}
+
+class XSIAttributeSource : public ParticleAttributeSource
+{
+public:
+	XSIAttributeSource(const CRef& ref) : m_attr(ref) {}
+
+	virtual std::string GetName() const
+	{
+		return m_attr.GetName().GetAsciiString();
+	}
+
+	virtual ParticleDataType GetDataType() const
+	{
+		ParticleDataType dataType = GetParticleDataType(m_attr.GetDataType());
+		if (IsArray() && (dataType == ParticleDataShape || dataType == ParticleDataRotation))
+			return ParticleDataUnsupported; // not handled by FetchArrayData
+		return dataType;
+	}
+
+	virtual bool IsPerPoint() const
+	{
+		return m_attr.IsDefined() && m_attr.GetContextType() == siICENodeContextComponent0D;
+	}
+
+	virtual bool IsArray() const
+	{
+		return m_attr.GetStructureType() == siICENodeStructureArray;
+	}
+
+	virtual void GetData(ParticleDataArray& data)
+	{
+		Fetch(-1, -1, data);
+	}
+
+	virtual void GetDataChunk(int begin, int count, ParticleDataArray& data)
+	{
+		Fetch(begin, count, data);
+	}
+
+private:
+	void Fetch(int begin, int count, ParticleDataArray& data)
+	{
+		if (IsArray())
+			return FetchArrayData(begin, count, data);
+
+		switch (m_attr.GetDataType())
+		{
+		case siICENodeDataBool:
+			return FetchConverted<CICEAttributeDataArrayBool, int>(m_attr, begin, count, 1, data);
+		case siICENodeDataLong:
+			if (sizeof(LONG) == sizeof(int))
+				return FetchInPlace<CICEAttributeDataArrayLong>(m_attr, begin, count, 1, true, data);
+			return FetchConverted<CICEAttributeDataArrayLong, int>(m_attr, begin, count, 1, data);
+		case siICENodeDataFloat:
+			return FetchInPlace<CICEAttributeDataArrayFloat>(m_attr, begin, count, 1, false, data);
+		case siICENodeDataVector2:
+			if (IsPackedVector2f())
+				return FetchInPlace<CICEAttributeDataArrayVector2f>(m_attr, begin, count, 2, false, data);
+			return FetchConverted<CICEAttributeDataArrayVector2f, float>(m_attr, begin, count, 2, data);
+		case siICENodeDataVector3:
+			if (IsPackedVector3f())
+				return FetchInPlace<CICEAttributeDataArrayVector3f>(m_attr, begin, count, 3, false, data);
+			return FetchConverted<CICEAttributeDataArrayVector3f, float>(m_attr, begin, count, 3, data);
+		case siICENodeDataVector4:
+			if (IsPackedVector4f())
+				return FetchInPlace<CICEAttributeDataArrayVector4f>(m_attr, begin, count, 4, false, data);
+			return FetchConverted<CICEAttributeDataArrayVector4f, float>(m_attr, begin, count, 4, data);
+		case siICENodeDataColor4:
+			if (IsPackedColor4f())
+				return FetchInPlace<CICEAttributeDataArrayColor4f>(m_attr, begin, count, 4, false, data);
+			return FetchConverted<CICEAttributeDataArrayColor4f, float>(m_attr, begin, count, 4, data);
+		case siICENodeDataQuaternion:
+			if (GetQuaternionLayout() == QuaternionLayoutUnknown)
+				FetchConverted<CICEAttributeDataArrayQuaternionf, float>(m_attr, begin, count, 4, data);
+			else
+				FetchInPlace<CICEAttributeDataArrayQuaternionf>(m_attr, begin, count, 4, false, data);
+			data.WXYZ = GetQuaternionLayout() == QuaternionLayoutWXYZ;
+			data.Rotation = ParticleRotationQuaternion;
+			return;
+		case siICENodeDataShape:
+			return FetchConverted<CICEAttributeDataArrayShape, int>(m_attr, begin, count, 1, data);
+		case siICENodeDataRotation:
+			return FetchRotations(m_attr, begin, count, data);
+		case siICENodeDataMatrix33:
+			return FetchConverted<CICEAttributeDataArrayMatrix3f, float>(m_attr, begin, count, 9, data);
+		case siICENodeDataMatrix44:
+			return FetchConverted<CICEAttributeDataArrayMatrix4f, float>(m_attr, begin, count, 16, data);
+		default:
+			return;
 		}
-    }
+	}
 
-    for (std::vector<std::string>::const_iterator iter = skippedChanelWarnings.begin(); iter != skippedChanelWarnings.end(); ++iter)
-    {
-        Application().LogMessage(CString(iter->c_str()),siWarningMsg);    
-    }
+	void FetchArrayData(int begin, int count, ParticleDataArray& data)
+	{
+		switch (m_attr.GetDataType())
+		{
+		case siICENodeDataBool:
+			return FetchArray<CICEAttributeDataArray2DBool, CICEAttributeDataArrayBool, int>(m_attr, begin, count, 1, false, data);
+		case siICENodeDataLong:
+			return FetchArray<CICEAttributeDataArray2DLong, CICEAttributeDataArrayLong, int>(m_attr, begin, count, 1, sizeof(LONG) == sizeof(int), data);
+		case siICENodeDataFloat:
+			return FetchArray<CICEAttributeDataArray2DFloat, CICEAttributeDataArrayFloat, float>(m_attr, begin, count, 1, true, data);
+		case siICENodeDataVector2:
+			return FetchArray<CICEAttributeDataArray2DVector2f, CICEAttributeDataArrayVector2f, float>(m_attr, begin, count, 2, IsPackedVector2f(), data);
+		case siICENodeDataVector3:
+			return FetchArray<CICEAttributeDataArray2DVector3f, CICEAttributeDataArrayVector3f, float>(m_attr, begin, count, 3, IsPackedVector3f(), data);
+		case siICENodeDataVector4:
+			return FetchArray<CICEAttributeDataArray2DVector4f, CICEAttributeDataArrayVector4f, float>(m_attr, begin, count, 4, IsPackedVector4f(), data);
+		case siICENodeDataQuaternion:
+			return FetchArray<CICEAttributeDataArray2DQuaternionf, CICEAttributeDataArrayQuaternionf, float>(m_attr, begin, count, 4, GetQuaternionLayout() == QuaternionLayoutXYZW, data);
+		case siICENodeDataColor4:
+			return FetchArray<CICEAttributeDataArray2DColor4f, CICEAttributeDataArrayColor4f, float>(m_attr, begin, count, 4, IsPackedColor4f(), data);
+		case siICENodeDataMatrix33:
+			return FetchArray<CICEAttributeDataArray2DMatrix3f, CICEAttributeDataArrayMatrix3f, float>(m_attr, begin, count, 9, false, data);
+		case siICENodeDataMatrix44:
+			return FetchArray<CICEAttributeDataArray2DMatrix4f, CICEAttributeDataArrayMatrix4f, float>(m_attr, begin, count, 16, false, data);
+		default:
+			return;
+		}
+	}
+
+	ICEAttribute m_attr;
+};
+
+// the point cloud of a primitive at one frame, the geometry is only fetched once it is needed so the export core can
+// time it
+class XSIParticleSource : public ParticleSource
+{
+public:
+	XSIParticleSource(Primitive& prim, int frame)
+		: m_prim(prim), m_frame(frame), m_loaded(false), m_particleCount(0)
+	{
+		m_target = prim.GetFullName().GetAsciiString();
+	}
+
+	virtual std::string GetTarget() const { return m_target; }
+	virtual int GetParticleCount() { Load(); return m_particleCount; }
+	virtual int GetAttributeCount() { Load(); return (int)m_attributes.size(); }
+	virtual ParticleAttributeSource& GetAttribute(int index) { Load(); return *m_attributes[index]; }
+
+private:
+	void Load()
+	{
+		if (m_loaded)
+			return;
+		m_loaded = true;
 
-    Application().LogMessage(L"Writing " + CString(pPD->numParticles()) + " particles with " + CString(pPD->numAttributes()) + " channels to file at path: " + outputFName,siInfoMsg);
-    Partio::write(outputFName.GetAsciiString(), *pPD, false);
+		Geometry geom = m_prim.GetGeometry((double)m_frame);
 
-    pPD->release(); // Partio memory release 
+		CPointRefArray points( geom.GetPoints() );
+		m_particleCount = points.GetCount();
 
-    return CStatus::OK;
+		CRefArray attributesRefArray = geom.GetICEAttributes();
+		for (int i=0; i < attributesRefArray.GetCount(); i++)
+		{
+			m_attributes.push_back(std::unique_ptr<XSIAttributeSource>(new XSIAttributeSource(attributesRefArray[i])));
+		}
+	}
+
+	Primitive m_prim;
+	int m_frame;
+	std::string m_target;
+	bool m_loaded;
+	int m_particleCount;
+	std::vector< std::unique_ptr<XSIAttributeSource> > m_attributes;
+};
+
+class XSIExportLog : public ExportLog
+{
+public:
+	virtual void Log(const std::string& message, ExportLogSeverity severity)
+	{
+		siSeverityType xsiSeverity = siInfoMsg;
+		switch (severity)
+		{
+		case ExportLogError:   xsiSeverity = siErrorMsg;   break;
+		case ExportLogWarning: xsiSeverity = siWarningMsg; break;
+		case ExportLogVerbose: xsiSeverity = siVerboseMsg; break;
+		default: break;
+		}
+		Application().LogMessage(CString(message.c_str()), xsiSeverity);
+	}
+};
+
+static XSIExportLog xsiLog;
+
+// <name>_<object>.<frame><ext>, the files of model exports and PartioExportFrames
+CString GetObjectFileName(const CString& fnameNoExt, X3DObject& object, int frame, const CString& fnameExt)
+{
+	char buff[20];
+	sprintf_s((char*)&buff, size_t(20), ".%04d", frame);
+	CString frameStr(buff);
+	return fnameNoExt + CString("_") + object.GetName() + frameStr + fnameExt;
 }
 
-CStatus DoParticleExport(CRef& in_ctxt, std::map<std::string,std::string>& channelNameMapping, std::map<siICENodeDataType,DataMap>& dataMapping)
+CStatus DoParticleExport(CRef& in_ctxt, const ExportFormat& format)
 {
     Context ctxt(in_ctxt);
 
+    // frames are written in the background after their callback has returned, so failures show up here
+    if (LogWriteErrors(xsiLog))
+        return CStatus::Fail;
+
     CString fileName(ctxt.GetAttribute(L"FileName"));
     CString fileType(ctxt.GetAttribute(L"FileType"));
     int frame = ctxt.GetAttribute(L"Frame");
@@ -341,15 +651,15 @@ CStatus DoParticleExport(CRef& in_ctxt, std::map<std::string,std::string>& chann
 	Application().LogMessage(L"Frame: "    + CString(ctxt.GetAttribute(L"Frame"))   ,siInfoMsg);
 	Application().LogMessage(L"UserData: " + CString(ctxt.GetAttribute(L"UserData")),siInfoMsg);
 
-    // if we are called from the cache manager, UserData will hold a comma separated list of Channels to export
+    // if we are called from the cache manager, UserData will hold a comma separated list of Channels to export,
+    // it can also carry key=value export options (see ExportOptions.h)
     CValue userDataValue = ctxt.GetAttribute(L"UserData");
-    bool exportSpecificChannels = false;
-    std::vector<std::string> channelsToExport;
+    std::string userData;
     if (userDataValue.m_t == CValue::siString)
     {
-        split(std::string(CString(userDataValue).GetAsciiString()), ',',channelsToExport);
-        exportSpecificChannels = true;   
+        userData = CString(userDataValue).GetAsciiString();
     }
+    const ExportOptions& options = GetExportOptions(userData, xsiLog);
     
     CRef targetRef(ctxt.GetAttribute(L"Target"));
 	
@@ -364,25 +674,55 @@ CStatus DoParticleExport(CRef& in_ctxt, std::map<std::string,std::string>& chann
     if (targetRef.GetClassID() == siPrimitiveID) // calls from cache manager look like this
     {
         Primitive prim(targetRef);
-		return ExportPrimitive(prim, frame, channelNameMapping, dataMapping, channelsToExport, fileName);
+        if (prim.GetType() != "pointcloud")
+        {
+            Application().LogMessage(L"Unsupported Primitive type: " + prim.GetType(),siErrorMsg);
+            return CStatus::Abort;
+        }
+
+        XSIParticleSource source(prim, frame);
+		return ExportParticles(source, format, options, fileName.GetAsciiString(), xsiLog) ? CStatus::OK : CStatus::Fail;
     }
     else if (targetRef.GetClassID() == siModelID) // calls form model export look like  this
     {
         Model targetModel(targetRef);
         CRefArray& children = targetModel.GetChildren();
 
+        // the geometry of every child is fetched here on the main thread, after that all children are converted
+        // together on the worker pool and written in parallel. A failing child doesn't stop its siblings.
+        ExportBatch batch(xsiLog);
+        CString failedObjects;
+        int failedCount = 0;
+
         for (int childIndex=0; childIndex < children.GetCount(); childIndex++)
         {
             CRef child(children[childIndex]);
             X3DObject exportTargetObject( child );
             Primitive prim = exportTargetObject.GetActivePrimitive();
-			char buff[20];
-			sprintf_s((char*)&buff, size_t(20), ".%04d", frame);
-			CString frameStr(buff);
-            CString outputFName = fnameNoExt + CString("_") + exportTargetObject.GetName() + frameStr + fnameExt;
-            CStatus res = ExportPrimitive(prim, frame, channelNameMapping, dataMapping, channelsToExport, outputFName);
-            if (res != CStatus::OK)
-                return res;
+            CString outputFName = GetObjectFileName(fnameNoExt, exportTargetObject, frame, fnameExt);
+
+            if (prim.GetType() != "pointcloud")
+            {
+                Application().LogMessage(L"Unsupported Primitive type: " + prim.GetType(),siErrorMsg);
+                failedObjects += (failedCount == 0 ? CString() : CString(", ")) + exportTargetObject.GetName();
+                failedCount++;
+                continue;
+            }
+
+            XSIParticleSource source(prim, frame);
+            if (!batch.Add(source, format, options, outputFName.GetAsciiString()))
+            {
+                failedObjects += (failedCount == 0 ? CString() : CString(", ")) + exportTargetObject.GetName();
+                failedCount++;
+            }
+        }
+
+        batch.Finish();
+
+        if (failedCount > 0)
+        {
+            Application().LogMessage(L"Failed to export " + CString(failedCount) + " of " + CString(children.GetCount()) + " objects: " + failedObjects,siErrorMsg);
+            return CStatus::Fail;
         }
         return CStatus::OK; 
     }
@@ -407,8 +747,7 @@ SICALLBACK XSILoadPlugin(PluginRegistrar& in_reg)
 	in_reg.RegisterConverterEvent(L"CustomFileExportPDA", siOnCustomFileExport, "PDA");
 	in_reg.RegisterConverterEvent(L"CustomFileExportPDB", siOnCustomFileExport, "PDB");
 	in_reg.RegisterConverterEvent(L"CustomFileExportPDC", siOnCustomFileExport, "PDC");
-
-	InitDefaults();
+	in_reg.RegisterCommand(L"PartioExportFrames", L"PartioExportFrames");
 
 	//RegistrationInsertionPoint - do not remove this line
 
@@ -419,6 +758,7 @@ SICALLBACK XSIUnloadPlugin(const PluginRegistrar& in_reg)
 {
 	CString strPluginName;
 	strPluginName = in_reg.GetName();
+	ShutdownExporter(xsiLog);
 	Application().LogMessage(strPluginName + L" has been unloaded.", siVerboseMsg);
 	return CStatus::OK;
 }
@@ -427,36 +767,12 @@ SICALLBACK XSIUnloadPlugin(const PluginRegistrar& in_reg)
 
 SICALLBACK CustomFileExportPRT_OnEvent(CRef& in_ctxt)
 {
-	InitDefaults(); // just in case these are not already initialized (i.e. if the dll was unloaded by softimage between calls)
-		
-	std::map<siICENodeDataType, DataMap> dataMapping = defaultDataMapping; // copy the defaults so we can add a special case for color
-	// this is a special case for Krakatoa which expects 3 float color no alpha
-    dataMapping[siICENodeDataColor4] = float3Map; 
-	
-    return DoParticleExport(in_ctxt, defaultChannelNameMap, dataMapping);
+	return DoParticleExport(in_ctxt, GetExportFormat(ExportFormatPRT));
 }
 
 SICALLBACK CustomFileExportBGEO_OnEvent(CRef& in_ctxt)
 {
-	InitDefaults(); // just in case these are not already initialized (i.e. if the dll was unloaded by softimage between calls)
-
-	std::map<std::string, std::string> channelNameMap;
-
-	channelNameMap["PointPosition"]   = "position"; // this has to be 'position' and not 'P' or the bgeo writer for partio will fail (LAME)...
-	channelNameMap["PointVelocity"]   = "v";
-	channelNameMap["PointNormal"]     = "N";
-	channelNameMap["PointUpVector"]   = "up";
-	channelNameMap["PointUV"]         = "uv";
-	channelNameMap["Color"]           = "Cd";
-	channelNameMap["Mass"]            = "mass";
-	channelNameMap["Size"]            = "pscale";
-	channelNameMap["Scale"]           = "scalef";
-	channelNameMap["DragCoefficient"] = "drag";
-	
-	std::map<siICENodeDataType, DataMap> dataMapping = defaultDataMapping; // copy the defaults so we can add a special case for color
-	dataMapping[siICENodeDataColor4] = float3Map;
-
-	return DoParticleExport(in_ctxt, channelNameMap, dataMapping);
+	return DoParticleExport(in_ctxt, GetExportFormat(ExportFormatBGEO));
 }
 
 SICALLBACK CustomFileExportGEO_OnEvent(CRef& in_ctxt)
@@ -467,58 +783,12 @@ SICALLBACK CustomFileExportGEO_OnEvent(CRef& in_ctxt)
 
 SICALLBACK CustomFileExportBIN_OnEvent(CRef& in_ctxt)
 {
-	InitDefaults(); // just in case these are not already initialized (i.e. if the dll was unloaded by softimage between calls)
-
-	std::map<std::string, std::string> channelNameMap;
-
-	// bin format partio writer expects very specific attribute names and only supports these channels
-	channelNameMap["PointPosition"] = "position"; 
-	channelNameMap["PointVelocity"] = "velocity";
-	channelNameMap["PointNormal"]   = "normal";
-	channelNameMap["Force"]         = "force";
-	channelNameMap["Vorticity"]     = "vorticity";
-	channelNameMap["Neighbors"]     = "neighbors";
-	channelNameMap["PointUV"]       = "uvw";
-	channelNameMap["Age"]           = "age";
-	channelNameMap["IsolationTime"] = "isolationTime";
-	channelNameMap["Viscosity"]     = "viscosity";
-	channelNameMap["Density"]       = "density";
-	channelNameMap["Pressure"]      = "pressure";
-	channelNameMap["Mass"]          = "mass";
-	channelNameMap["Temperature"  ] = "temperature";
-	channelNameMap["ID"]            = "id";
-
-	// the default data map should work just fine
-	
-	return DoParticleExport(in_ctxt, channelNameMap, defaultDataMapping);
+	return DoParticleExport(in_ctxt, GetExportFormat(ExportFormatBIN));
 }
 
 SICALLBACK CustomFileExportPDA_OnEvent(CRef& in_ctxt)
 {
-	InitDefaults(); // just in case these are not already initialized (i.e. if the dll was unloaded by softimage between calls)
-	
-	std::map<std::string, std::string> channelNameMap;
-
-	// guess based on this: http://download.autodesk.com/us/maya/2009help/index.html?url=Dynamics_Nodes_List_of_particle_attributes.htm,topicNumber=d0e413301
-	// not really tested could use some feedback/pull requests here
-	channelNameMap["PointPosition"] = "position"; // this has to be 'position' and not 'P' or the bgeo writer for partio will fail (LAME)...
-	channelNameMap["PointVelocity"] = "velocity";
-	channelNameMap["PointNormal"]   = "normalDir";
-	channelNameMap["PointUpVector"] = "upDir";
-	channelNameMap["Acceleration"]  = "acceleration";
-	channelNameMap["Force"]         = "force";
-	channelNameMap["PointUV"]       = "uv";
-	channelNameMap["Color"]         = "objectColor";
-	channelNameMap["Mass"]          = "mass";
-	channelNameMap["Radius"]        = "radius";
-	channelNameMap["Size"]          = "pointSize";
-	channelNameMap["Age"]           = "age";
-	channelNameMap["ID"]            = "id";
-
-	std::map<siICENodeDataType, DataMap> dataMapping = defaultDataMapping; // copy the defaults so we can add a special case for color
-	dataMapping[siICENodeDataColor4] = float3Map;
-	
-	return DoParticleExport(in_ctxt, channelNameMap, defaultDataMapping);
+	return DoParticleExport(in_ctxt, GetExportFormat(ExportFormatPDA));
 }
 
 SICALLBACK CustomFileExportPDB_OnEvent(CRef& in_ctxt)
@@ -531,5 +801,137 @@ SICALLBACK CustomFileExportPDC_OnEvent(CRef& in_ctxt)
 	return CustomFileExportPDA_OnEvent(in_ctxt); // should be the same as pda
 }
 
+// PartioExportFrames(Objects, FileName, StartFrame, EndFrame, Step, Options)
+//
+// Exports a frame range of several point clouds in one go, i.e. PartioExportFrames("pointcloud,pointcloud1",
+// "C:/cache/sim.prt", 1, 1000, 1, "level=fast") writes C:/cache/sim_pointcloud.0001.prt and so on. The format comes from
+// the file extension, Options takes the same channel list / key=value options as the UserData of the file export
+// events. Frames are evaluated in order on the main thread and every frame is converted (on the worker pool) before the
+// next one is evaluated, only writing its files overlaps with the next frames. Shows a progress bar that can cancel the
+// export, returns the number of frames exported.
 
+SICALLBACK PartioExportFrames_Init(CRef& in_ctxt)
+{
+	Context ctxt(in_ctxt);
+	Command oCmd;
+	oCmd = ctxt.GetSource();
+	oCmd.PutDescription(L"Exports a frame range of point clouds to particle files");
+	oCmd.EnableReturnValue(true);
+
+	ArgumentArray oArgs = oCmd.GetArguments();
+	oArgs.AddWithHandler(L"Objects", L"Collection");
+	oArgs.Add(L"FileName", CString());
+	oArgs.Add(L"StartFrame", 1);
+	oArgs.Add(L"EndFrame", 100);
+	oArgs.Add(L"Step", 1);
+	oArgs.Add(L"Options", CString());
+	return CStatus::OK;
+}
 
+SICALLBACK PartioExportFrames_Execute(CRef& in_ctxt)
+{
+	Context ctxt(in_ctxt);
+	CValueArray args = ctxt.GetAttribute(L"Arguments");
+	CValueArray objects = args[0];
+	CString fileName = args[1];
+	LONG startFrame = args[2];
+	LONG endFrame = args[3];
+	LONG step = std::max((LONG)args[4], (LONG)1);
+	std::string userData = CString(args[5]).GetAsciiString();
+
+	ctxt.PutAttribute(L"ReturnValue", 0);
+
+	// errors of an earlier export that haven't been reported yet
+	LogWriteErrors(xsiLog);
+
+	int dotPos = fileName.ReverseFindString(".");
+	CString fnameNoExt = fileName.GetSubString(0, dotPos);
+	CString fnameExt   = fileName.GetSubString(dotPos);
+	fnameExt.Lower(); // partio picks the writer by the lower case extension
+
+	ExportFormatFamily family;
+	if (dotPos < 0 || !GetExportFormatFamily(fnameExt.GetAsciiString(), family))
+	{
+		Application().LogMessage(L"Unsupported file type: " + fileName,siErrorMsg);
+		return CStatus::InvalidArgument;
+	}
+	if (objects.GetCount() == 0 || endFrame < startFrame)
+	{
+		Application().LogMessage(L"Nothing to export, needs at least one object and a valid frame range",siErrorMsg);
+		return CStatus::InvalidArgument;
+	}
+
+	const ExportFormat& format = GetExportFormat(family);
+	const ExportOptions& options = GetExportOptions(userData, xsiLog);
+	const LONG frameCount = (endFrame - startFrame) / step + 1;
+
+	ProgressBar bar = Application().GetUIToolkit().GetProgressBar();
+	bar.PutMinimum(0);
+	bar.PutMaximum(frameCount);
+	bar.PutValue(0);
+	bar.PutCaption(L"Exporting particles");
+	bar.PutCancelEnabled(true);
+	bar.PutVisible(true);
+
+	LONG exportedFrames = 0;
+	LONG failedCount = 0;
+	bool cancelled = false;
+
+	for (LONG frame=startFrame; frame <= endFrame; frame += step)
+	{
+		if (bar.IsCancelPressed())
+		{
+			cancelled = true;
+			break;
+		}
+		bar.PutStatusText(L"Frame " + CString(frame));
+
+		ExportBatch batch(xsiLog);
+		for (int i=0; i < objects.GetCount(); i++)
+		{
+			X3DObject object(objects[i]);
+			if (!object.IsValid())
+			{
+				Application().LogMessage(L"Skipping " + objects[i].GetAsText() + L", it isn't an object",siErrorMsg);
+				failedCount++;
+				continue;
+			}
+
+			Primitive prim = object.GetActivePrimitive();
+			if (prim.GetType() != "pointcloud")
+			{
+				Application().LogMessage(L"Skipping " + object.GetName() + L", only point clouds can be exported",siErrorMsg);
+				failedCount++;
+				continue;
+			}
+
+			XSIParticleSource source(prim, frame);
+			if (!batch.Add(source, format, options, GetObjectFileName(fnameNoExt, object, frame, fnameExt).GetAsciiString()))
+				failedCount++;
+		}
+		batch.Finish(); // only queues the writes, they overlap with evaluating the next frames
+
+		exportedFrames++;
+		bar.Increment();
+	}
+
+	bar.PutStatusText(L"Writing files");
+	bool writesOk = FinishExportRun(xsiLog);
+	bar.PutVisible(false);
+
+	ctxt.PutAttribute(L"ReturnValue", exportedFrames);
+
+	if (cancelled)
+	{
+		Application().LogMessage(L"Export cancelled after " + CString(exportedFrames) + " of " + CString(frameCount) + " frames",siWarningMsg);
+		return CStatus::Abort;
+	}
+	if (failedCount > 0 || !writesOk)
+	{
+		Application().LogMessage(L"Failed to export " + CString(failedCount) + " objects, see the errors above",siErrorMsg);
+		return CStatus::Fail;
+	}
+
+	Application().LogMessage(L"Exported " + CString(exportedFrames) + " frames of " + CString(objects.GetCount()) + " objects",siInfoMsg);
+	return CStatus::OK;
+}
@@ -0,0 +1,122 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by James Vecore
+// james.vecore@gmail.com
+
+
+#include "Partition.h"
+#include "Json.h"
+
+#include <cstdio>
+#include <cctype>
+#include <sstream>
+#include <iomanip>
+
+namespace
+{
+	std::string BaseName(const std::string& fileName)
+	{
+		size_t slashPos = fileName.find_last_of("/\\");
+		return slashPos == std::string::npos ? fileName : fileName.substr(slashPos + 1);
+	}
+}
+
+std::string GetPartitionFileName(const std::string& fileName, int partition, int partitionCount)
+{
+	size_t nameBegin = fileName.find_last_of("/\\");
+	nameBegin = nameBegin == std::string::npos ? 0 : nameBegin + 1;
+
+	size_t insertPos = fileName.find_last_of('.');
+	if (insertPos == std::string::npos || insertPos < nameBegin)
+		insertPos = fileName.size();
+
+	// step over a ".<digits>" frame number in front of the extension
+	size_t digitsBegin = insertPos;
+	while (digitsBegin > nameBegin && isdigit((unsigned char)fileName[digitsBegin - 1]))
+	{
+		digitsBegin--;
+	}
+	if (digitsBegin < insertPos && digitsBegin > nameBegin && fileName[digitsBegin - 1] == '.')
+		insertPos = digitsBegin - 1;
+
+	int digits = 2;
+	for (int n=100; n < partitionCount; n *= 10)
+	{
+		digits++;
+	}
+
+	std::ostringstream ss;
+	ss << "_part" << std::setw(digits) << std::setfill('0') << partition;
+	return fileName.substr(0, insertPos) + ss.str() + fileName.substr(insertPos);
+}
+
+std::string GetPartitionManifestFileName(const std::string& fileName)
+{
+	return fileName + ".manifest.json";
+}
+
+std::string WritePartitionManifest(const std::string& fileName, const std::string& splitBy, const std::string& curve, const std::vector<PartitionInfo>& partitions)
+{
+	int particleCount = 0;
+	for (size_t i=0; i < partitions.size(); i++)
+	{
+		particleCount += partitions[i].ParticleCount;
+	}
+
+	std::ostringstream ss;
+	ss << std::setprecision(9);
+	ss << "{\n";
+	ss << "\t\"file\": \"" << JsonEscape(BaseName(fileName)) << "\",\n";
+	ss << "\t\"split\": \"" << JsonEscape(splitBy) << "\",\n";
+	if (!curve.empty())
+		ss << "\t\"curve\": \"" << JsonEscape(curve) << "\",\n";
+	ss << "\t\"particles\": " << particleCount << ",\n";
+	ss << "\t\"partitions\": [\n";
+	for (size_t i=0; i < partitions.size(); i++)
+	{
+		const PartitionInfo& partition = partitions[i];
+		ss << "\t\t{ \"file\": \"" << JsonEscape(BaseName(partition.FileName)) << "\", \"first\": " << partition.FirstParticle << ", \"particles\": " << partition.ParticleCount;
+		if (partition.HasBounds)
+		{
+			ss << ", \"min\": [" << partition.Min[0] << ", " << partition.Min[1] << ", " << partition.Min[2] << "]";
+			ss << ", \"max\": [" << partition.Max[0] << ", " << partition.Max[1] << ", " << partition.Max[2] << "]";
+		}
+		if (partition.HasIds)
+			ss << ", \"ids\": [" << partition.MinId << ", " << partition.MaxId << "]";
+		ss << " }" << (i + 1 < partitions.size() ? "," : "") << "\n";
+	}
+	ss << "\t]\n";
+	ss << "}\n";
+
+	const std::string manifestFileName = GetPartitionManifestFileName(fileName);
+	FILE* file = fopen(manifestFileName.c_str(), "w");
+	if (file == NULL)
+		return "Failed to open file for writing: " + manifestFileName;
+
+	const std::string text = ss.str();
+	bool ok = fwrite(text.data(), 1, text.size(), file) == text.size();
+	ok = fclose(file) == 0 && ok;
+	if (!ok)
+		return "Failed to write partition manifest: " + manifestFileName;
+	return std::string();
+}
@@ -0,0 +1,62 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by James Vecore
+// james.vecore@gmail.com
+
+
+#ifndef PARTIO_EXPORT_PARTITION_H
+#define PARTIO_EXPORT_PARTITION_H
+
+#include <string>
+#include <vector>
+
+// One file of an object written in several pieces (split=<n>, see ExportOptions.h)
+struct PartitionInfo
+{
+	PartitionInfo() : FirstParticle(0), ParticleCount(0), HasBounds(false), HasIds(false), MinId(0), MaxId(0) {}
+
+	std::string FileName;
+	int FirstParticle; // in the ordered particles of the whole object
+	int ParticleCount;
+	bool HasBounds;    // false without positions or if none of them are finite
+	float Min[3];
+	float Max[3];
+	bool HasIds;
+	int MinId;
+	int MaxId;
+};
+
+// the file name of one partition: "_part<n>" goes before the frame number the same way the object name of a model
+// export does, i.e. sim.0001.prt -> sim_part03.0001.prt, or before the extension if there is no frame number
+std::string GetPartitionFileName(const std::string& fileName, int partition, int partitionCount);
+
+// the manifest written next to the partitions instead of fileName
+std::string GetPartitionManifestFileName(const std::string& fileName);
+
+// Writes a JSON manifest listing the partitions of fileName, their particle counts, bounding boxes and ID ranges, and
+// how the particles were split: splitBy is "tile" or "id", curve the space filling curve of a tile split (empty for
+// other splits, and then not written). File names are relative to the manifest. Returns an empty string on success,
+// otherwise an error message.
+std::string WritePartitionManifest(const std::string& fileName, const std::string& splitBy, const std::string& curve, const std::vector<PartitionInfo>& partitions);
+
+#endif
@@ -0,0 +1,505 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "PrtWriter.h"
+#include "WorkerPool.h"
+#include "ExportOptions.h"
+#include "HalfFloat.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <functional>
+#include <algorithm>
+
+#include <zlib.h>
+
+namespace
+{
+	// prt channel data types, only the ones we write
+	enum PrtDataType
+	{
+		PrtInt32   = 1,
+		PrtFloat16 = 3,
+		PrtFloat32 = 4
+	};
+
+	// uncompressed bytes per compressed block, about what pigz uses times a few to keep the per block overhead low
+	const size_t blockSize = 512 * 1024;
+	const size_t dictionarySize = 32 * 1024;
+
+	// deflate stored blocks, a final bit / type byte and the payload length and its complement
+	const size_t storedBlockHeaderSize = 5;
+	const size_t maxStoredBlockSize = 65535;
+
+	struct PrtBlock
+	{
+		int Begin;
+		int End;
+		bool Last;
+		std::vector<unsigned char> Raw;
+		std::vector<unsigned char> Compressed;
+		uLong Adler;
+		bool Failed;
+	};
+
+	void WriteInt32(std::vector<unsigned char>& out, int value)
+	{
+		// prt is little endian, so is every platform softimage runs on but don't rely on it
+		for (int i=0; i < 4; i++)
+		{
+			out.push_back((unsigned char)((unsigned int)value >> (8*i)));
+		}
+	}
+
+	void WriteInt64(std::vector<unsigned char>& out, long long value)
+	{
+		for (int i=0; i < 8; i++)
+		{
+			out.push_back((unsigned char)((unsigned long long)value >> (8*i)));
+		}
+	}
+
+	void WriteFixedString(std::vector<unsigned char>& out, const char* value, size_t length)
+	{
+		size_t valueLength = std::min(strlen(value), length - 1);
+		out.insert(out.end(), value, value + valueLength);
+		out.insert(out.end(), length - valueLength, 0);
+	}
+
+	// partio type checks data access, so go through the attribute's real type
+	const char* AttributeData(const Partio::ParticlesData& particles, const Partio::ParticleAttribute& attr, int index)
+	{
+		if (attr.type == Partio::INT)
+			return (const char*)particles.data<int>(attr, index);
+		return (const char*)particles.data<float>(attr, index);
+	}
+
+	void InterleaveBlock(const std::vector<PrtChannel>& channels, size_t particleSize, PrtBlock& block)
+	{
+		block.Raw.resize((block.End - block.Begin) * particleSize);
+		for (size_t c=0; c < channels.size(); c++)
+		{
+			const PrtChannel& channel = channels[c];
+			const char* src = channel.Data + block.Begin * channel.Stride;
+			unsigned char* dst = &block.Raw[0] + channel.Offset;
+
+			if (!channel.Half)
+			{
+				for (int i=block.Begin; i < block.End; i++, src += channel.Stride, dst += particleSize)
+				{
+					memcpy(dst, src, channel.Size);
+				}
+				continue;
+			}
+
+			// convert the whole column of the block in one go so the F16C path gets long runs
+			std::vector<unsigned short> halfs((block.End - block.Begin) * channel.Count + 1);
+			if (channel.Stride == channel.Count * sizeof(float))
+			{
+				FloatsToHalfs((const float*)src, &halfs[0], (block.End - block.Begin) * channel.Count);
+			}
+			else
+			{
+				for (int i=0; i < block.End - block.Begin; i++)
+				{
+					FloatsToHalfs((const float*)(src + i * channel.Stride), &halfs[i * channel.Count], channel.Count);
+				}
+			}
+
+			for (int i=0; i < block.End - block.Begin; i++, dst += particleSize)
+			{
+				memcpy(dst, &halfs[i * channel.Count], channel.Size);
+			}
+		}
+	}
+
+	// the file header up to and including the zlib header, and the layout of the interleaved particles
+	std::string BuildHeader(const std::vector<Partio::ParticleAttribute>& attributes, long long particleCount, int compressionLevel, bool halfPrecision, const std::vector<std::string>& halfChannels, std::vector<unsigned char>& header, std::vector<PrtChannel>& channels, size_t& particleSize)
+	{
+		const int numAttributes = (int)attributes.size();
+
+		// file header
+		const unsigned char magic[8] = { 192, 'P', 'R', 'T', '\r', '\n', 26, '\n' };
+		header.insert(header.end(), magic, magic + 8);
+		WriteInt32(header, 56); // header length
+		WriteFixedString(header, "Extensible Particle Format", 32);
+		WriteInt32(header, 1); // version
+		WriteInt64(header, particleCount);
+		WriteInt32(header, 4); // reserved
+		WriteInt32(header, numAttributes);
+		WriteInt32(header, 44); // channel definition length
+
+		channels.clear();
+		particleSize = 0;
+		for (int i=0; i < numAttributes; i++)
+		{
+			const Partio::ParticleAttribute& attr = attributes[i];
+
+			PrtChannel channel;
+			channel.Count = attr.count;
+			channel.Half = false;
+
+			int dataType;
+			switch (attr.type)
+			{
+			case Partio::INT:
+				dataType = PrtInt32;
+				break;
+			case Partio::FLOAT:
+			case Partio::VECTOR:
+				channel.Half = halfPrecision || std::find(halfChannels.begin(), halfChannels.end(), attr.name) != halfChannels.end();
+				dataType = channel.Half ? PrtFloat16 : PrtFloat32;
+				break;
+			default:
+				return "Unsupported attribute type for PRT channel: " + attr.name;
+			}
+			if (attr.name.size() >= 32)
+				return "PRT channel name is longer than 31 characters: " + attr.name;
+			channel.Size = (channel.Half ? 2 : 4) * attr.count;
+			channel.Offset = particleSize;
+			channel.Data = NULL; // set per Write()
+			channel.Stride = channel.Size;
+			channels.push_back(channel);
+
+			WriteFixedString(header, attr.name.c_str(), 32);
+			WriteInt32(header, dataType);
+			WriteInt32(header, attr.count);
+			WriteInt32(header, (int)particleSize);
+
+			particleSize += channel.Size;
+		}
+
+		// zlib stream header, the level bits are only informational
+		int levelBits = compressionLevel == -1 ? 2 : (compressionLevel < 2 ? 0 : (compressionLevel < 6 ? 1 : (compressionLevel == 6 ? 2 : 3)));
+		int zlibHeader = (0x78 << 8) | (levelBits << 6);
+		zlibHeader += 31 - (zlibHeader % 31);
+		header.push_back((unsigned char)(zlibHeader >> 8));
+		header.push_back((unsigned char)(zlibHeader & 0xff));
+		return std::string();
+	}
+
+	// adler32 of the payloads of a run of stored blocks
+	void ChecksumStoredBlocks(const unsigned char* data, size_t blockStride, size_t blockPayload, size_t lastPayload, int begin, int end, int blockCount, uLong* adler)
+	{
+		*adler = 1L;
+		for (int b=begin; b < end; b++)
+		{
+			size_t payload = b == blockCount - 1 ? lastPayload : blockPayload;
+			*adler = adler32_combine(*adler, adler32(1L, data + b*blockStride + storedBlockHeaderSize, (uInt)payload), (z_off_t)payload);
+		}
+	}
+
+	// deflates one block as a piece of a larger raw deflate stream, see the pigz notes in the header
+	void CompressBlock(const std::vector<PrtChannel>& channels, size_t particleSize, int compressionLevel, const std::vector<unsigned char>* dictionary, PrtBlock* block)
+	{
+		InterleaveBlock(channels, particleSize, *block);
+		block->Adler = adler32(1L, block->Raw.empty() ? Z_NULL : &block->Raw[0], (uInt)block->Raw.size());
+
+		z_stream strm;
+		memset(&strm, 0, sizeof(strm));
+		block->Failed = deflateInit2(&strm, compressionLevel, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK;
+		if (block->Failed)
+			return;
+
+		if (dictionary != NULL && !dictionary->empty())
+			deflateSetDictionary(&strm, &(*dictionary)[0], (uInt)dictionary->size());
+
+		block->Compressed.resize(deflateBound(&strm, (uLong)block->Raw.size()) + 16);
+		strm.next_in = block->Raw.empty() ? Z_NULL : &block->Raw[0];
+		strm.avail_in = (uInt)block->Raw.size();
+		strm.next_out = &block->Compressed[0];
+		strm.avail_out = (uInt)block->Compressed.size();
+
+		// a sync flush ends the block byte aligned without marking it as the last one, so blocks can just be appended
+		int res = deflate(&strm, block->Last ? Z_FINISH : Z_SYNC_FLUSH);
+		block->Failed = (block->Last ? res != Z_STREAM_END : res != Z_OK) || strm.avail_in != 0 || strm.avail_out == 0;
+		block->Compressed.resize(block->Compressed.size() - strm.avail_out);
+		deflateEnd(&strm);
+	}
+}
+
+PrtStreamWriter::PrtStreamWriter(WorkerPool& pool)
+	: m_pool(pool), m_file(NULL), m_particleSize(0), m_compressionLevel(-1), m_adler(1L), m_particleCount(0), m_written(0), m_ok(false)
+{
+}
+
+PrtStreamWriter::~PrtStreamWriter()
+{
+	if (m_file != NULL)
+		fclose(m_file);
+}
+
+std::string PrtStreamWriter::Open(const std::string& fileName, const Partio::ParticlesData& particles, long long particleCount, const ExportOptions& options, const std::vector<std::string>& halfChannels)
+{
+	m_fileName = fileName;
+	m_compressionLevel = options.Compress == ExportOptions::CompressionOff ? 0 : options.CompressionLevel;
+	m_particleCount = particleCount;
+
+	std::vector<Partio::ParticleAttribute> attributes(particles.numAttributes());
+	for (int i=0; i < particles.numAttributes(); i++)
+	{
+		particles.attributeInfo(i, attributes[i]);
+	}
+
+	std::vector<unsigned char> header;
+	std::string error = BuildHeader(attributes, particleCount, m_compressionLevel, options.HalfPrecision, halfChannels, header, m_channels, m_particleSize);
+	if (!error.empty())
+		return error;
+
+	m_file = fopen(fileName.c_str(), "wb");
+	if (m_file == NULL)
+		return "Failed to open file for writing: " + fileName;
+
+	if (options.BufferSize > 0)
+		setvbuf(m_file, NULL, _IOFBF, options.BufferSize);
+
+	m_ok = fwrite(&header[0], 1, header.size(), m_file) == header.size();
+	if (!m_ok)
+		return "Failed to write PRT file: " + fileName;
+	return std::string();
+}
+
+std::string PrtStreamWriter::Write(const Partio::ParticlesData& particles, int numParticles)
+{
+	if (m_file == NULL || !m_ok)
+		return "Failed to write PRT file: " + m_fileName;
+	if (m_written + numParticles > m_particleCount)
+		return "More particles than announced written to PRT file: " + m_fileName;
+
+	for (size_t c=0; c < m_channels.size(); c++)
+	{
+		Partio::ParticleAttribute attr;
+		particles.attributeInfo((int)c, attr);
+
+		PrtChannel& channel = m_channels[c];
+		channel.Data = numParticles > 0 ? AttributeData(particles, attr, 0) : NULL;
+		channel.Stride = numParticles > 1 ? AttributeData(particles, attr, 1) - channel.Data : channel.Size;
+	}
+
+	// compress a batch of blocks per pool thread at a time, that bounds the memory to a few blocks per thread
+	const size_t particleSize = m_particleSize;
+	const int blockParticles = (int)std::max(size_t(1), blockSize / std::max(particleSize, size_t(1)));
+	const int batchBlocks = 2 * m_pool.GetThreadCount();
+
+	int begin = 0;
+	while (begin < numParticles && m_ok)
+	{
+		std::vector<PrtBlock> blocks;
+		for (int b=0; b < batchBlocks && begin < numParticles; b++)
+		{
+			PrtBlock block;
+			block.Begin = begin;
+			block.End = std::min(begin + blockParticles, numParticles);
+			block.Last = false;
+			block.Adler = 1L;
+			block.Failed = false;
+			blocks.push_back(block);
+			begin = block.End;
+		}
+
+		// every block is primed with the last 32K of the data before it, the first one of a batch with what the last
+		// batch ended on and the rest with their predecessor in this batch (interleaved again, that's cheap)
+		std::vector< std::vector<unsigned char> > dictionaries(blocks.size());
+		dictionaries[0] = m_dictionary;
+		for (size_t b=1; b < blocks.size(); b++)
+		{
+			PrtBlock previous;
+			previous.Begin = std::max(blocks[b].Begin - (int)(dictionarySize / std::max(particleSize, size_t(1))) - 1, blocks[b-1].Begin);
+			previous.End = blocks[b].Begin;
+			InterleaveBlock(m_channels, particleSize, previous);
+			size_t keep = std::min(previous.Raw.size(), dictionarySize);
+			dictionaries[b].assign(previous.Raw.end() - keep, previous.Raw.end());
+		}
+
+		std::vector< std::function<void()> > tasks;
+		for (size_t b=0; b < blocks.size(); b++)
+		{
+			tasks.push_back(std::bind(&CompressBlock, std::cref(m_channels), particleSize, m_compressionLevel, &dictionaries[b], &blocks[b]));
+		}
+		m_pool.Run(tasks);
+
+		for (size_t b=0; b < blocks.size() && m_ok; b++)
+		{
+			PrtBlock& block = blocks[b];
+			m_ok = !block.Failed && fwrite(&block.Compressed[0], 1, block.Compressed.size(), m_file) == block.Compressed.size();
+			m_adler = adler32_combine(m_adler, block.Adler, (z_off_t)block.Raw.size());
+		}
+
+		PrtBlock& lastBlock = blocks.back();
+		size_t keep = std::min(lastBlock.Raw.size(), dictionarySize);
+		m_dictionary.assign(lastBlock.Raw.end() - keep, lastBlock.Raw.end());
+	}
+
+	m_written += numParticles;
+
+	if (!m_ok)
+		return "Failed to write PRT file: " + m_fileName;
+	return std::string();
+}
+
+std::string PrtStreamWriter::Close()
+{
+	if (m_file == NULL)
+		return "Failed to write PRT file: " + m_fileName;
+
+	// an empty final block ends the deflate stream, so Write() never has to know which block is the last one
+	PrtBlock last;
+	last.Begin = 0;
+	last.End = 0;
+	last.Last = true;
+	last.Failed = false;
+	CompressBlock(m_channels, m_particleSize, m_compressionLevel, NULL, &last);
+	m_ok = m_ok && !last.Failed && fwrite(&last.Compressed[0], 1, last.Compressed.size(), m_file) == last.Compressed.size();
+
+	// zlib trailer, adler32 of the uncompressed data in big endian
+	unsigned char trailer[4] = { (unsigned char)(m_adler >> 24), (unsigned char)(m_adler >> 16), (unsigned char)(m_adler >> 8), (unsigned char)m_adler };
+	m_ok = m_ok && fwrite(trailer, 1, 4, m_file) == 4;
+	m_ok = (fclose(m_file) == 0) && m_ok;
+	m_file = NULL;
+
+	if (!m_ok)
+		return "Failed to write PRT file: " + m_fileName;
+	if (m_written != m_particleCount)
+		return "Fewer particles than announced written to PRT file: " + m_fileName;
+	return std::string();
+}
+
+std::string WritePRT(const std::string& fileName, const Partio::ParticlesData& particles, const ExportOptions& options, const std::vector<std::string>& halfChannels, WorkerPool& pool)
+{
+	return WritePRT(fileName, particles, particles.numParticles(), options, halfChannels, pool);
+}
+
+std::string WritePRT(const std::string& fileName, const Partio::ParticlesData& particles, int particleCount, const ExportOptions& options, const std::vector<std::string>& halfChannels, WorkerPool& pool)
+{
+	PrtStreamWriter writer(pool);
+	std::string error = writer.Open(fileName, particles, particleCount, options, halfChannels);
+	if (error.empty())
+		error = writer.Write(particles, particleCount);
+	if (error.empty())
+		error = writer.Close();
+	return error;
+}
+
+PrtMappedWriter::PrtMappedWriter()
+	: m_particleSize(0), m_dataOffset(0), m_blockParticles(1), m_blockCount(0), m_particleCount(0)
+{
+}
+
+PrtMappedWriter::~PrtMappedWriter()
+{
+}
+
+std::string PrtMappedWriter::Open(const std::string& fileName, const std::vector<Partio::ParticleAttribute>& attributes, int particleCount)
+{
+	m_fileName = fileName;
+	m_particleCount = particleCount;
+
+	std::vector<unsigned char> header;
+	std::string error = BuildHeader(attributes, particleCount, 0, false, std::vector<std::string>(), header, m_channels, m_particleSize);
+	if (!error.empty())
+		return error;
+	if (m_particleSize == 0 || m_particleSize > maxStoredBlockSize)
+		return "Unsupported particle size for a mapped PRT file: " + fileName;
+
+	// every stored block holds whole particles, even an empty file has one (final) block
+	m_blockParticles = (int)(maxStoredBlockSize / m_particleSize);
+	m_blockCount = std::max(1, (particleCount + m_blockParticles - 1) / m_blockParticles);
+	m_dataOffset = header.size();
+
+	const size_t dataSize = size_t(particleCount) * m_particleSize;
+	error = m_file.Create(fileName, m_dataOffset + m_blockCount * storedBlockHeaderSize + dataSize + 4);
+	if (!error.empty())
+		return error;
+
+	unsigned char* data = (unsigned char*)m_file.GetData();
+	memcpy(data, &header[0], header.size());
+	for (int b=0; b < m_blockCount; b++)
+	{
+		size_t payload = b == m_blockCount - 1 ? dataSize - size_t(b) * m_blockParticles * m_particleSize : m_blockParticles * m_particleSize;
+		unsigned char* blockHeader = data + m_dataOffset + b * GetBlockStride();
+		blockHeader[0] = b == m_blockCount - 1 ? 1 : 0;
+		blockHeader[1] = (unsigned char)(payload & 0xff);
+		blockHeader[2] = (unsigned char)(payload >> 8);
+		blockHeader[3] = (unsigned char)(~payload & 0xff);
+		blockHeader[4] = (unsigned char)((~payload >> 8) & 0xff);
+	}
+	return std::string();
+}
+
+PrtMappedChannel PrtMappedWriter::GetChannel(int attribute) const
+{
+	PrtMappedChannel channel;
+	channel.Data = m_file.GetData() + m_dataOffset + storedBlockHeaderSize + m_channels[attribute].Offset;
+	channel.Stride = m_particleSize;
+	channel.BlockParticles = m_blockParticles;
+	channel.BlockStride = GetBlockStride();
+	return channel;
+}
+
+size_t PrtMappedWriter::GetBlockStride() const
+{
+	return storedBlockHeaderSize + m_blockParticles * m_particleSize;
+}
+
+std::string PrtMappedWriter::Close(WorkerPool& pool)
+{
+	if (m_file.GetData() == NULL)
+		return "Failed to write PRT file: " + m_fileName;
+
+	const unsigned char* blocks = (const unsigned char*)m_file.GetData() + m_dataOffset;
+	const size_t blockPayload = m_blockParticles * m_particleSize;
+	const size_t lastPayload = size_t(m_particleCount) * m_particleSize - size_t(m_blockCount - 1) * blockPayload;
+
+	// checksum runs of blocks on the pool and combine them in order
+	const int runBlocks = std::max(1, (int)(blockSize / std::max(blockPayload, size_t(1))));
+	const int runCount = (m_blockCount + runBlocks - 1) / runBlocks;
+	std::vector<uLong> runAdlers(runCount);
+	std::vector< std::function<void()> > tasks;
+	for (int r=0; r < runCount; r++)
+	{
+		int begin = r * runBlocks;
+		tasks.push_back(std::bind(&ChecksumStoredBlocks, blocks, GetBlockStride(), blockPayload, lastPayload, begin, std::min(begin + runBlocks, m_blockCount), m_blockCount, &runAdlers[r]));
+	}
+	pool.Run(tasks);
+
+	uLong adler = 1L;
+	for (int r=0; r < runCount; r++)
+	{
+		int end = std::min((r + 1) * runBlocks, m_blockCount);
+		size_t runSize = size_t(end - r * runBlocks) * blockPayload - (end == m_blockCount ? blockPayload - lastPayload : 0);
+		adler = adler32_combine(adler, runAdlers[r], (z_off_t)runSize);
+	}
+
+	// zlib trailer, adler32 of the uncompressed data in big endian
+	unsigned char* trailer = (unsigned char*)m_file.GetData() + m_file.GetSize() - 4;
+	trailer[0] = (unsigned char)(adler >> 24);
+	trailer[1] = (unsigned char)(adler >> 16);
+	trailer[2] = (unsigned char)(adler >> 8);
+	trailer[3] = (unsigned char)adler;
+
+	std::string error = m_file.Close();
+	if (!error.empty())
+		return "Failed to write PRT file: " + m_fileName;
+	return std::string();
+}
@@ -0,0 +1,136 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef PARTIO_EXPORT_PRT_WRITER_H
+#define PARTIO_EXPORT_PRT_WRITER_H
+
+#include <string>
+#include <vector>
+#include <cstdio>
+
+#include <Partio.h>
+#include <zlib.h>
+
+#include "MappedFile.h"
+
+class WorkerPool;
+struct ExportOptions;
+
+// Krakatoa PRT (version 1) writer.
+//
+// Partio's writer builds the whole interleaved particle buffer in memory and deflates it on one thread. This one
+// interleaves and deflates independent blocks of particles on the worker pool and stitches them into a single valid
+// zlib stream the way pigz does (raw deflate blocks ended with a sync flush, each primed with the tail of the previous
+// block, followed by the combined adler32), so only a few blocks are held in memory at any time.
+//
+// Uses the compression, precision and buffer size settings of options (see ExportOptions.h). Float channels listed in
+// halfChannels (partio attribute names), or all of them with precision=half, are written as PRT float16.
+// Returns an empty string on success, otherwise an error message.
+std::string WritePRT(const std::string& fileName, const Partio::ParticlesData& particles, const ExportOptions& options, const std::vector<std::string>& halfChannels, WorkerPool& pool);
+// only writes the first particleCount particles, for particle sets reused from a frame with more particles
+std::string WritePRT(const std::string& fileName, const Partio::ParticlesData& particles, int particleCount, const ExportOptions& options, const std::vector<std::string>& halfChannels, WorkerPool& pool);
+
+struct PrtChannel
+{
+	const char* Data;
+	size_t Stride;
+	size_t Size;   // bytes per particle in the file
+	size_t Offset; // into the interleaved particle
+	int Count;
+	bool Half;     // float data written as float16
+};
+
+// The same writer for files that are written in pieces: Open() writes the header for the channels of a particle set
+// and the total particle count, every Write() appends the first numParticles particles of a set with the same channels.
+// Only the blocks of the current Write() are held in memory. Close() fails if fewer particles than announced were
+// written.
+class PrtStreamWriter
+{
+public:
+	PrtStreamWriter(WorkerPool& pool);
+	~PrtStreamWriter();
+
+	std::string Open(const std::string& fileName, const Partio::ParticlesData& particles, long long particleCount, const ExportOptions& options, const std::vector<std::string>& halfChannels);
+	std::string Write(const Partio::ParticlesData& particles, int numParticles);
+	std::string Close();
+
+private:
+	PrtStreamWriter(const PrtStreamWriter&);
+	PrtStreamWriter& operator=(const PrtStreamWriter&);
+
+	WorkerPool& m_pool;
+	std::string m_fileName;
+	FILE* m_file;
+	std::vector<PrtChannel> m_channels;
+	size_t m_particleSize;
+	int m_compressionLevel;
+	uLong m_adler;
+	std::vector<unsigned char> m_dictionary;
+	long long m_particleCount;
+	long long m_written;
+	bool m_ok;
+};
+
+// Where one channel goes in a mapped PRT file: particle i is at
+// Data + (i / BlockParticles) * BlockStride + (i % BlockParticles) * Stride
+struct PrtMappedChannel
+{
+	char* Data;
+	size_t Stride;
+	int BlockParticles;
+	size_t BlockStride;
+};
+
+// Uncompressed PRT (compress=off or level=0, no half precision channels) written through a memory mapping. The zlib
+// stream is made of stored blocks that each hold a whole number of particles, so where every value goes is known as
+// soon as the file is opened and the exporter converts straight into the mapping instead of going through a partio
+// particle set and stdio. Close() fills in the checksum, also on the pool.
+class PrtMappedWriter
+{
+public:
+	PrtMappedWriter();
+	~PrtMappedWriter();
+
+	// attributes are partio attribute descriptions, only name, type and count are used
+	std::string Open(const std::string& fileName, const std::vector<Partio::ParticleAttribute>& attributes, int particleCount);
+	PrtMappedChannel GetChannel(int attribute) const;
+	size_t GetFileSize() const { return m_file.GetSize(); }
+	std::string Close(WorkerPool& pool);
+
+private:
+	PrtMappedWriter(const PrtMappedWriter&);
+	PrtMappedWriter& operator=(const PrtMappedWriter&);
+
+	size_t GetBlockStride() const;
+
+	MappedFile m_file;
+	std::string m_fileName;
+	std::vector<PrtChannel> m_channels;
+	size_t m_particleSize;
+	size_t m_dataOffset; // of the first stored block
+	int m_blockParticles;
+	int m_blockCount;
+	int m_particleCount;
+};
+
+#endif
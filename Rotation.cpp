@@ -0,0 +1,297 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by James Vecore
+// james.vecore@gmail.com
+
+#include "Rotation.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define PARTIO_EXPORT_SSE
+#include <xmmintrin.h>
+#endif
+
+static const char* conventionNames[RotationConventionCount] = { "native", "xyzw", "wxyz", "axisangle", "eulerxyz", "eulerxzy", "euleryxz", "euleryzx", "eulerzxy", "eulerzyx" };
+
+bool ParseRotationConvention(const std::string& name, RotationConvention& convention)
+{
+	for (int i=0; i < RotationConventionCount; i++)
+	{
+		if (name == conventionNames[i])
+		{
+			convention = (RotationConvention)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+const char* GetRotationConventionName(RotationConvention convention)
+{
+	return conventionNames[convention];
+}
+
+namespace
+{
+
+struct Quaternion
+{
+	float x, y, z, w;
+};
+
+// Euler order as axis indices, First is applied first. Parity is -1 for the orders that are odd permutations of xyz.
+struct EulerAxes
+{
+	int First, Second, Third;
+	float Parity;
+};
+
+EulerAxes GetEulerAxes(RotationConvention convention)
+{
+	static const EulerAxes axes[] =
+	{
+		{ 0, 1, 2,  1.0f }, // xyz
+		{ 0, 2, 1, -1.0f }, // xzy
+		{ 1, 0, 2, -1.0f }, // yxz
+		{ 1, 2, 0,  1.0f }, // yzx
+		{ 2, 0, 1,  1.0f }, // zxy
+		{ 2, 1, 0, -1.0f }  // zyx
+	};
+	return axes[convention - RotationEulerXYZ];
+}
+
+inline Quaternion Multiply(const Quaternion& a, const Quaternion& b)
+{
+	Quaternion q;
+	q.x = a.w*b.x + a.x*b.w + a.y*b.z - a.z*b.y;
+	q.y = a.w*b.y - a.x*b.z + a.y*b.w + a.z*b.x;
+	q.z = a.w*b.z + a.x*b.y - a.y*b.x + a.z*b.w;
+	q.w = a.w*b.w - a.x*b.x - a.y*b.y - a.z*b.z;
+	return q;
+}
+
+inline Quaternion AxisRotation(int axis, float angle)
+{
+	Quaternion q = { 0.0f, 0.0f, 0.0f, cosf(0.5f * angle) };
+	(&q.x)[axis] = sinf(0.5f * angle);
+	return q;
+}
+
+// readers turn one source value into a quaternion, writers store a quaternion in the target convention
+
+struct ReadQuaternionXYZW
+{
+	Quaternion operator()(const float* v) const
+	{
+		Quaternion q = { v[0], v[1], v[2], v[3] };
+		return q;
+	}
+};
+
+struct ReadQuaternionWXYZ
+{
+	Quaternion operator()(const float* v) const
+	{
+		Quaternion q = { v[1], v[2], v[3], v[0] };
+		return q;
+	}
+};
+
+// a zero axis is no rotation
+struct ReadAxisAngle
+{
+	Quaternion operator()(const float* v) const
+	{
+		const float length = sqrtf(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+		const float scale = length > 0.0f ? sinf(0.5f * v[3]) / length : 0.0f;
+		Quaternion q = { v[0] * scale, v[1] * scale, v[2] * scale, length > 0.0f ? cosf(0.5f * v[3]) : 1.0f };
+		return q;
+	}
+};
+
+struct ReadEuler
+{
+	explicit ReadEuler(const EulerAxes& axes) : Axes(axes) {}
+
+	Quaternion operator()(const float* v) const
+	{
+		return Multiply(Multiply(AxisRotation(Axes.Third, v[Axes.Third]), AxisRotation(Axes.Second, v[Axes.Second])), AxisRotation(Axes.First, v[Axes.First]));
+	}
+
+	EulerAxes Axes;
+};
+
+struct WriteQuaternionXYZW
+{
+	void operator()(const Quaternion& q, float* out) const
+	{
+		out[0] = q.x;
+		out[1] = q.y;
+		out[2] = q.z;
+		out[3] = q.w;
+	}
+};
+
+struct WriteQuaternionWXYZ
+{
+	void operator()(const Quaternion& q, float* out) const
+	{
+		out[0] = q.w;
+		out[1] = q.x;
+		out[2] = q.y;
+		out[3] = q.z;
+	}
+};
+
+// the angle is in [0, 2 pi], no rotation gets the x axis
+struct WriteAxisAngle
+{
+	void operator()(const Quaternion& q, float* out) const
+	{
+		const float length = sqrtf(q.x*q.x + q.y*q.y + q.z*q.z);
+		const float scale = length > 0.0f ? 1.0f / length : 0.0f;
+		out[0] = length > 0.0f ? q.x * scale : 1.0f;
+		out[1] = q.y * scale;
+		out[2] = q.z * scale;
+		out[3] = 2.0f * atan2f(length, q.w);
+	}
+};
+
+// through the rotation matrix of the normalized quaternion, the middle angle is in [-pi/2, pi/2]
+struct WriteEuler
+{
+	explicit WriteEuler(const EulerAxes& axes) : Axes(axes) {}
+
+	void operator()(const Quaternion& q, float* out) const
+	{
+		const float norm = q.x*q.x + q.y*q.y + q.z*q.z + q.w*q.w;
+		const float s = norm > 0.0f ? 2.0f / norm : 0.0f;
+		float m[3][3];
+		m[0][0] = 1.0f - s*(q.y*q.y + q.z*q.z);
+		m[0][1] = s*(q.x*q.y - q.w*q.z);
+		m[0][2] = s*(q.x*q.z + q.w*q.y);
+		m[1][0] = s*(q.x*q.y + q.w*q.z);
+		m[1][1] = 1.0f - s*(q.x*q.x + q.z*q.z);
+		m[1][2] = s*(q.y*q.z - q.w*q.x);
+		m[2][0] = s*(q.x*q.z - q.w*q.y);
+		m[2][1] = s*(q.y*q.z + q.w*q.x);
+		m[2][2] = 1.0f - s*(q.x*q.x + q.y*q.y);
+
+		const int i = Axes.First, j = Axes.Second, k = Axes.Third;
+		const float p = Axes.Parity;
+		out[j] = asinf(std::max(-1.0f, std::min(1.0f, -p * m[k][i])));
+		out[i] = atan2f(p * m[k][j], m[k][k]);
+		out[k] = atan2f(p * m[j][i], m[i][i]);
+		out[3] = 0.0f;
+	}
+
+	EulerAxes Axes;
+};
+
+template <typename Reader, typename Writer>
+void ConvertLoop(const float* src, size_t srcStride, float* dst, size_t dstStride, int count, const Reader& read, const Writer& write)
+{
+	const char* srcBytes = (const char*)src;
+	char* dstBytes = (char*)dst;
+	for (int i=0; i < count; i++)
+	{
+		write(read((const float*)(srcBytes + i*srcStride)), (float*)(dstBytes + i*dstStride));
+	}
+}
+
+template <typename Reader>
+void ConvertFrom(const float* src, size_t srcStride, const Reader& read, RotationConvention convention, float* dst, size_t dstStride, int count)
+{
+	switch (convention)
+	{
+	case RotationQuaternionXYZW:
+		return ConvertLoop(src, srcStride, dst, dstStride, count, read, WriteQuaternionXYZW());
+	case RotationQuaternionWXYZ:
+		return ConvertLoop(src, srcStride, dst, dstStride, count, read, WriteQuaternionWXYZ());
+	case RotationAxisAngle:
+		return ConvertLoop(src, srcStride, dst, dstStride, count, read, WriteAxisAngle());
+	default:
+		return ConvertLoop(src, srcStride, dst, dstStride, count, read, WriteEuler(GetEulerAxes(convention)));
+	}
+}
+
+// quaternion to quaternion is only a reorder, one shuffle per particle
+void SwizzleQuaternions(const float* src, size_t srcStride, bool srcWXYZ, float* dst, size_t dstStride, bool dstWXYZ, int count)
+{
+	const char* srcBytes = (const char*)src;
+	char* dstBytes = (char*)dst;
+	if (srcWXYZ == dstWXYZ)
+	{
+		for (int i=0; i < count; i++)
+			memcpy(dstBytes + i*dstStride, srcBytes + i*srcStride, 4*sizeof(float));
+		return;
+	}
+
+#ifdef PARTIO_EXPORT_SSE
+	if (srcWXYZ)
+	{
+		for (int i=0; i < count; i++)
+		{
+			__m128 v = _mm_loadu_ps((const float*)(srcBytes + i*srcStride));
+			_mm_storeu_ps((float*)(dstBytes + i*dstStride), _mm_shuffle_ps(v, v, _MM_SHUFFLE(0,3,2,1)));
+		}
+	}
+	else
+	{
+		for (int i=0; i < count; i++)
+		{
+			__m128 v = _mm_loadu_ps((const float*)(srcBytes + i*srcStride));
+			_mm_storeu_ps((float*)(dstBytes + i*dstStride), _mm_shuffle_ps(v, v, _MM_SHUFFLE(2,1,0,3)));
+		}
+	}
+#else
+	if (srcWXYZ)
+		ConvertLoop(src, srcStride, dst, dstStride, count, ReadQuaternionWXYZ(), WriteQuaternionXYZW());
+	else
+		ConvertLoop(src, srcStride, dst, dstStride, count, ReadQuaternionXYZW(), WriteQuaternionWXYZ());
+#endif
+}
+
+}
+
+void ConvertRotations(const float* src, size_t srcStride, ParticleRotationForm form, bool wxyz, RotationConvention convention, float* dst, size_t dstStride, int count)
+{
+	switch (form)
+	{
+	case ParticleRotationQuaternion:
+		if (convention == RotationQuaternionXYZW || convention == RotationQuaternionWXYZ)
+			return SwizzleQuaternions(src, srcStride, wxyz, dst, dstStride, convention == RotationQuaternionWXYZ, count);
+		if (wxyz)
+			return ConvertFrom(src, srcStride, ReadQuaternionWXYZ(), convention, dst, dstStride, count);
+		return ConvertFrom(src, srcStride, ReadQuaternionXYZW(), convention, dst, dstStride, count);
+	case ParticleRotationAxisAngle:
+		return ConvertFrom(src, srcStride, ReadAxisAngle(), convention, dst, dstStride, count);
+	case ParticleRotationEulerXYZ:
+		return ConvertFrom(src, srcStride, ReadEuler(GetEulerAxes(RotationEulerXYZ)), convention, dst, dstStride, count);
+	default:
+		return;
+	}
+}
@@ -0,0 +1,62 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by James Vecore
+// james.vecore@gmail.com
+
+#ifndef PARTIO_EXPORT_ROTATION_H
+#define PARTIO_EXPORT_ROTATION_H
+
+#include <string>
+#include <cstddef>
+
+#include "ParticleSource.h"
+
+// How Quaternion and Rotation attributes are written (rotation=..., see ExportOptions.h). Native writes the data the
+// way it was fetched: quaternions x,y,z,w, axis angles x,y,z,angle and Euler angles x,y,z. The others convert every
+// particle to one convention. Euler angles are radians in x,y,z slots whatever the order, the order only says which
+// rotation is applied first (EulerZYX rotates about z, then y, then x). Angles are radians, unused slots are 0.
+enum RotationConvention
+{
+	RotationNative,
+	RotationQuaternionXYZW,
+	RotationQuaternionWXYZ,
+	RotationAxisAngle,
+	RotationEulerXYZ,
+	RotationEulerXZY,
+	RotationEulerYXZ,
+	RotationEulerYZX,
+	RotationEulerZXY,
+	RotationEulerZYX,
+	RotationConventionCount
+};
+
+// names used by the rotation option: native, xyzw, wxyz, axisangle, eulerxyz, eulerxzy, ...
+bool ParseRotationConvention(const std::string& name, RotationConvention& convention);
+const char* GetRotationConventionName(RotationConvention convention);
+
+// Converts count rotations of 4 floats, srcStride and dstStride bytes apart (srcStride 0 converts one value count
+// times), from form (wxyz for quaternions stored w first) to convention, which must not be RotationNative. The form
+// and convention are resolved once per call, the loop itself doesn't branch per particle.
+void ConvertRotations(const float* src, size_t srcStride, ParticleRotationForm form, bool wxyz, RotationConvention convention, float* dst, size_t dstStride, int count);
+
+#endif
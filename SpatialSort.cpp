@@ -0,0 +1,334 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by James Vecore
+// james.vecore@gmail.com
+
+
+#include "SpatialSort.h"
+#include "WorkerPool.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <functional>
+
+namespace
+{
+	const int curveBits = 10; // per axis, 30 bit keys
+	const int keyChunkSize = 256 * 1024;
+
+	struct Bounds
+	{
+		Bounds() : Valid(false) {}
+
+		void Add(const float* p)
+		{
+			if (!Valid)
+			{
+				std::copy(p, p + 3, Min);
+				std::copy(p, p + 3, Max);
+				Valid = true;
+				return;
+			}
+			for (int a=0; a < 3; a++)
+			{
+				Min[a] = std::min(Min[a], p[a]);
+				Max[a] = std::max(Max[a], p[a]);
+			}
+		}
+
+		void Add(const Bounds& other)
+		{
+			if (!other.Valid)
+				return;
+			Add(other.Min);
+			Add(other.Max);
+		}
+
+		bool Valid;
+		float Min[3];
+		float Max[3];
+	};
+
+	inline bool IsFinite(const float* p)
+	{
+		return std::isfinite(p[0]) && std::isfinite(p[1]) && std::isfinite(p[2]);
+	}
+
+	void ComputeBounds(const char* positions, size_t stride, int begin, int end, Bounds* bounds)
+	{
+		for (int i=begin; i < end; i++)
+		{
+			const float* p = (const float*)(positions + i*stride);
+			if (IsFinite(p))
+				bounds->Add(p);
+		}
+	}
+
+	// spreads the low 10 bits of v so there are two zero bits between each of them
+	inline unsigned int Part1By2(unsigned int v)
+	{
+		v &= 0x3ff;
+		v = (v | (v << 16)) & 0x030000ff;
+		v = (v | (v <<  8)) & 0x0300f00f;
+		v = (v | (v <<  4)) & 0x030c30c3;
+		v = (v | (v <<  2)) & 0x09249249;
+		return v;
+	}
+
+	inline unsigned int MortonKey(unsigned int x, unsigned int y, unsigned int z)
+	{
+		return (Part1By2(x) << 2) | (Part1By2(y) << 1) | Part1By2(z);
+	}
+
+	// John Skilling's "Programming the Hilbert curve" (AxestoTranspose), the interleaved bits of the transposed
+	// coordinates are the index along the curve
+	inline unsigned int HilbertKey(unsigned int x, unsigned int y, unsigned int z)
+	{
+		unsigned int X[3] = { x, y, z };
+		const unsigned int M = 1u << (curveBits - 1);
+
+		for (unsigned int Q = M; Q > 1; Q >>= 1)
+		{
+			const unsigned int P = Q - 1;
+			for (int i=0; i < 3; i++)
+			{
+				if (X[i] & Q)
+				{
+					X[0] ^= P;
+				}
+				else
+				{
+					unsigned int t = (X[0] ^ X[i]) & P;
+					X[0] ^= t;
+					X[i] ^= t;
+				}
+			}
+		}
+
+		X[1] ^= X[0];
+		X[2] ^= X[1];
+		unsigned int t = 0;
+		for (unsigned int Q = M; Q > 1; Q >>= 1)
+		{
+			if (X[2] & Q)
+				t ^= Q - 1;
+		}
+		for (int i=0; i < 3; i++)
+		{
+			X[i] ^= t;
+		}
+
+		return MortonKey(X[0], X[1], X[2]);
+	}
+
+	struct KeyJob
+	{
+		const char* Positions;
+		size_t Stride;
+		SpatialOrder Order;
+		float Min[3];
+		float Scale[3];
+		int CellShift;
+		int Resolution;
+		unsigned long long* Keys; // curve key in the high 32 bits, particle index in the low ones
+		unsigned int* Cells;
+	};
+
+	void ComputeKeys(const KeyJob* job, int begin, int end)
+	{
+		const unsigned int maxCoord = (1u << curveBits) - 1;
+		for (int i=begin; i < end; i++)
+		{
+			const float* p = (const float*)(job->Positions + i*job->Stride);
+			unsigned int q[3] = { 0, 0, 0 }; // points that aren't finite go into the first cell
+			if (IsFinite(p))
+			{
+				for (int a=0; a < 3; a++)
+				{
+					float v = (p[a] - job->Min[a]) * job->Scale[a];
+					q[a] = v <= 0.0f ? 0 : std::min((unsigned int)v, maxCoord);
+				}
+			}
+
+			unsigned int key = job->Order == SpatialOrderHilbert ? HilbertKey(q[0], q[1], q[2]) : MortonKey(q[0], q[1], q[2]);
+			job->Keys[i] = ((unsigned long long)key << 32) | (unsigned int)i;
+			job->Cells[i] = (q[0] >> job->CellShift) + ((q[1] >> job->CellShift) + (q[2] >> job->CellShift) * job->Resolution) * job->Resolution;
+		}
+	}
+
+	// LSD radix sort on the 30 key bits, stable so particles with the same key keep their order
+	void RadixSortKeys(std::vector<unsigned long long>& keys)
+	{
+		const int digitBits = 10;
+		std::vector<unsigned long long> scratch(keys.size());
+		std::vector<size_t> offsets(1 << digitBits);
+
+		for (int shift=32; shift < 32 + 3*curveBits; shift += digitBits)
+		{
+			std::fill(offsets.begin(), offsets.end(), 0);
+			for (size_t i=0; i < keys.size(); i++)
+			{
+				offsets[(keys[i] >> shift) & ((1 << digitBits) - 1)]++;
+			}
+			size_t sum = 0;
+			for (size_t d=0; d < offsets.size(); d++)
+			{
+				size_t count = offsets[d];
+				offsets[d] = sum;
+				sum += count;
+			}
+			for (size_t i=0; i < keys.size(); i++)
+			{
+				scratch[offsets[(keys[i] >> shift) & ((1 << digitBits) - 1)]++] = keys[i];
+			}
+			keys.swap(scratch);
+		}
+	}
+
+	void WriteInt32(std::vector<unsigned char>& out, unsigned int value)
+	{
+		for (int i=0; i < 4; i++)
+		{
+			out.push_back((unsigned char)(value >> (8*i)));
+		}
+	}
+
+	void WriteFloat32(std::vector<unsigned char>& out, float value)
+	{
+		unsigned int bits;
+		memcpy(&bits, &value, sizeof(bits));
+		WriteInt32(out, bits);
+	}
+}
+
+void ComputeSpatialOrder(const char* positions, size_t stride, int numParticles, SpatialOrder order, int resolution, std::vector<unsigned int>& permutation, SpatialIndex& index, WorkerPool& pool)
+{
+	int resolutionBits = 0;
+	while ((1 << resolutionBits) < resolution && resolutionBits < curveBits)
+	{
+		resolutionBits++;
+	}
+	resolution = 1 << resolutionBits;
+
+	index.Order = order;
+	index.Resolution = resolution;
+	index.ParticleCount = numParticles;
+	index.CellFirst.assign(size_t(resolution) * resolution * resolution, 0);
+	index.CellCount.assign(index.CellFirst.size(), 0);
+
+	// bounds of the finite positions, per chunk on the pool
+	std::vector<Bounds> chunkBounds((numParticles + keyChunkSize - 1) / keyChunkSize);
+	std::vector< std::function<void()> > tasks;
+	for (size_t c=0; c < chunkBounds.size(); c++)
+	{
+		int begin = int(c) * keyChunkSize;
+		tasks.push_back(std::bind(&ComputeBounds, positions, stride, begin, std::min(begin + keyChunkSize, numParticles), &chunkBounds[c]));
+	}
+	pool.Run(tasks);
+
+	Bounds bounds;
+	for (size_t c=0; c < chunkBounds.size(); c++)
+	{
+		bounds.Add(chunkBounds[c]);
+	}
+	if (!bounds.Valid)
+	{
+		std::fill(bounds.Min, bounds.Min + 3, 0.0f);
+		std::fill(bounds.Max, bounds.Max + 3, 0.0f);
+	}
+	std::copy(bounds.Min, bounds.Min + 3, index.Min);
+	std::copy(bounds.Max, bounds.Max + 3, index.Max);
+
+	std::vector<unsigned long long> keys(numParticles);
+	std::vector<unsigned int> cells(numParticles);
+
+	KeyJob job;
+	job.Positions = positions;
+	job.Stride = stride;
+	job.Order = order;
+	job.CellShift = curveBits - resolutionBits;
+	job.Resolution = resolution;
+	job.Keys = keys.empty() ? NULL : &keys[0];
+	job.Cells = cells.empty() ? NULL : &cells[0];
+	for (int a=0; a < 3; a++)
+	{
+		float extent = bounds.Max[a] - bounds.Min[a];
+		job.Min[a] = bounds.Min[a];
+		job.Scale[a] = extent > 0.0f ? float(1 << curveBits) / extent : 0.0f;
+	}
+
+	tasks.clear();
+	for (int begin=0; begin < numParticles; begin += keyChunkSize)
+	{
+		tasks.push_back(std::bind(&ComputeKeys, &job, begin, std::min(begin + keyChunkSize, numParticles)));
+	}
+	pool.Run(tasks);
+
+	RadixSortKeys(keys);
+
+	// every cell is one run of the sorted particles
+	permutation.resize(numParticles);
+	for (int i=0; i < numParticles; i++)
+	{
+		unsigned int original = (unsigned int)keys[i];
+		permutation[i] = original;
+		unsigned int cell = cells[original];
+		if (index.CellCount[cell]++ == 0)
+			index.CellFirst[cell] = (unsigned int)i;
+	}
+}
+
+std::string WriteSpatialIndex(const std::string& fileName, const SpatialIndex& index)
+{
+	std::vector<unsigned char> data;
+	const char magic[8] = { 'P', 'X', 'S', 'I', 'D', 'X', '1', 0 };
+	data.insert(data.end(), magic, magic + 8);
+	WriteInt32(data, index.Order == SpatialOrderHilbert ? 2 : 1);
+	WriteInt32(data, index.Resolution);
+	WriteInt32(data, index.ParticleCount);
+	for (int a=0; a < 3; a++)
+	{
+		WriteFloat32(data, index.Min[a]);
+	}
+	for (int a=0; a < 3; a++)
+	{
+		WriteFloat32(data, index.Max[a]);
+	}
+	for (size_t c=0; c < index.CellFirst.size(); c++)
+	{
+		WriteInt32(data, index.CellFirst[c]);
+		WriteInt32(data, index.CellCount[c]);
+	}
+
+	FILE* file = fopen(fileName.c_str(), "wb");
+	if (file == NULL)
+		return "Failed to open file for writing: " + fileName;
+
+	bool ok = fwrite(&data[0], 1, data.size(), file) == data.size();
+	ok = fclose(file) == 0 && ok;
+	if (!ok)
+		return "Failed to write spatial index: " + fileName;
+	return std::string();
+}
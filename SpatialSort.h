@@ -0,0 +1,79 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by James Vecore
+// james.vecore@gmail.com
+
+
+#ifndef PARTIO_EXPORT_SPATIAL_SORT_H
+#define PARTIO_EXPORT_SPATIAL_SORT_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+class WorkerPool;
+
+enum SpatialOrder
+{
+	SpatialOrderNone,
+	SpatialOrderMorton,
+	SpatialOrderHilbert
+};
+
+// Bounding box and coarse grid of a spatially sorted particle set. The box is split into Resolution cells per axis,
+// along either curve the particles of a cell are stored next to each other so every cell is a single range.
+struct SpatialIndex
+{
+	SpatialIndex() : Order(SpatialOrderNone), Resolution(0), ParticleCount(0) {}
+
+	SpatialOrder Order;
+	int Resolution;
+	int ParticleCount;
+	float Min[3];
+	float Max[3];
+	std::vector<unsigned int> CellFirst; // per cell, indexed x + y*Resolution + z*Resolution*Resolution
+	std::vector<unsigned int> CellCount;
+};
+
+// Orders particles along a Morton (Z-order) or Hilbert curve through their bounding box. Positions are 3 floats every
+// stride bytes, the curve is 10 bits per axis. Fills permutation with the original index of each sorted particle and
+// index with the bounds and the cell ranges for a grid of resolution cells per axis (a power of two up to 1024).
+// Key computation runs on the pool, the sort itself is a radix sort.
+void ComputeSpatialOrder(const char* positions, size_t stride, int numParticles, SpatialOrder order, int resolution, std::vector<unsigned int>& permutation, SpatialIndex& index, WorkerPool& pool);
+
+// Writes index as a small binary sidecar, all values little endian:
+//
+//   char[8]  "PXSIDX1" and a 0 byte
+//   int32    curve, 1 Morton 2 Hilbert
+//   int32    cells per axis
+//   int32    particle count
+//   float32  bounding box min x, y, z and max x, y, z
+//   uint32   first particle and particle count of every cell, cell x + y*n + z*n*n
+//
+// On each axis a point is in cell q / (1024 / n) with q = min(1023, floor((p - min) * (1024 / (max - min)))) in 32 bit
+// floats (0 on axes where the box is flat), which is floor((p - min) / (max - min) * n) up to rounding right at cell
+// borders. Points that aren't finite are in cell 0.
+// Returns an empty string on success, otherwise an error message.
+std::string WriteSpatialIndex(const std::string& fileName, const SpatialIndex& index);
+
+#endif
@@ -0,0 +1,325 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 James Vecore
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by James Vecore
+// james.vecore@gmail.com
+
+
+
+// Checks per point array exports: WriteArrayFile's sidecar read back by hand (header, values, empty arrays, a constant
+// table), arrays=indexed exports whose offsets and counts give back every particle's elements (sorted too, where the
+// offsets move with their particles), and arrays=fixed exports padded with zeros and cut to arraysize.
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstring>
+
+#include <Partio.h>
+
+#include "ArrayFile.h"
+#include "ParticleExporter.h"
+#include "MemoryParticleSource.h"
+#include "WriteQueue.h"
+#include "Test.h"
+
+namespace
+{
+	const int particleCount = 500;
+
+	struct ArrayFile
+	{
+		ArrayFile() : Valid(false), Float(false), Components(0), ElementCount(0) {}
+
+		bool Valid;
+		bool Float;
+		int Components;
+		int ElementCount;
+		std::vector<unsigned int> Values; // int values, or the bits of float ones
+	};
+
+	ArrayFile ReadArrayFile(const std::string& fileName)
+	{
+		ArrayFile arrays;
+		std::ifstream file(fileName.c_str(), std::ios::binary);
+		std::ostringstream ss;
+		ss << file.rdbuf();
+		const std::string data = ss.str();
+		if (data.size() < 20 || memcmp(data.data(), "PXSARR1\0", 8) != 0)
+			return arrays;
+
+		int header[3];
+		memcpy(header, data.data() + 8, sizeof(header));
+		arrays.Float = header[0] == 1;
+		arrays.Components = header[1];
+		arrays.ElementCount = header[2];
+		const size_t valueCount = size_t(arrays.ElementCount) * arrays.Components;
+		if (data.size() != 20 + valueCount * 4)
+			return arrays;
+		arrays.Values.resize(valueCount);
+		if (valueCount != 0)
+			memcpy(&arrays.Values[0], data.data() + 20, valueCount * 4);
+		arrays.Valid = (header[0] == 0 || header[0] == 1);
+		return arrays;
+	}
+
+	unsigned int FloatBits(float value)
+	{
+		unsigned int bits;
+		memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+
+	void CheckWriteArrayFile()
+	{
+		// elements out of order and shared between particles, empty arrays in between (one pointing past the values)
+		const int values[] = { 10, 11, 12, 13, 14, 15 };
+		const unsigned int first[] = { 2, 0, 100, 1 };
+		const unsigned int counts[] = { 3, 0, 0, 2 };
+		ParticleDataArray data;
+		data.Data = values;
+		data.Stride = sizeof(int);
+		data.Components = 1;
+		data.Int = true;
+		data.ArrayFirst = first;
+		data.ArrayCounts = counts;
+
+		const std::string fileName = "ArrayFileTest.arr";
+		CHECK(WriteArrayFile(fileName, data, 4).empty());
+		ArrayFile arrays = ReadArrayFile(fileName);
+		CHECK(arrays.Valid && !arrays.Float && arrays.Components == 1);
+		CHECK_MSG(arrays.ElementCount == 5, arrays.ElementCount); // up to the end of the last array used
+		for (int i=0; i < arrays.ElementCount && arrays.Valid; i++)
+			CHECK(arrays.Values[i] == (unsigned int)values[i]);
+
+		// every array empty
+		const unsigned int zeros[] = { 0, 0, 0, 0 };
+		data.ArrayFirst = zeros;
+		data.ArrayCounts = zeros;
+		CHECK(WriteArrayFile(fileName, data, 4).empty());
+		arrays = ReadArrayFile(fileName);
+		CHECK(arrays.Valid && arrays.ElementCount == 0 && arrays.Values.empty());
+
+		// no particles
+		CHECK(WriteArrayFile(fileName, data, 0).empty());
+		arrays = ReadArrayFile(fileName);
+		CHECK(arrays.Valid && arrays.ElementCount == 0);
+
+		// a constant attribute has one table entry for all particles, float vectors
+		const float vectors[] = { 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f };
+		const unsigned int constantFirst[] = { 0 };
+		const unsigned int constantCount[] = { 2 };
+		data.Data = vectors;
+		data.Stride = 0;
+		data.Components = 3;
+		data.Int = false;
+		data.ArrayFirst = constantFirst;
+		data.ArrayCounts = constantCount;
+		CHECK(WriteArrayFile(fileName, data, 100).empty());
+		arrays = ReadArrayFile(fileName);
+		CHECK(arrays.Valid && arrays.Float && arrays.Components == 3 && arrays.ElementCount == 2);
+		for (int i=0; i < 6 && arrays.Valid && arrays.Values.size() == 6; i++)
+			CHECK(arrays.Values[i] == FloatBits(vectors[i]));
+		remove(fileName.c_str());
+
+		CHECK(GetArrayFileName("/out/sim.0001.prt", "Neighbors") == "/out/sim.0001.prt.Neighbors.arr");
+	}
+
+	// per particle: its array length, some empty and some longer than arraysize. Exports with another seed change the
+	// lengths, so a reused particle set has old elements where the new ones need padding.
+	unsigned int ElementCount(int particle, int seed)
+	{
+		return (unsigned int)((particle * 7 + seed) % 11);
+	}
+
+	int IntElement(int id, unsigned int element)
+	{
+		return id * 100 + (int)element;
+	}
+
+	float FloatElement(int id, unsigned int element, int component)
+	{
+		return (float)id + (float)element * 0.125f + (float)component * 0.001f;
+	}
+
+	void AddArrays(MemoryParticleSource& source, int seed)
+	{
+		std::vector<float> position(particleCount * 3);
+		std::vector<int> ids(particleCount);
+		std::vector<unsigned int> counts(particleCount);
+		std::vector<int> neighbors;
+		std::vector<float> offsets;
+		for (int i=0; i < particleCount; i++)
+		{
+			position[i*3 + 0] = (float)((i * 37) % 101);
+			position[i*3 + 1] = (float)((i * 13) % 53);
+			position[i*3 + 2] = (float)(i % 7);
+			ids[i] = i;
+			counts[i] = ElementCount(i, seed);
+			for (unsigned int e=0; e < counts[i]; e++)
+			{
+				neighbors.push_back(IntElement(i, e));
+				for (int c=0; c < 3; c++)
+					offsets.push_back(FloatElement(i, e, c));
+			}
+		}
+		source.AddAttribute("PointPosition", ParticleDataVector3, position);
+		source.AddAttribute("ID", ParticleDataLong, ids);
+		source.AddAttribute("Neighbors", ParticleDataLong, neighbors).SetArrayCounts(counts);
+		source.AddAttribute("Offsets", ParticleDataVector3, offsets).SetArrayCounts(counts);
+	}
+
+	Partio::ParticlesDataMutable* Export(const std::string& optionText, int seed, const std::string& fileName)
+	{
+		MemoryParticleSource source("arrays", particleCount);
+		AddArrays(source, seed);
+
+		ExportFormatFamily family;
+		GetExportFormatFamily("prt", family);
+		StreamExportLog log(std::cerr, ExportLogWarning);
+		ExportOptions options;
+		ParseExportOptions(optionText, options);
+		CHECK(ExportParticles(source, GetExportFormat(family), options, fileName, log));
+		WriteQueue::Shared().Flush();
+		CHECK(!LogWriteErrors(log));
+
+		Partio::ParticlesDataMutable* read = Partio::read(fileName.c_str());
+		CHECK_MSG(read != NULL && read->numParticles() == particleCount, optionText);
+		remove(fileName.c_str());
+		remove((fileName + ".idx").c_str());
+		if (read != NULL && read->numParticles() != particleCount)
+		{
+			read->release();
+			return NULL;
+		}
+		return read;
+	}
+
+	void CheckIndexed(const std::string& optionText, int seed)
+	{
+		const std::string fileName = "ArrayFileTest.prt";
+		Partio::ParticlesDataMutable* read = Export(optionText, seed, fileName);
+		const ArrayFile neighbors = ReadArrayFile(GetArrayFileName(fileName, "Neighbors"));
+		const ArrayFile offsets = ReadArrayFile(GetArrayFileName(fileName, "Offsets"));
+		remove(GetArrayFileName(fileName, "Neighbors").c_str());
+		remove(GetArrayFileName(fileName, "Offsets").c_str());
+		if (read == NULL)
+			return;
+
+		CHECK(neighbors.Valid && !neighbors.Float && neighbors.Components == 1);
+		CHECK(offsets.Valid && offsets.Float && offsets.Components == 3);
+
+		// offsets and counts instead of the values
+		Partio::ParticleAttribute id, neighborOffset, neighborCount, offsetOffset, offsetCount, values;
+		const bool hasChannels = read->attributeInfo("ID", id) && read->attributeInfo("NeighborsOffset", neighborOffset) && read->attributeInfo("NeighborsCount", neighborCount)
+			&& read->attributeInfo("OffsetsOffset", offsetOffset) && read->attributeInfo("OffsetsCount", offsetCount);
+		CHECK_MSG(hasChannels, optionText);
+		CHECK(!read->attributeInfo("Neighbors", values) && !read->attributeInfo("Offsets", values));
+		if (hasChannels && neighbors.Valid && offsets.Valid)
+		{
+			int wrong = 0;
+			for (int p=0; p < particleCount; p++)
+			{
+				const int particle = read->data<int>(id, p)[0];
+				const unsigned int count = (unsigned int)read->data<int>(neighborCount, p)[0];
+				const unsigned int first = (unsigned int)read->data<int>(neighborOffset, p)[0];
+				const unsigned int vectorFirst = (unsigned int)read->data<int>(offsetOffset, p)[0];
+				if (particle < 0 || particle >= particleCount || count != ElementCount(particle, seed) || (unsigned int)read->data<int>(offsetCount, p)[0] != count)
+				{
+					wrong++;
+					continue;
+				}
+				if (size_t(first) + count > (size_t)neighbors.ElementCount || size_t(vectorFirst) + count > (size_t)offsets.ElementCount)
+				{
+					wrong++;
+					continue;
+				}
+				for (unsigned int e=0; e < count; e++)
+				{
+					wrong += neighbors.Values[first + e] != (unsigned int)IntElement(particle, e);
+					for (int c=0; c < 3; c++)
+						wrong += offsets.Values[(vectorFirst + e) * 3 + c] != FloatBits(FloatElement(particle, e, c));
+				}
+			}
+			CHECK_MSG(wrong == 0, optionText << ": " << wrong << " wrong offsets, counts or elements");
+		}
+		read->release();
+	}
+
+	void CheckFixed(const std::string& optionText, int seed, unsigned int arraySize)
+	{
+		Partio::ParticlesDataMutable* read = Export(optionText, seed, "ArrayFileTest.prt");
+		if (read == NULL)
+			return;
+
+		Partio::ParticleAttribute id, neighbors, neighborCount, offsets, offsetCount;
+		const bool hasChannels = read->attributeInfo("ID", id) && read->attributeInfo("Neighbors", neighbors) && read->attributeInfo("NeighborsCount", neighborCount)
+			&& read->attributeInfo("Offsets", offsets) && read->attributeInfo("OffsetsCount", offsetCount);
+		CHECK_MSG(hasChannels, optionText);
+		CHECK(!hasChannels || (neighbors.type == Partio::INT && neighbors.count == (int)arraySize));
+		CHECK(!hasChannels || (offsets.type != Partio::INT && offsets.count == 3 * (int)arraySize)); // partio reads 3 floats as a vector
+		if (hasChannels && neighbors.count == (int)arraySize && offsets.count == 3 * (int)arraySize)
+		{
+			int wrong = 0;
+			int truncated = 0;
+			for (int p=0; p < particleCount; p++)
+			{
+				const int particle = read->data<int>(id, p)[0];
+				const unsigned int count = std::min(ElementCount(particle, seed), arraySize);
+				truncated += ElementCount(particle, seed) > arraySize;
+				wrong += (unsigned int)read->data<int>(neighborCount, p)[0] != count;
+				wrong += (unsigned int)read->data<int>(offsetCount, p)[0] != count;
+
+				// the elements that fit, then zeros
+				const int* neighborValues = read->data<int>(neighbors, p);
+				const float* offsetValues = read->data<float>(offsets, p);
+				for (unsigned int e=0; e < arraySize; e++)
+				{
+					wrong += neighborValues[e] != (e < count ? IntElement(particle, e) : 0);
+					for (int c=0; c < 3; c++)
+						wrong += FloatBits(offsetValues[e*3 + c]) != (e < count ? FloatBits(FloatElement(particle, e, c)) : 0u);
+				}
+			}
+			CHECK_MSG(wrong == 0, optionText << ": " << wrong << " wrong counts or elements");
+			CHECK(truncated > 0 || arraySize >= 10);
+		}
+		read->release();
+	}
+}
+
+int main()
+{
+	CheckWriteArrayFile();
+	CheckIndexed("arrays=indexed,level=1", 0);
+	CheckIndexed("arrays=indexed,level=1,sort=hilbert", 3);
+	CheckFixed("arrays=fixed,arraysize=4,level=1", 0, 4);
+	CheckFixed("arrays=fixed,arraysize=4,level=1", 5, 4);
+	CheckFixed("arrays=fixed,arraysize=1,level=1,sort=morton", 0, 1);
+	CheckFixed("arrays=fixed,arraysize=16,level=0", 0, 16);
+	CheckFixed("arrays=fixed,arraysize=16,level=0", 7, 16);
+
+	StreamExportLog log(std::cerr, ExportLogWarning);
+	ShutdownExporter(log);
+	return TestResult();
+}
@@ -0,0 +1,152 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by James Vecore
+// james.vecore@gmail.com
+// Checks the bulk copy kernels against a plain per particle copy, for every particle count up to a few groups of the
+// SIMD paths and a few odd larger ones, and that nothing before or after the destination range is written.
+
+#include <vector>
+#include <cstring>
+
+#include "ConvertKernels.h"
+#include "Test.h"
+
+namespace
+{
+	// written around every destination range, a kernel that spills past the range changes them
+	const float guard = -12345.0f;
+	const int guardFloats = 8;
+
+	std::vector<float> MakeSource(int particles, int components)
+	{
+		std::vector<float> values(size_t(particles) * components + 1);
+		for (size_t i=0; i < values.size(); i++)
+		{
+			values[i] = (float)i + 0.25f;
+		}
+		return values;
+	}
+
+	// the particles [0, count) of a buffer with dstStride bytes per particle, plus guards on both sides
+	struct Destination
+	{
+		Destination(int count, size_t dstStride) : Values(guardFloats*2 + count * dstStride / sizeof(float), guard) {}
+
+		float* Data() { return &Values[guardFloats]; }
+
+		bool GuardsIntact(int count, size_t dstStride) const
+		{
+			const size_t end = guardFloats + count * dstStride / sizeof(float);
+			for (int i=0; i < guardFloats; i++)
+			{
+				if (Values[i] != guard || Values[end + i] != guard)
+					return false;
+			}
+			return true;
+		}
+
+		std::vector<float> Values;
+	};
+
+	void CheckFloatsBulk(int count, int srcCount, size_t srcStride, int dstCount, size_t dstStride)
+	{
+		const std::vector<float> src = MakeSource(srcStride == 0 ? 1 : count, (int)(srcStride == 0 ? srcCount : srcStride / sizeof(float)));
+		Destination bulk(count, dstStride);
+		Destination expected(count, dstStride);
+
+		CopyFloatsBulk(&src[0], srcStride, srcCount, bulk.Data(), dstStride, dstCount, count);
+		for (int i=0; i < count; i++)
+		{
+			memcpy((char*)expected.Data() + i*dstStride, (const char*)&src[0] + i*srcStride, dstCount * sizeof(float));
+		}
+
+		CHECK_MSG(bulk.Values == expected.Values, count << " particles, " << srcCount << " -> " << dstCount << " floats");
+		CHECK_MSG(bulk.GuardsIntact(count, dstStride), count << " particles, " << srcCount << " -> " << dstCount << " floats");
+	}
+
+	void CheckQuaternionsWXYZ(int count, size_t srcStride, size_t dstStride)
+	{
+		const std::vector<float> src = MakeSource(count, (int)(srcStride / sizeof(float)));
+		Destination dst(count, dstStride);
+
+		CopyQuaternionsWXYZ(&src[0], srcStride, dst.Data(), dstStride, count);
+		for (int i=0; i < count; i++)
+		{
+			const float* q = (const float*)((const char*)&src[0] + i*srcStride);
+			const float* out = (const float*)((const char*)dst.Data() + i*dstStride);
+			CHECK_MSG(out[0] == q[1] && out[1] == q[2] && out[2] == q[3] && out[3] == q[0], "particle " << i << " of " << count);
+		}
+		CHECK_MSG(dst.GuardsIntact(count, dstStride), count << " quaternions");
+	}
+
+	void CheckStrided(int count, size_t srcStride, size_t dstStride, size_t elementSize)
+	{
+		const std::vector<float> src = MakeSource(count, (int)(srcStride / sizeof(float)));
+		Destination dst(count, dstStride);
+
+		CopyStrided((const char*)&src[0], srcStride, (char*)dst.Data(), dstStride, elementSize, count);
+		for (int i=0; i < count; i++)
+		{
+			CHECK_MSG(memcmp((const char*)dst.Data() + i*dstStride, (const char*)&src[0] + i*srcStride, elementSize) == 0, "particle " << i << " of " << count);
+		}
+		CHECK_MSG(dst.GuardsIntact(count, dstStride), count << " elements");
+	}
+}
+
+int main()
+{
+	std::vector<int> counts;
+	for (int i=0; i <= 37; i++)
+	{
+		counts.push_back(i);
+	}
+	counts.push_back(1001);
+	counts.push_back(4099);
+	counts.push_back(65537);
+
+	for (size_t c=0; c < counts.size(); c++)
+	{
+		const int count = counts[c];
+
+		// Color4f -> float3, the SIMD path
+		CheckFloatsBulk(count, 4, 16, 3, 12);
+		// the memcpy path and narrowing into wider and interleaved destinations
+		CheckFloatsBulk(count, 3, 12, 3, 12);
+		CheckFloatsBulk(count, 4, 16, 4, 16);
+		CheckFloatsBulk(count, 4, 16, 2, 8);
+		CheckFloatsBulk(count, 4, 16, 3, 20);
+		CheckFloatsBulk(count, 3, 16, 3, 12);
+		// one value shared by all particles
+		CheckFloatsBulk(count, 4, 0, 3, 12);
+		CheckFloatsBulk(count, 3, 0, 3, 12);
+
+		CheckQuaternionsWXYZ(count, 16, 16);
+		CheckQuaternionsWXYZ(count, 16, 28);
+
+		CheckStrided(count, 12, 12, 12);
+		CheckStrided(count, 16, 12, 12);
+		CheckStrided(count, 4, 24, 4);
+	}
+
+	return TestResult();
+}
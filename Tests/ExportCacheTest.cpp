@@ -0,0 +1,216 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 James Vecore
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by James Vecore
+// james.vecore@gmail.com
+
+
+
+// Exports the same cloud several times with skip=on, sort=morton and arrays=indexed. The second export has to be
+// skipped, and deleting or overwriting the .idx or .arr file next to the PRT file has to get the file and its sidecars
+// written again instead of being skipped, as does rewriting the PRT file with the same size within the same second.
+// The index is only saved once per batch and run, and a new cache (after ShutdownExporter) reads it back.
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <algorithm>
+
+#include "ParticleExporter.h"
+#include "MemoryParticleSource.h"
+#include "WriteQueue.h"
+#include "Test.h"
+
+namespace
+{
+	const int particleCount = 5000;
+
+	// counts the "Skipping unchanged file" messages
+	class SkipLog : public ExportLog
+	{
+	public:
+		SkipLog() : Skipped(0), Errors(0) {}
+
+		virtual void Log(const std::string& message, ExportLogSeverity severity)
+		{
+			if (message.compare(0, 9, "Skipping ") == 0)
+				Skipped++;
+			if (severity == ExportLogError)
+			{
+				std::cerr << message << std::endl;
+				Errors++;
+			}
+		}
+
+		int Skipped;
+		int Errors;
+	};
+
+	bool FileExists(const std::string& fileName)
+	{
+		FILE* file = fopen(fileName.c_str(), "rb");
+		if (file == NULL)
+			return false;
+		fclose(file);
+		return true;
+	}
+
+	std::string ReadFile(const std::string& fileName)
+	{
+		std::string data;
+		FILE* file = fopen(fileName.c_str(), "rb");
+		if (file == NULL)
+			return data;
+		char buffer[4096];
+		size_t read;
+		while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+			data.append(buffer, read);
+		fclose(file);
+		return data;
+	}
+
+	void WriteFile(const std::string& fileName, const std::string& data)
+	{
+		FILE* file = fopen(fileName.c_str(), "wb");
+		if (file != NULL)
+		{
+			fwrite(data.data(), 1, data.size(), file);
+			fclose(file);
+		}
+	}
+
+	void OverwriteFile(const std::string& fileName)
+	{
+		FILE* file = fopen(fileName.c_str(), "wb");
+		if (file != NULL)
+		{
+			fputs("not the file that was exported", file);
+			fclose(file);
+		}
+	}
+
+	// exports the cloud and waits for the write, returns the number of files that were skipped
+	int Export(MemoryParticleSource& source, const ExportOptions& options, const std::string& fileName)
+	{
+		ExportFormatFamily family;
+		GetExportFormatFamily("prt", family);
+
+		SkipLog log;
+		CHECK(ExportParticles(source, GetExportFormat(family), options, fileName, log));
+		WriteQueue::Shared().Flush();
+		CHECK(!LogWriteErrors(log));
+		CHECK(log.Errors == 0);
+		return log.Skipped;
+	}
+}
+
+int main()
+{
+	std::vector<float> position(particleCount * 3);
+	std::vector<int> ids(particleCount);
+	std::vector<unsigned int> neighborCounts(particleCount);
+	std::vector<int> neighbors;
+	for (int i=0; i < particleCount; i++)
+	{
+		position[i*3 + 0] = (float)(i % 17);
+		position[i*3 + 1] = (float)(i % 31) * 0.5f;
+		position[i*3 + 2] = (float)(i % 7) * 2.0f;
+		ids[i] = i;
+		neighborCounts[i] = i % 4;
+		for (int n=0; n < i % 4; n++)
+			neighbors.push_back((i + n + 1) % particleCount);
+	}
+
+	MemoryParticleSource source("cache", particleCount);
+	source.AddAttribute("PointPosition", ParticleDataVector3, position);
+	source.AddAttribute("ID", ParticleDataLong, ids);
+	source.AddAttribute("Neighbors", ParticleDataLong, neighbors).SetArrayCounts(neighborCounts);
+
+	ExportOptions options;
+	ParseExportOptions("skip=on,sort=morton,arrays=indexed,level=1", options);
+
+	const std::string fileName = "ExportCacheTest.prt";
+	const std::string indexFileName = fileName + ".idx";
+	const std::string arrayFileName = fileName + ".Neighbors.arr";
+	const char* sidecars[] = { indexFileName.c_str(), arrayFileName.c_str() };
+	const std::string cacheFileName = ".partio_export_cache";
+	remove(cacheFileName.c_str());
+
+	CHECK(Export(source, options, fileName) == 0);
+	CHECK(FileExists(fileName));
+	CHECK(FileExists(indexFileName));
+	CHECK(FileExists(arrayFileName));
+
+	// the file was stored after its batch, the index waits for the next batch or the end of the run
+	CHECK(!FileExists(cacheFileName));
+
+	CHECK(Export(source, options, fileName) == 1);
+
+	for (int i=0; i < 2; i++)
+	{
+		remove(sidecars[i]);
+		CHECK_MSG(Export(source, options, fileName) == 0, "deleted " << sidecars[i]);
+		CHECK_MSG(FileExists(sidecars[i]), "deleted " << sidecars[i]);
+		CHECK_MSG(Export(source, options, fileName) == 1, "deleted " << sidecars[i]);
+
+		OverwriteFile(sidecars[i]);
+		CHECK_MSG(Export(source, options, fileName) == 0, "overwrote " << sidecars[i]);
+		CHECK_MSG(Export(source, options, fileName) == 1, "overwrote " << sidecars[i]);
+	}
+
+	// the PRT file itself was checked before sidecars were
+	remove(fileName.c_str());
+	CHECK(Export(source, options, fileName) == 0);
+	CHECK(FileExists(fileName));
+
+	// the same bytes written again: same size, and almost always the same second
+	WriteFile(fileName, ReadFile(fileName));
+	CHECK(Export(source, options, fileName) == 0);
+	CHECK(Export(source, options, fileName) == 1);
+
+	// the index of the run, one line each for the file and its sidecars
+	SkipLog log;
+	CHECK(FinishExportRun(log));
+	const std::string index = ReadFile(cacheFileName);
+	CHECK_MSG(index.compare(0, 24, "# partio export cache 2\n") == 0, index);
+	CHECK_MSG(std::count(index.begin(), index.end(), '\n') == 4, index);
+	CHECK(index.find(" ExportCacheTest.prt\n") != std::string::npos);
+	CHECK(index.find(" ExportCacheTest.prt.idx\n") != std::string::npos);
+	CHECK(index.find(" ExportCacheTest.prt.Neighbors.arr\n") != std::string::npos);
+
+	// a new cache loads it
+	ShutdownExporter(log);
+	CHECK(Export(source, options, fileName) == 1);
+
+	// an index of the old version (times in seconds) is ignored
+	WriteFile(cacheFileName, "# partio export cache 1\n" + index.substr(24));
+	ShutdownExporter(log);
+	CHECK(Export(source, options, fileName) == 0);
+
+	ShutdownExporter(log);
+	remove(fileName.c_str());
+	remove(indexFileName.c_str());
+	remove(arrayFileName.c_str());
+	remove(cacheFileName.c_str());
+
+	return TestResult();
+}
@@ -0,0 +1,126 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 James Vecore
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by James Vecore
+// james.vecore@gmail.com
+
+
+
+// Checks filter expressions on int attributes past 2^24, where floats can't hold every integer any more, against the
+// same test done with ints, and that fractional constants still match float attributes exactly.
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <climits>
+
+#include "ExportExpression.h"
+#include "MemoryParticleSource.h"
+#include "Test.h"
+
+namespace
+{
+	// the particles the filter selects, over all of source's attributes
+	std::vector<unsigned int> Select(MemoryParticleSource& source, const std::string& text)
+	{
+		std::vector<unsigned int> selection;
+		ExportExpression expression;
+		std::string error = expression.Compile(text, source);
+		CHECK_MSG(error.empty(), text << ": " << error);
+		if (!error.empty())
+			return selection;
+
+		std::vector<ParticleDataArray> inputs(expression.GetAttributes().size());
+		for (size_t i=0; i < inputs.size(); i++)
+			source.GetAttribute(expression.GetAttributes()[i]).GetData(inputs[i]);
+		expression.Select(inputs, 0, source.GetParticleCount(), selection);
+		return selection;
+	}
+}
+
+int main()
+{
+	// IDs around 2^24 and up to INT_MAX, and negative ones
+	std::vector<int> ids;
+	for (int i=0; i < 1000; i++)
+	{
+		ids.push_back((1 << 24) - 500 + i);
+		ids.push_back(INT_MAX - i);
+		ids.push_back(INT_MIN + i);
+		ids.push_back(123456789 + i * 7);
+	}
+	const int particleCount = (int)ids.size();
+
+	std::vector<float> ages(particleCount);
+	for (int i=0; i < particleCount; i++)
+		ages[i] = (i % 10) * 0.1f;
+
+	MemoryParticleSource source("expression", particleCount);
+	source.AddAttribute("ID", ParticleDataLong, ids);
+	source.AddAttribute("Age", ParticleDataFloat, ages);
+
+	for (int divisor=2; divisor <= 7; divisor++)
+	{
+		for (int remainder=0; remainder < divisor; remainder++)
+		{
+			std::vector<unsigned int> expected;
+			for (int i=0; i < particleCount; i++)
+			{
+				if (ids[i] % divisor == remainder || ids[i] % divisor == -remainder)
+					expected.push_back(i);
+			}
+
+			std::ostringstream text;
+			text << "abs(ID % " << divisor << ") == " << remainder;
+			CHECK_MSG(Select(source, text.str()) == expected, text.str());
+		}
+	}
+
+	std::vector<unsigned int> expected;
+	for (int i=0; i < particleCount; i++)
+	{
+		if (ids[i] == (1 << 24) + 1)
+			expected.push_back(i);
+	}
+	CHECK(expected.size() == 1);
+	CHECK(Select(source, "ID == 16777217") == expected);
+
+	expected.clear();
+	for (int i=0; i < particleCount; i++)
+	{
+		if (ids[i] > 2147483000)
+			expected.push_back(i);
+	}
+	CHECK(Select(source, "ID > 2147483000") == expected);
+
+	// Age holds floats, 0.3 has to be rounded the same way to match
+	expected.clear();
+	for (int i=0; i < particleCount; i++)
+	{
+		if (ages[i] == 0.3f)
+			expected.push_back(i);
+	}
+	CHECK(!expected.empty());
+	CHECK(Select(source, "Age == 0.3") == expected);
+
+	return TestResult();
+}
@@ -0,0 +1,204 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 James Vecore
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by James Vecore
+// james.vecore@gmail.com
+
+
+
+// Checks the half conversions: FloatToHalf and HalfToFloat against a plain reference (rounding done in double with
+// nearbyint, which rounds ties to even) for all 2^16 halves, the ties and their neighbours between every pair of
+// halves, subnormals, infinities, NaN payloads and values from 65504 up. The array versions, which use F16C when the
+// cpu has it, have to give the same bits as the scalar functions for every length around multiples of 8.
+
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <cfloat>
+
+#include "HalfFloat.h"
+#include "Test.h"
+
+namespace
+{
+	unsigned int FloatBits(float value)
+	{
+		unsigned int bits;
+		memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+
+	float BitsToFloat(unsigned int bits)
+	{
+		float value;
+		memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	unsigned short ReferenceFloatToHalf(float value)
+	{
+		const unsigned int bits = FloatBits(value);
+		const unsigned short sign = (unsigned short)((bits >> 16) & 0x8000u);
+		if (value != value) // quiet, keeps the top of the payload
+			return (unsigned short)(sign | 0x7e00u | ((bits >> 13) & 0x3ffu));
+
+		const double magnitude = fabs((double)value);
+		if (magnitude < ldexp(1.0, -14))
+			return (unsigned short)(sign | (unsigned short)nearbyint(magnitude * ldexp(1.0, 24))); // 1024 is the smallest normal
+
+		if (std::isinf(magnitude))
+			return (unsigned short)(sign | 0x7c00u);
+		int exponent = ilogb(magnitude);
+		double mantissa = nearbyint(ldexp(magnitude, 10 - exponent));
+		if (mantissa == 2048.0)
+		{
+			mantissa = 1024.0;
+			exponent++;
+		}
+		if (exponent > 15)
+			return (unsigned short)(sign | 0x7c00u);
+		return (unsigned short)(sign | ((exponent + 15) << 10) | ((unsigned int)mantissa - 1024));
+	}
+
+	// NaNs come out quiet
+	unsigned int ReferenceHalfToFloat(unsigned short half)
+	{
+		const unsigned int sign = (unsigned int)(half & 0x8000u) << 16;
+		const int exponent = (half >> 10) & 0x1f;
+		const unsigned int mantissa = half & 0x3ffu;
+		if (exponent == 0x1f)
+			return sign | 0x7f800000u | (mantissa << 13) | (mantissa != 0 ? 0x400000u : 0);
+		const double magnitude = exponent == 0 ? ldexp((double)mantissa, -24) : ldexp((double)(mantissa | 0x400u), exponent - 25);
+		return sign | FloatBits((float)magnitude);
+	}
+
+	void AddWithNeighbours(std::vector<float>& values, float value)
+	{
+		const unsigned int bits = FloatBits(value);
+		values.push_back(value);
+		values.push_back(BitsToFloat(bits + 1));
+		if ((bits & 0x7fffffffu) != 0)
+			values.push_back(BitsToFloat(bits - 1));
+	}
+
+	std::vector<float> MakeInputs()
+	{
+		std::vector<float> values;
+		for (unsigned int h=0; h < 0x10000u; h++)
+		{
+			const float value = HalfToFloat((unsigned short)h);
+			values.push_back(value);
+
+			// the tie with the next half up (and its neighbours), both signs
+			if ((h & 0x7fffu) < 0x7bffu)
+			{
+				const double tie = ((double)value + (double)HalfToFloat((unsigned short)(h + 1))) * 0.5;
+				AddWithNeighbours(values, (float)tie);
+			}
+		}
+
+		// float subnormals, the bottom of the half subnormals, and the overflow boundary (65520 rounds to inf)
+		const float edges[] = { FLT_MIN, FLT_MIN * 0.5f, 1e-40f, BitsToFloat(1), 5.9604645e-8f, 2.9802322e-8f, 65504.0f, 65519.0f,
+			65519.996f, 65520.0f, 65535.0f, 65536.0f, 1e10f, FLT_MAX, INFINITY };
+		for (size_t i=0; i < sizeof(edges) / sizeof(edges[0]); i++)
+		{
+			AddWithNeighbours(values, edges[i]);
+			AddWithNeighbours(values, -edges[i]);
+		}
+
+		// NaNs: quiet and signalling, payloads in the bits a half keeps and only in the bits it drops
+		const unsigned int nans[] = { 0x7fc00000u, 0x7f800001u, 0x7fa00000u, 0x7fffffffu, 0x7f802000u, 0x7f801fffu, 0x7fc01234u };
+		for (size_t i=0; i < sizeof(nans) / sizeof(nans[0]); i++)
+		{
+			values.push_back(BitsToFloat(nans[i]));
+			values.push_back(BitsToFloat(nans[i] | 0x80000000u));
+		}
+
+		// a spread of ordinary floats
+		unsigned int state = 12345;
+		for (int i=0; i < 100000; i++)
+		{
+			state = state * 1664525u + 1013904223u;
+			values.push_back(BitsToFloat(state));
+		}
+		return values;
+	}
+}
+
+int main()
+{
+	for (unsigned int h=0; h < 0x10000u; h++)
+	{
+		CHECK_MSG(FloatBits(HalfToFloat((unsigned short)h)) == ReferenceHalfToFloat((unsigned short)h), "half 0x" << std::hex << h << std::dec);
+	}
+
+	const std::vector<float> inputs = MakeInputs();
+	int mismatches = 0;
+	for (size_t i=0; i < inputs.size(); i++)
+	{
+		const unsigned short half = FloatToHalf(inputs[i]);
+		if (half != ReferenceFloatToHalf(inputs[i]))
+		{
+			if (mismatches++ < 10)
+				CHECK_MSG(false, "float 0x" << std::hex << FloatBits(inputs[i]) << ": 0x" << half << " instead of 0x" << ReferenceFloatToHalf(inputs[i]) << std::dec);
+		}
+	}
+	CHECK_MSG(mismatches == 0, mismatches << " floats converted differently");
+
+	// the whole input at once, then every length from 0 to 17 at a few offsets so the vector loop and the scalar tail
+	// both see lengths on either side of a multiple of 8
+	std::vector<unsigned short> halfs(inputs.size() + 1, 0xbeef);
+	FloatsToHalfs(&inputs[0], &halfs[0], inputs.size());
+	std::vector<float> rounded(inputs);
+	RoundFloatsToHalf(&rounded[0], rounded.size());
+
+	int arrayMismatches = 0;
+	for (size_t i=0; i < inputs.size(); i++)
+	{
+		arrayMismatches += halfs[i] != FloatToHalf(inputs[i]);
+		arrayMismatches += FloatBits(rounded[i]) != FloatBits(HalfToFloat(FloatToHalf(inputs[i])));
+	}
+	CHECK_MSG(arrayMismatches == 0, arrayMismatches << " values differ between the array and scalar conversions");
+	CHECK(halfs[inputs.size()] == 0xbeef);
+
+	for (size_t offset=0; offset < inputs.size(); offset += inputs.size() / 7 + 3)
+	{
+		for (size_t count=0; count <= 17 && offset + count <= inputs.size(); count++)
+		{
+			std::vector<unsigned short> part(count + 1, 0xbeef);
+			std::vector<float> roundedPart(inputs.begin() + offset, inputs.begin() + offset + count);
+			roundedPart.push_back(1.0f / 3.0f);
+			FloatsToHalfs(&inputs[offset], &part[0], count);
+			RoundFloatsToHalf(&roundedPart[0], count);
+			for (size_t i=0; i < count; i++)
+			{
+				CHECK_MSG(part[i] == FloatToHalf(inputs[offset + i]), "count " << count << ", element " << i);
+				CHECK_MSG(FloatBits(roundedPart[i]) == FloatBits(HalfToFloat(FloatToHalf(inputs[offset + i]))), "count " << count << ", element " << i);
+			}
+			CHECK_MSG(part[count] == 0xbeef, "count " << count << " wrote past the end");
+			CHECK_MSG(roundedPart[count] == 1.0f / 3.0f, "count " << count << " rounded past the end");
+		}
+	}
+
+	std::cout << (HasF16C() ? "checked the F16C path" : "no F16C, checked the scalar path only") << std::endl;
+	return TestResult();
+}
@@ -0,0 +1,177 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 James Vecore
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by James Vecore
+// james.vecore@gmail.com
+
+
+
+// Checks that particle sets are reused when the particle count goes down (particles dying in a sim), which only PRT
+// exports can do, and that the files written from a reused, larger set still hold exactly the particles of their frame,
+// sorted and split ones included.
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <cstdio>
+
+#include <Partio.h>
+
+#include "ParticleBufferCache.h"
+#include "ParticleExporter.h"
+#include "Partition.h"
+#include "MemoryParticleSource.h"
+#include "WriteQueue.h"
+#include "Test.h"
+
+namespace
+{
+	std::vector<ChannelLayout> MakeLayout()
+	{
+		ChannelLayout position = { "Position", Partio::VECTOR, 3 };
+		ChannelLayout id = { "ID", Partio::INT, 1 };
+		std::vector<ChannelLayout> layout;
+		layout.push_back(position);
+		layout.push_back(id);
+		return layout;
+	}
+
+	void CheckCacheReuse()
+	{
+		ParticleBufferCache cache;
+		const std::vector<ChannelLayout> layout = MakeLayout();
+
+		// fewer particles than last time: reused as is with allowLarger
+		Partio::ParticlesDataMutable* first = cache.Acquire("sim", layout, 1000, true);
+		CHECK(first->numParticles() == 1000);
+		cache.Release("sim", first);
+		Partio::ParticlesDataMutable* second = cache.Acquire("sim", layout, 900, true);
+		CHECK(second == first);
+		CHECK(second->numParticles() == 1000);
+
+		// of two idle sets the larger one is picked
+		Partio::ParticlesDataMutable* small = cache.Acquire("sim", layout, 10, true);
+		CHECK(small != second);
+		cache.Release("sim", small);
+		cache.Release("sim", second);
+		Partio::ParticlesDataMutable* third = cache.Acquire("sim", layout, 500, true);
+		CHECK(third == second);
+		cache.Release("sim", third);
+
+		// more particles: the set grows in place
+		Partio::ParticlesDataMutable* grown = cache.Acquire("sim", layout, 2000, true);
+		CHECK(grown == second);
+		CHECK(grown->numParticles() == 2000);
+		cache.Release("sim", grown);
+
+		// an exact count can't use a larger set, it gets the small one back
+		Partio::ParticlesDataMutable* exact = cache.Acquire("sim", layout, 10, false);
+		CHECK(exact == small);
+		CHECK(exact->numParticles() == 10);
+		cache.Release("sim", exact);
+
+		// a different layout never matches
+		std::vector<ChannelLayout> other = layout;
+		other[1].Count = 2;
+		Partio::ParticlesDataMutable* otherSet = cache.Acquire("sim", other, 10, true);
+		Partio::ParticleAttribute attr;
+		CHECK(otherSet->attributeInfo("ID", attr) && attr.count == 2);
+		otherSet->release();
+	}
+
+	// exports frames with a shrinking particle count and reads every file back, all partitions of a split one
+	void CheckShrinkingExport(const std::string& extraOptions, int partitionCount)
+	{
+		ExportFormatFamily family;
+		GetExportFormatFamily("prt", family);
+		StreamExportLog log(std::cerr, ExportLogWarning);
+		ExportOptions options;
+		ParseExportOptions("level=1" + extraOptions, options);
+
+		const int counts[] = { 5000, 4000, 4500, 100, 0, 3000 };
+		for (size_t f=0; f < sizeof(counts) / sizeof(counts[0]); f++)
+		{
+			const int count = counts[f];
+			std::vector<float> position(size_t(count) * 3);
+			std::vector<int> ids(count);
+			for (int i=0; i < count; i++)
+			{
+				position[i*3 + 0] = (float)(i % 13);
+				position[i*3 + 1] = (float)(i % 29);
+				position[i*3 + 2] = (float)(i % 5);
+				ids[i] = (int)f * 100000 + i;
+			}
+			MemoryParticleSource source("shrinking", count);
+			source.AddAttribute("PointPosition", ParticleDataVector3, position);
+			source.AddAttribute("ID", ParticleDataLong, ids);
+
+			const std::string fileName = "ParticleBufferCacheTest.prt";
+			CHECK(ExportParticles(source, GetExportFormat(family), options, fileName, log));
+			WriteQueue::Shared().Flush();
+			CHECK(!LogWriteErrors(log));
+
+			// every ID of this frame exactly once, none left over from a larger frame before it
+			std::vector<int> seen(count, 0);
+			int readCount = 0;
+			int wrong = 0;
+			for (int p=0; p < partitionCount; p++)
+			{
+				const std::string partFileName = partitionCount > 1 ? GetPartitionFileName(fileName, p, partitionCount) : fileName;
+				Partio::ParticlesDataMutable* read = Partio::read(partFileName.c_str());
+				CHECK_MSG(read != NULL, extraOptions << " frame " << f << ": " << partFileName);
+				remove(partFileName.c_str());
+				remove((partFileName + ".idx").c_str());
+				if (read == NULL)
+					continue;
+
+				readCount += read->numParticles();
+				Partio::ParticleAttribute id;
+				const bool hasIds = read->attributeInfo("ID", id);
+				CHECK(hasIds || read->numParticles() == 0);
+				for (int i=0; hasIds && i < read->numParticles(); i++)
+				{
+					const int value = read->data<int>(id, i)[0] - (int)f * 100000;
+					if (value < 0 || value >= count || seen[value]++ != 0)
+						wrong++;
+				}
+				read->release();
+			}
+			CHECK_MSG(readCount == count, extraOptions << " frame " << f << ": " << readCount << " particles");
+			CHECK_MSG(wrong == 0, extraOptions << " frame " << f << ": " << wrong << " wrong IDs");
+			if (partitionCount > 1)
+				remove(GetPartitionManifestFileName(fileName).c_str());
+		}
+	}
+}
+
+int main()
+{
+	CheckCacheReuse();
+	CheckShrinkingExport("", 1);
+	CheckShrinkingExport(",sort=hilbert", 1);
+	CheckShrinkingExport(",split=3", 3);
+	CheckShrinkingExport(",split=3,splitby=id", 3);
+
+	StreamExportLog log(std::cerr, ExportLogWarning);
+	ShutdownExporter(log);
+	return TestResult();
+}
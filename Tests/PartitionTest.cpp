@@ -0,0 +1,226 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 James Vecore
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by James Vecore
+// james.vecore@gmail.com
+
+
+
+// Checks partition file names, the manifest WritePartitionManifest writes, and that a split by ID gives partitions of
+// the planned sizes whose ID ranges follow each other, with the particles of each one read back from its file.
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+#include <Partio.h>
+
+#include "Partition.h"
+#include "ParticleExporter.h"
+#include "MemoryParticleSource.h"
+#include "WriteQueue.h"
+#include "Test.h"
+
+namespace
+{
+	std::string ReadText(const std::string& fileName)
+	{
+		std::ifstream file(fileName.c_str(), std::ios::binary);
+		std::ostringstream ss;
+		ss << file.rdbuf();
+		return ss.str();
+	}
+
+	void CheckFileNames()
+	{
+		CHECK(GetPartitionFileName("sim.0001.prt", 0, 4) == "sim_part00.0001.prt");
+		CHECK(GetPartitionFileName("sim.0001.prt", 3, 4) == "sim_part03.0001.prt");
+		CHECK(GetPartitionFileName("/out/sim.-0001.prt", 1, 2) == "/out/sim.-0001_part01.prt");
+		CHECK(GetPartitionFileName("/out/sim.prt", 1, 2) == "/out/sim_part01.prt");
+		CHECK(GetPartitionFileName("/out.v2/sim", 1, 2) == "/out.v2/sim_part01");
+		CHECK(GetPartitionFileName("C:\\out.v2\\sim.0120.bgeo", 0, 2) == "C:\\out.v2\\sim_part00.0120.bgeo");
+		CHECK(GetPartitionFileName("/out/0120.prt", 0, 2) == "/out/0120_part00.prt");
+		CHECK(GetPartitionFileName("sim.0001", 1, 2) == "sim_part01.0001");
+
+		// more digits once there are more than 100 partitions
+		CHECK(GetPartitionFileName("sim.0001.prt", 7, 100) == "sim_part07.0001.prt");
+		CHECK(GetPartitionFileName("sim.0001.prt", 7, 101) == "sim_part007.0001.prt");
+		CHECK(GetPartitionFileName("sim.0001.prt", 1023, 1024) == "sim_part1023.0001.prt");
+
+		CHECK(GetPartitionManifestFileName("/out/sim.0001.prt") == "/out/sim.0001.prt.manifest.json");
+	}
+
+	void CheckManifest()
+	{
+		std::vector<PartitionInfo> partitions(2);
+		partitions[0].FileName = "/out/si\"m_part00.0001.prt";
+		partitions[0].ParticleCount = 3;
+		partitions[0].HasBounds = true;
+		partitions[0].HasIds = true;
+		partitions[0].MinId = -5;
+		partitions[0].MaxId = 7;
+		for (int a=0; a < 3; a++)
+		{
+			partitions[0].Min[a] = -1.5f + a;
+			partitions[0].Max[a] = 0.25f * a;
+		}
+		partitions[1].FileName = "/out/si\"m_part01.0001.prt";
+		partitions[1].FirstParticle = 3;
+		partitions[1].ParticleCount = 0;
+
+		const std::string fileName = "PartitionTest si\"m.0001.prt";
+		CHECK(WritePartitionManifest(fileName, "tile", "morton", partitions).empty());
+		const std::string expected =
+			"{\n"
+			"\t\"file\": \"PartitionTest si\\\"m.0001.prt\",\n"
+			"\t\"split\": \"tile\",\n"
+			"\t\"curve\": \"morton\",\n"
+			"\t\"particles\": 3,\n"
+			"\t\"partitions\": [\n"
+			"\t\t{ \"file\": \"si\\\"m_part00.0001.prt\", \"first\": 0, \"particles\": 3, \"min\": [-1.5, -0.5, 0.5], \"max\": [0, 0.25, 0.5], \"ids\": [-5, 7] },\n"
+			"\t\t{ \"file\": \"si\\\"m_part01.0001.prt\", \"first\": 3, \"particles\": 0 }\n"
+			"\t]\n"
+			"}\n";
+		const std::string text = ReadText(GetPartitionManifestFileName(fileName));
+		CHECK_MSG(text == expected, text);
+
+		// no curve for an ID split
+		CHECK(WritePartitionManifest(fileName, "id", std::string(), partitions).empty());
+		CHECK(ReadText(GetPartitionManifestFileName(fileName)).find("\"curve\"") == std::string::npos);
+		CHECK(ReadText(GetPartitionManifestFileName(fileName)).find("\t\"split\": \"id\",\n") != std::string::npos);
+		remove(GetPartitionManifestFileName(fileName).c_str());
+	}
+
+	// the "ids" ranges of a manifest in partition order
+	std::vector< std::pair<int, int> > ReadIdRanges(const std::string& text)
+	{
+		std::vector< std::pair<int, int> > ranges;
+		const std::string key = "\"ids\": [";
+		for (size_t pos = text.find(key); pos != std::string::npos; pos = text.find(key, pos + 1))
+		{
+			const char* begin = text.c_str() + pos + key.size();
+			char* end;
+			const int minId = (int)strtol(begin, &end, 10);
+			const int maxId = (int)strtol(end + 1, NULL, 10);
+			ranges.push_back(std::make_pair(minId, maxId));
+		}
+		return ranges;
+	}
+
+	// exports a split by ID (shuffled IDs, duplicates on the partition borders) and reads every partition back
+	void CheckIdSplit(int particleCount, int splitCount)
+	{
+		std::vector<int> ids(particleCount);
+		for (int i=0; i < particleCount; i++)
+		{
+			ids[i] = (i / 2) * 3 - 1000;
+		}
+		unsigned int state = 7;
+		for (int i=particleCount - 1; i > 0; i--)
+		{
+			state = state * 1664525u + 1013904223u;
+			std::swap(ids[i], ids[(state >> 8) % (unsigned int)(i + 1)]);
+		}
+		std::vector<float> position(size_t(particleCount) * 3, 1.0f);
+
+		MemoryParticleSource source("split", particleCount);
+		source.AddAttribute("PointPosition", ParticleDataVector3, position);
+		source.AddAttribute("ID", ParticleDataLong, ids);
+
+		ExportFormatFamily family;
+		GetExportFormatFamily("prt", family);
+		StreamExportLog log(std::cerr, ExportLogWarning);
+		ExportOptions options;
+		std::ostringstream optionText;
+		optionText << "split=" << splitCount << ",splitby=id";
+		ParseExportOptions(optionText.str(), options);
+
+		const std::string fileName = "PartitionTest.0001.prt";
+		CHECK(ExportParticles(source, GetExportFormat(family), options, fileName, log));
+		WriteQueue::Shared().Flush();
+		CHECK(!LogWriteErrors(log));
+
+		const std::string manifest = ReadText(GetPartitionManifestFileName(fileName));
+		remove(GetPartitionManifestFileName(fileName).c_str());
+		CHECK(manifest.find("\t\"split\": \"id\",\n") != std::string::npos);
+		const std::vector< std::pair<int, int> > ranges = ReadIdRanges(manifest);
+
+		std::vector<int> sortedIds(ids);
+		std::sort(sortedIds.begin(), sortedIds.end());
+		std::vector<int> readIds;
+		size_t rangeIndex = 0;
+		for (int p=0; p < splitCount; p++)
+		{
+			const int first = int((long long)particleCount * p / splitCount);
+			const int count = int((long long)particleCount * (p + 1) / splitCount) - first;
+
+			const std::string partFileName = GetPartitionFileName(fileName, p, splitCount);
+			Partio::ParticlesDataMutable* read = Partio::read(partFileName.c_str());
+			remove(partFileName.c_str());
+			CHECK_MSG(read != NULL, partFileName);
+			if (read == NULL)
+				continue;
+			CHECK_MSG(read->numParticles() == count, partFileName << ": " << read->numParticles() << " particles");
+
+			// a partition holds the next run of the sorted IDs, its manifest range is that run's first and last ID
+			Partio::ParticleAttribute id;
+			const bool hasIds = read->attributeInfo("ID", id);
+			CHECK(hasIds || count == 0);
+			std::vector<int> partIds;
+			for (int i=0; hasIds && i < read->numParticles(); i++)
+			{
+				partIds.push_back(read->data<int>(id, i)[0]);
+			}
+			read->release();
+			CHECK_MSG(std::is_sorted(partIds.begin(), partIds.end()), partFileName);
+			if (!partIds.empty())
+			{
+				CHECK_MSG(rangeIndex < ranges.size(), partFileName);
+				if (rangeIndex < ranges.size())
+				{
+					CHECK_MSG(ranges[rangeIndex].first == sortedIds[first] && ranges[rangeIndex].second == sortedIds[first + count - 1], partFileName << ": " << ranges[rangeIndex].first << " " << ranges[rangeIndex].second);
+					rangeIndex++;
+				}
+			}
+			readIds.insert(readIds.end(), partIds.begin(), partIds.end());
+		}
+		CHECK(rangeIndex == ranges.size());
+		CHECK(readIds == sortedIds);
+	}
+}
+
+int main()
+{
+	CheckFileNames();
+	CheckManifest();
+	CheckIdSplit(1000, 4);
+	CheckIdSplit(1001, 3);
+	CheckIdSplit(3, 5); // more partitions than particles, some of them empty
+
+	StreamExportLog log(std::cerr, ExportLogWarning);
+	ShutdownExporter(log);
+	return TestResult();
+}
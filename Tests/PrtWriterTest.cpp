@@ -0,0 +1,286 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by James Vecore
+// james.vecore@gmail.com
+// Round trip of the PRT writer: files of several compressed blocks, written whole and in pieces at different zlib
+// levels (0 included), have to load with partio and inflate as a single zlib stream with a valid checksum and nothing
+// after it. A wrong sync flush, dictionary or adler32_combine shows up as a read or checksum failure or wrong data.
+// Uncompressed files written through PrtMappedWriter get the same checks, so its stored block layout is covered too.
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <cstdio>
+#include <cstring>
+
+#include <Partio.h>
+#include <zlib.h>
+
+#include "PrtWriter.h"
+#include "WorkerPool.h"
+#include "ExportOptions.h"
+#include "HalfFloat.h"
+#include "Test.h"
+
+namespace
+{
+	// Position float32 x3, Age float16 (or 32), ID int32, Color float32 x3: 36 bytes per particle, with 120000
+	// particles that's 8 compressed blocks
+	const int particleCount = 120000;
+
+	Partio::ParticlesDataMutable* CreateParticles(int count, int first)
+	{
+		Partio::ParticlesDataMutable* pPD = Partio::create();
+		Partio::ParticleAttribute position = pPD->addAttribute("Position", Partio::VECTOR, 3);
+		Partio::ParticleAttribute age = pPD->addAttribute("Age", Partio::FLOAT, 1);
+		Partio::ParticleAttribute id = pPD->addAttribute("ID", Partio::INT, 1);
+		Partio::ParticleAttribute color = pPD->addAttribute("Color", Partio::FLOAT, 3);
+		pPD->addParticles(count);
+
+		// smooth data compresses and exercises the dictionaries, the noise keeps blocks from repeating
+		for (int i=0; i < count; i++)
+		{
+			const int p = first + i;
+			const unsigned int noise = (unsigned int)p * 2654435761u;
+			float* pos = pPD->dataWrite<float>(position, i);
+			pos[0] = p * 0.01f;
+			pos[1] = (float)((p % 1000) - 500);
+			pos[2] = (float)(noise >> 16) / 65536.0f;
+			*pPD->dataWrite<float>(age, i) = (p % 240) / 24.0f;
+			*pPD->dataWrite<int>(id, i) = p;
+			float* c = pPD->dataWrite<float>(color, i);
+			c[0] = (p % 7) / 7.0f;
+			c[1] = 0.5f;
+			c[2] = (float)(noise & 0xff) / 255.0f;
+		}
+		return pPD;
+	}
+
+	float Expected(float value, bool half)
+	{
+		return half ? HalfToFloat(FloatToHalf(value)) : value;
+	}
+
+	std::vector<unsigned char> ReadFile(const std::string& fileName)
+	{
+		std::vector<unsigned char> data;
+		FILE* file = fopen(fileName.c_str(), "rb");
+		if (file == NULL)
+			return data;
+		unsigned char buffer[64 * 1024];
+		size_t read;
+		while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		{
+			data.insert(data.end(), buffer, buffer + read);
+		}
+		fclose(file);
+		return data;
+	}
+
+	int ReadInt32(const std::vector<unsigned char>& data, size_t offset)
+	{
+		return (int)((unsigned int)data[offset] | ((unsigned int)data[offset+1] << 8) | ((unsigned int)data[offset+2] << 16) | ((unsigned int)data[offset+3] << 24));
+	}
+
+	// reads the file with partio and compares every value with the particles it was written from
+	void CheckPartioRead(const std::string& fileName, const Partio::ParticlesData& source, bool halfAge)
+	{
+		Partio::ParticlesDataMutable* read = Partio::read(fileName.c_str());
+		CHECK_MSG(read != NULL, fileName);
+		if (read == NULL)
+			return;
+
+		CHECK_MSG(read->numParticles() == source.numParticles(), fileName);
+		CHECK_MSG(read->numAttributes() == source.numAttributes(), fileName);
+
+		for (int a=0; a < source.numAttributes() && read->numParticles() == source.numParticles(); a++)
+		{
+			Partio::ParticleAttribute sourceAttr, readAttr;
+			source.attributeInfo(a, sourceAttr);
+			bool found = read->attributeInfo(sourceAttr.name.c_str(), readAttr);
+			CHECK_MSG(found && readAttr.count == sourceAttr.count, fileName << " " << sourceAttr.name);
+			if (!found || readAttr.count != sourceAttr.count)
+				continue;
+
+			int mismatches = 0;
+			for (int i=0; i < source.numParticles(); i++)
+			{
+				for (int c=0; c < sourceAttr.count; c++)
+				{
+					if (sourceAttr.type == Partio::INT)
+						mismatches += read->data<int>(readAttr, i)[c] != source.data<int>(sourceAttr, i)[c];
+					else
+						mismatches += read->data<float>(readAttr, i)[c] != Expected(source.data<float>(sourceAttr, i)[c], halfAge && sourceAttr.name == "Age");
+				}
+			}
+			CHECK_MSG(mismatches == 0, fileName << " " << sourceAttr.name << ": " << mismatches << " values differ");
+		}
+		read->release();
+	}
+
+	// inflates the particle data with plain zlib, which checks the adler32 trailer, and compares the IDs in it
+	void CheckInflate(const std::string& fileName, const Partio::ParticlesData& source, bool halfAge)
+	{
+		const std::vector<unsigned char> file = ReadFile(fileName);
+		CHECK_MSG(file.size() > 56, fileName);
+		if (file.size() <= 56)
+			return;
+
+		const size_t headerLength = ReadInt32(file, 8);
+		const int channelCount = ReadInt32(file, headerLength + 4);
+		const int channelLength = ReadInt32(file, headerLength + 8);
+		const size_t dataOffset = headerLength + 12 + channelCount * channelLength;
+		const size_t particleSize = 12 + (halfAge ? 2 : 4) + 4 + 12;
+		CHECK_MSG(channelCount == source.numAttributes(), fileName);
+
+		std::vector<unsigned char> raw(size_t(source.numParticles()) * particleSize + 1);
+		z_stream strm;
+		memset(&strm, 0, sizeof(strm));
+		CHECK(inflateInit(&strm) == Z_OK);
+		strm.next_in = (Bytef*)&file[dataOffset];
+		strm.avail_in = (uInt)(file.size() - dataOffset);
+		strm.next_out = &raw[0];
+		strm.avail_out = (uInt)raw.size();
+		const int result = inflate(&strm, Z_FINISH);
+		CHECK_MSG(result == Z_STREAM_END, fileName << ": inflate returned " << result);
+		CHECK_MSG(strm.total_out == size_t(source.numParticles()) * particleSize, fileName << ": " << strm.total_out << " bytes inflated");
+		CHECK_MSG(strm.avail_in == 0, fileName << ": " << strm.avail_in << " bytes after the zlib stream");
+		inflateEnd(&strm);
+
+		// the IDs, the blocks have to end up in order and refer to the right data before them
+		Partio::ParticleAttribute id;
+		source.attributeInfo("ID", id);
+		int mismatches = 0;
+		for (int i=0; i < source.numParticles() && result == Z_STREAM_END; i++)
+		{
+			mismatches += ReadInt32(raw, i * particleSize + particleSize - 16) != source.data<int>(id, i)[0];
+		}
+		CHECK_MSG(mismatches == 0, fileName << ": " << mismatches << " IDs differ");
+	}
+
+	// writes the particles through PrtMappedWriter the way the exporter's converters do, value by value at the
+	// addresses its channels give
+	std::string WriteMapped(const std::string& fileName, const Partio::ParticlesData& source, WorkerPool& pool)
+	{
+		std::vector<Partio::ParticleAttribute> attributes(source.numAttributes());
+		for (int a=0; a < source.numAttributes(); a++)
+			source.attributeInfo(a, attributes[a]);
+
+		PrtMappedWriter writer;
+		std::string error = writer.Open(fileName, attributes, source.numParticles());
+		if (!error.empty())
+			return error;
+
+		for (int a=0; a < source.numAttributes(); a++)
+		{
+			const PrtMappedChannel channel = writer.GetChannel(a);
+			for (int i=0; i < source.numParticles(); i++)
+			{
+				char* dst = channel.Data + size_t(i / channel.BlockParticles) * channel.BlockStride + size_t(i % channel.BlockParticles) * channel.Stride;
+				memcpy(dst, source.data<char>(attributes[a], i), attributes[a].count * 4);
+			}
+		}
+		return writer.Close(pool);
+	}
+
+	ExportOptions MakeOptions(int level)
+	{
+		ExportOptions options;
+		options.CompressionLevel = level;
+		return options;
+	}
+}
+
+int main()
+{
+	Partio::ParticlesDataMutable* particles = CreateParticles(particleCount, 0);
+	const int levels[] = { 0, 1, 6, 9, -1 };
+
+	// a few threads even on a single core machine, so blocks are compressed out of order and in several batches
+	WorkerPool pool(4);
+
+	for (size_t l=0; l < sizeof(levels) / sizeof(levels[0]); l++)
+	{
+		for (int half=0; half < 2; half++)
+		{
+			std::vector<std::string> halfChannels;
+			if (half)
+				halfChannels.push_back("Age");
+
+			ExportOptions options = MakeOptions(levels[l]);
+
+			std::ostringstream fileName;
+			fileName << "PrtWriterTest_level" << levels[l] << (half ? "_half" : "") << ".prt";
+			CHECK_MSG(WritePRT(fileName.str(), *particles, options, halfChannels, pool).empty(), fileName.str());
+			CheckPartioRead(fileName.str(), *particles, half != 0);
+			CheckInflate(fileName.str(), *particles, half != 0);
+			remove(fileName.str().c_str());
+
+			// the same particles streamed in uneven pieces, every Write() continues the stream of the last one
+			std::ostringstream streamFileName;
+			streamFileName << "PrtWriterTest_stream_level" << levels[l] << (half ? "_half" : "") << ".prt";
+			PrtStreamWriter writer(pool);
+			CHECK_MSG(writer.Open(streamFileName.str(), *particles, particleCount, options, halfChannels).empty(), streamFileName.str());
+			const int pieces[] = { 1, 40000, 0, 33333, particleCount - 1 - 40000 - 33333 };
+			int first = 0;
+			for (size_t p=0; p < sizeof(pieces) / sizeof(pieces[0]); p++)
+			{
+				Partio::ParticlesDataMutable* piece = CreateParticles(pieces[p], first);
+				CHECK_MSG(writer.Write(*piece, pieces[p]).empty(), streamFileName.str());
+				piece->release();
+				first += pieces[p];
+			}
+			CHECK_MSG(writer.Close().empty(), streamFileName.str());
+			CheckPartioRead(streamFileName.str(), *particles, half != 0);
+			CheckInflate(streamFileName.str(), *particles, half != 0);
+			remove(streamFileName.str().c_str());
+		}
+	}
+
+	// mapped files are stored blocks of whole particles: none, one, exactly one full block (65535 / 32 bytes = 2047
+	// particles), one more than that, and many blocks
+	const int mappedCounts[] = { 0, 1, 2047, 2048, particleCount };
+	for (size_t c=0; c < sizeof(mappedCounts) / sizeof(mappedCounts[0]); c++)
+	{
+		Partio::ParticlesDataMutable* mappedParticles = CreateParticles(mappedCounts[c], 0);
+		std::ostringstream fileName;
+		fileName << "PrtWriterTest_mapped" << mappedCounts[c] << ".prt";
+		CHECK_MSG(WriteMapped(fileName.str(), *mappedParticles, pool).empty(), fileName.str());
+		CheckPartioRead(fileName.str(), *mappedParticles, false);
+		CheckInflate(fileName.str(), *mappedParticles, false);
+
+		remove(fileName.str().c_str());
+		mappedParticles->release();
+	}
+
+	// announcing more particles than written is an error, the file is still closed
+	PrtStreamWriter shortWriter(pool);
+	ExportOptions options = MakeOptions(1);
+	CHECK(shortWriter.Open("PrtWriterTest_short.prt", *particles, particleCount + 1, options, std::vector<std::string>()).empty());
+	CHECK(shortWriter.Write(*particles, particleCount).empty());
+	CHECK(!shortWriter.Close().empty());
+	remove("PrtWriterTest_short.prt");
+
+	particles->release();
+	return TestResult();
+}
@@ -0,0 +1,265 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by James Vecore
+// james.vecore@gmail.com
+
+// Checks ConvertRotations for every source form (quaternions in both storage orders, axis angles and Euler angles) and
+// every convention. The batch call has to give the same bits as converting one particle at a time, for counts that
+// aren't a multiple of 4, padded strides and constant data. Each result also has to describe the same rotation as the
+// source, compared through rotation matrices built per particle with plain scalar code that branches on the form the
+// way the old per particle StoreDataRaw did.
+
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "Rotation.h"
+#include "Test.h"
+
+namespace
+{
+	const float pi = 3.14159265358979f;
+
+	struct Matrix
+	{
+		float m[3][3];
+	};
+
+	Matrix Multiply(const Matrix& a, const Matrix& b)
+	{
+		Matrix r;
+		for (int i=0; i < 3; i++)
+		{
+			for (int j=0; j < 3; j++)
+			{
+				r.m[i][j] = a.m[i][0]*b.m[0][j] + a.m[i][1]*b.m[1][j] + a.m[i][2]*b.m[2][j];
+			}
+		}
+		return r;
+	}
+
+	// rotation by angle about a coordinate axis, for column vectors
+	Matrix AxisMatrix(int axis, float angle)
+	{
+		const float c = cosf(angle), s = sinf(angle);
+		Matrix r = {{{ 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 }}};
+		const int a = (axis + 1) % 3, b = (axis + 2) % 3;
+		r.m[a][a] = c;
+		r.m[a][b] = -s;
+		r.m[b][a] = s;
+		r.m[b][b] = c;
+		return r;
+	}
+
+	Matrix QuaternionMatrix(float x, float y, float z, float w)
+	{
+		const float n = sqrtf(x*x + y*y + z*z + w*w);
+		x /= n; y /= n; z /= n; w /= n;
+		Matrix r = {{
+			{ 1 - 2*(y*y + z*z), 2*(x*y - w*z),     2*(x*z + w*y) },
+			{ 2*(x*y + w*z),     1 - 2*(x*x + z*z), 2*(y*z - w*x) },
+			{ 2*(x*z - w*y),     2*(y*z + w*x),     1 - 2*(x*x + y*y) }
+		}};
+		return r;
+	}
+
+	// Rodrigues, a zero axis is no rotation
+	Matrix AxisAngleMatrix(const float* v)
+	{
+		const float length = sqrtf(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+		if (length == 0.0f)
+			return AxisMatrix(0, 0.0f);
+		const float x = v[0] / length, y = v[1] / length, z = v[2] / length;
+		const float c = cosf(v[3]), s = sinf(v[3]), t = 1 - c;
+		Matrix r = {{
+			{ t*x*x + c,   t*x*y - s*z, t*x*z + s*y },
+			{ t*x*y + s*z, t*y*y + c,   t*y*z - s*x },
+			{ t*x*z - s*y, t*y*z + s*x, t*z*z + c }
+		}};
+		return r;
+	}
+
+	// angles in x,y,z slots, the first axis of the order is applied first
+	Matrix EulerMatrix(const float* angles, int first, int second, int third)
+	{
+		return Multiply(AxisMatrix(third, angles[third]), Multiply(AxisMatrix(second, angles[second]), AxisMatrix(first, angles[first])));
+	}
+
+	Matrix SourceMatrix(const float* v, ParticleRotationForm form, bool wxyz)
+	{
+		switch (form)
+		{
+		case ParticleRotationQuaternion:
+			return wxyz ? QuaternionMatrix(v[1], v[2], v[3], v[0]) : QuaternionMatrix(v[0], v[1], v[2], v[3]);
+		case ParticleRotationAxisAngle:
+			return AxisAngleMatrix(v);
+		default:
+			return EulerMatrix(v, 0, 1, 2);
+		}
+	}
+
+	Matrix ResultMatrix(const float* v, RotationConvention convention)
+	{
+		static const int orders[6][3] = { { 0, 1, 2 }, { 0, 2, 1 }, { 1, 0, 2 }, { 1, 2, 0 }, { 2, 0, 1 }, { 2, 1, 0 } };
+		switch (convention)
+		{
+		case RotationQuaternionXYZW:
+			return QuaternionMatrix(v[0], v[1], v[2], v[3]);
+		case RotationQuaternionWXYZ:
+			return QuaternionMatrix(v[1], v[2], v[3], v[0]);
+		case RotationAxisAngle:
+			return AxisAngleMatrix(v);
+		default:
+			const int* order = orders[convention - RotationEulerXYZ];
+			return EulerMatrix(v, order[0], order[1], order[2]);
+		}
+	}
+
+	float MaxDifference(const Matrix& a, const Matrix& b)
+	{
+		float difference = 0.0f;
+		for (int i=0; i < 3; i++)
+		{
+			for (int j=0; j < 3; j++)
+			{
+				difference = std::max(difference, fabsf(a.m[i][j] - b.m[i][j]));
+			}
+		}
+		return difference;
+	}
+
+	float Random(unsigned int& state, float low, float high)
+	{
+		state = state * 1664525u + 1013904223u;
+		return low + (high - low) * (float)(state >> 8) / 16777216.0f;
+	}
+
+	// count values of the form with padding floats after each, the first one is always no rotation
+	std::vector<float> MakeRotations(ParticleRotationForm form, bool wxyz, int count, int floatsPerValue)
+	{
+		std::vector<float> values(size_t(std::max(count, 1)) * floatsPerValue, 99.0f);
+		unsigned int state = 42 + count;
+		for (int i=0; i < count; i++)
+		{
+			float* v = &values[size_t(i) * floatsPerValue];
+			if (form == ParticleRotationQuaternion)
+			{
+				float q[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+				if (i > 0)
+				{
+					float n = 0.0f;
+					for (int c=0; c < 4; c++)
+					{
+						q[c] = Random(state, -1.0f, 1.0f);
+						n += q[c] * q[c];
+					}
+					for (int c=0; c < 4; c++)
+					{
+						q[c] /= sqrtf(n);
+					}
+				}
+				v[0] = wxyz ? q[3] : q[0];
+				v[1] = wxyz ? q[0] : q[1];
+				v[2] = wxyz ? q[1] : q[2];
+				v[3] = wxyz ? q[2] : q[3];
+			}
+			else if (form == ParticleRotationAxisAngle)
+			{
+				for (int c=0; c < 3; c++)
+				{
+					v[c] = i > 0 ? Random(state, -2.0f, 2.0f) : 0.0f;
+				}
+				v[3] = i > 0 ? Random(state, -pi, 2.0f * pi) : 0.0f;
+			}
+			else
+			{
+				// away from the middle angle's +-pi/2 where Euler angles lose precision in float
+				for (int c=0; c < 3; c++)
+				{
+					v[c] = i > 0 ? Random(state, -1.4f, 1.4f) : 0.0f;
+				}
+				v[3] = 0.0f;
+			}
+		}
+		return values;
+	}
+
+	void CheckConversion(ParticleRotationForm form, bool wxyz, RotationConvention convention, int count, size_t srcStride, size_t dstStride)
+	{
+		const int srcFloats = srcStride == 0 ? 4 : (int)(srcStride / sizeof(float));
+		const int dstFloats = (int)(dstStride / sizeof(float));
+		const std::vector<float> src = MakeRotations(form, wxyz, srcStride == 0 ? 1 : count, srcFloats);
+
+		// the guard after the last particle catches writes past the end
+		std::vector<float> batch(size_t(count) * dstFloats + 4, -1.0f);
+		std::vector<float> single(batch.size(), -1.0f);
+		ConvertRotations(&src[0], srcStride, form, wxyz, convention, &batch[0], dstStride, count);
+		for (int i=0; i < count; i++)
+		{
+			ConvertRotations(&src[0] + (srcStride == 0 ? 0 : size_t(i) * srcFloats), 0, form, wxyz, convention, &single[size_t(i) * dstFloats], dstStride, 1);
+		}
+
+		const char* name = GetRotationConventionName(convention);
+		CHECK_MSG(memcmp(&batch[0], &single[0], batch.size() * sizeof(float)) == 0, "form " << form << (wxyz ? " wxyz" : "") << " to " << name << ", " << count << " particles, strides " << srcStride << " " << dstStride);
+
+		float maxDifference = 0.0f;
+		for (int i=0; i < count; i++)
+		{
+			const float* v = &src[0] + (srcStride == 0 ? 0 : size_t(i) * srcFloats);
+			maxDifference = std::max(maxDifference, MaxDifference(SourceMatrix(v, form, wxyz), ResultMatrix(&batch[size_t(i) * dstFloats], convention)));
+		}
+		CHECK_MSG(maxDifference < 1e-4f, "form " << form << (wxyz ? " wxyz" : "") << " to " << name << ", " << count << " particles: rotations differ by " << maxDifference);
+	}
+}
+
+int main()
+{
+	const ParticleRotationForm forms[] = { ParticleRotationQuaternion, ParticleRotationQuaternion, ParticleRotationAxisAngle, ParticleRotationEulerXYZ };
+	const bool wxyz[] = { false, true, false, false };
+	const int counts[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 13, 1001 };
+
+	for (int f=0; f < 4; f++)
+	{
+		for (int c=RotationQuaternionXYZW; c < RotationConventionCount; c++)
+		{
+			for (size_t n=0; n < sizeof(counts) / sizeof(counts[0]); n++)
+			{
+				CheckConversion(forms[f], wxyz[f], (RotationConvention)c, counts[n], 16, 16);
+				CheckConversion(forms[f], wxyz[f], (RotationConvention)c, counts[n], 20, 24);
+				CheckConversion(forms[f], wxyz[f], (RotationConvention)c, counts[n], 0, 16);
+			}
+		}
+	}
+
+	// the option names round trip
+	for (int c=0; c < RotationConventionCount; c++)
+	{
+		RotationConvention parsed = RotationNative;
+		CHECK(ParseRotationConvention(GetRotationConventionName((RotationConvention)c), parsed) && parsed == c);
+	}
+	RotationConvention unused;
+	CHECK(!ParseRotationConvention("eulerxyy", unused));
+
+	return TestResult();
+}
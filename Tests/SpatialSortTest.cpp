@@ -0,0 +1,246 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 James Vecore
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by James Vecore
+// james.vecore@gmail.com
+
+
+
+// Checks ComputeSpatialOrder on random points, non-finite ones and a flat box included: the permutation holds every
+// particle once, the bounds are those of the finite points and every cell's range holds exactly the points that fall
+// into it by the formula in SpatialSort.h. Also reads back the sidecar WriteSpatialIndex writes.
+
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+
+#include "SpatialSort.h"
+#include "WorkerPool.h"
+#include "Test.h"
+
+namespace
+{
+	std::vector<float> MakePoints(int count, unsigned int seed)
+	{
+		std::vector<float> points(size_t(count) * 3);
+		unsigned int state = seed;
+		for (size_t i=0; i < points.size(); i++)
+		{
+			state = state * 1664525u + 1013904223u;
+			points[i] = (float)(state >> 8) / (float)(1 << 24) * 20.0f - 5.0f;
+		}
+		return points;
+	}
+
+	// the cell of one point as SpatialSort.h defines it
+	int ExpectedCell(const float* p, const SpatialIndex& index)
+	{
+		if (!std::isfinite(p[0]) || !std::isfinite(p[1]) || !std::isfinite(p[2]))
+			return 0;
+
+		int cell = 0;
+		int axisScale = 1;
+		for (int a=0; a < 3; a++)
+		{
+			const float extent = index.Max[a] - index.Min[a];
+			int q = 0;
+			if (extent > 0.0f)
+			{
+				const float v = (p[a] - index.Min[a]) * (1024.0f / extent);
+				q = v <= 0.0f ? 0 : (int)std::min(1023.0f, std::floor(v));
+			}
+			cell += q / (1024 / index.Resolution) * axisScale;
+			axisScale *= index.Resolution;
+		}
+		return cell;
+	}
+
+	void CheckOrder(const std::vector<float>& points, SpatialOrder order, int resolution, int expectedResolution, WorkerPool& pool)
+	{
+		const int count = (int)(points.size() / 3);
+		std::vector<unsigned int> permutation;
+		SpatialIndex index;
+		ComputeSpatialOrder(points.empty() ? NULL : (const char*)&points[0], sizeof(float) * 3, count, order, resolution, permutation, index, pool);
+
+		CHECK(index.Order == order);
+		CHECK_MSG(index.Resolution == expectedResolution, "resolution " << resolution << " became " << index.Resolution);
+		CHECK(index.ParticleCount == count);
+		const size_t cellCount = size_t(index.Resolution) * index.Resolution * index.Resolution;
+		CHECK(index.CellFirst.size() == cellCount && index.CellCount.size() == cellCount);
+		if (index.CellFirst.size() != cellCount || index.CellCount.size() != cellCount)
+			return;
+
+		// the bounds of the finite points, zero if there are none
+		float min[3] = { 0.0f, 0.0f, 0.0f };
+		float max[3] = { 0.0f, 0.0f, 0.0f };
+		bool anyFinite = false;
+		for (int i=0; i < count; i++)
+		{
+			const float* p = &points[i*3];
+			if (!std::isfinite(p[0]) || !std::isfinite(p[1]) || !std::isfinite(p[2]))
+				continue;
+			for (int a=0; a < 3; a++)
+			{
+				min[a] = anyFinite ? std::min(min[a], p[a]) : p[a];
+				max[a] = anyFinite ? std::max(max[a], p[a]) : p[a];
+			}
+			anyFinite = true;
+		}
+		for (int a=0; a < 3; a++)
+		{
+			CHECK_MSG(index.Min[a] == min[a] && index.Max[a] == max[a], "axis " << a << ": " << index.Min[a] << " " << index.Max[a]);
+		}
+
+		// every particle once
+		CHECK(permutation.size() == size_t(count));
+		std::vector<int> seen(count, 0);
+		int duplicates = 0;
+		for (size_t i=0; i < permutation.size(); i++)
+		{
+			if (permutation[i] >= (unsigned int)count || seen[permutation[i]]++ != 0)
+				duplicates++;
+		}
+		CHECK_MSG(duplicates == 0, duplicates << " particles out of range or sorted twice");
+		if (duplicates != 0 || permutation.size() != size_t(count))
+			return;
+
+		// each sorted particle lies in the range of its own cell and every range has as many particles as fall into
+		// the cell, so the ranges are contiguous and hold exactly the cell's points
+		std::vector<unsigned int> pointsInCell(cellCount, 0);
+		int outside = 0;
+		for (int i=0; i < count; i++)
+		{
+			const int cell = ExpectedCell(&points[permutation[i]*3], index);
+			pointsInCell[cell]++;
+			if ((unsigned int)i < index.CellFirst[cell] || (unsigned int)i >= index.CellFirst[cell] + index.CellCount[cell])
+			{
+				if (outside++ < 5)
+					CHECK_MSG(false, "sorted particle " << i << " isn't in the range of cell " << cell);
+			}
+		}
+		CHECK_MSG(outside == 0, outside << " particles outside their cell's range");
+		int wrongCounts = 0;
+		for (size_t c=0; c < cellCount; c++)
+		{
+			wrongCounts += pointsInCell[c] != index.CellCount[c];
+		}
+		CHECK_MSG(wrongCounts == 0, wrongCounts << " cells with the wrong particle count");
+	}
+
+	unsigned int ReadUInt32(const std::vector<unsigned char>& data, size_t offset)
+	{
+		return data[offset] | (data[offset + 1] << 8) | (data[offset + 2] << 16) | ((unsigned int)data[offset + 3] << 24);
+	}
+
+	float ReadFloat32(const std::vector<unsigned char>& data, size_t offset)
+	{
+		const unsigned int bits = ReadUInt32(data, offset);
+		float value;
+		memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	void CheckSidecar(const std::vector<float>& points, SpatialOrder order, WorkerPool& pool)
+	{
+		std::vector<unsigned int> permutation;
+		SpatialIndex index;
+		ComputeSpatialOrder((const char*)&points[0], sizeof(float) * 3, (int)(points.size() / 3), order, 4, permutation, index, pool);
+
+		const std::string fileName = "SpatialSortTest.idx";
+		CHECK(WriteSpatialIndex(fileName, index).empty());
+		std::vector<unsigned char> data;
+		FILE* file = fopen(fileName.c_str(), "rb");
+		CHECK(file != NULL);
+		if (file == NULL)
+			return;
+		unsigned char buffer[4096];
+		size_t read;
+		while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+			data.insert(data.end(), buffer, buffer + read);
+		fclose(file);
+		remove(fileName.c_str());
+
+		const size_t headerSize = 8 + 3*4 + 6*4;
+		CHECK(data.size() == headerSize + 64 * 8);
+		if (data.size() != headerSize + 64 * 8)
+			return;
+		CHECK(memcmp(&data[0], "PXSIDX1\0", 8) == 0);
+		CHECK(ReadUInt32(data, 8) == (order == SpatialOrderHilbert ? 2u : 1u));
+		CHECK(ReadUInt32(data, 12) == 4);
+		CHECK(ReadUInt32(data, 16) == (unsigned int)index.ParticleCount);
+		for (int a=0; a < 3; a++)
+		{
+			CHECK(ReadFloat32(data, 20 + a*4) == index.Min[a]);
+			CHECK(ReadFloat32(data, 32 + a*4) == index.Max[a]);
+		}
+		int wrongCells = 0;
+		for (size_t c=0; c < 64; c++)
+		{
+			wrongCells += ReadUInt32(data, headerSize + c*8) != index.CellFirst[c];
+			wrongCells += ReadUInt32(data, headerSize + c*8 + 4) != index.CellCount[c];
+		}
+		CHECK(wrongCells == 0);
+	}
+}
+
+int main()
+{
+	WorkerPool pool(4);
+
+	// more than one chunk of keys, with points that aren't finite and some exactly on the bounds
+	std::vector<float> points = MakePoints(300000, 1);
+	const float inf = std::numeric_limits<float>::infinity();
+	const float nan = std::numeric_limits<float>::quiet_NaN();
+	for (int i=0; i < 1000; i++)
+	{
+		points[i*97*3 + i % 3] = i % 2 == 0 ? nan : (i % 4 == 1 ? inf : -inf);
+	}
+	points[5*3] = -5.0f;
+	points[6*3 + 1] = 15.0f;
+
+	const SpatialOrder orders[] = { SpatialOrderMorton, SpatialOrderHilbert };
+	for (int o=0; o < 2; o++)
+	{
+		CheckOrder(points, orders[o], 1, 1, pool);
+		CheckOrder(points, orders[o], 4, 4, pool);
+		CheckOrder(points, orders[o], 3, 4, pool);
+		CheckOrder(points, orders[o], 5, 8, pool);
+		CheckOrder(points, orders[o], 32, 32, pool);
+		CheckOrder(MakePoints(1000, 2), orders[o], 16, 16, pool);
+		CheckOrder(std::vector<float>(), orders[o], 8, 8, pool);
+
+		// flat on one axis, then all the same point
+		std::vector<float> flat = MakePoints(5000, 3);
+		for (size_t i=0; i < flat.size(); i += 3)
+			flat[i + 1] = 2.0f;
+		CheckOrder(flat, orders[o], 8, 8, pool);
+		CheckOrder(std::vector<float>(3000, 1.5f), orders[o], 8, 8, pool);
+
+		CheckSidecar(MakePoints(2000, 4), orders[o], pool);
+	}
+
+	return TestResult();
+}
@@ -0,0 +1,61 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by James Vecore
+// james.vecore@gmail.com
+#ifndef PARTIO_EXPORT_TEST_H
+#define PARTIO_EXPORT_TEST_H
+
+#include <iostream>
+
+// Minimal checks for the test executables in this directory: CHECK logs a failed condition and carries on, main()
+// returns TestResult() so ctest sees the failure.
+
+static int testFailures = 0;
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) \
+		{ \
+			std::cerr << __FILE__ << "(" << __LINE__ << "): check failed: " << #condition << std::endl; \
+			testFailures++; \
+		} \
+	} while (0)
+
+// like CHECK, with a description of the case that failed
+#define CHECK_MSG(condition, message) \
+	do { \
+		if (!(condition)) \
+		{ \
+			std::cerr << __FILE__ << "(" << __LINE__ << "): check failed: " << #condition << " (" << message << ")" << std::endl; \
+			testFailures++; \
+		} \
+	} while (0)
+
+inline int TestResult()
+{
+	if (testFailures != 0)
+		std::cerr << testFailures << " check(s) failed" << std::endl;
+	return testFailures == 0 ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,182 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "WorkerPool.h"
+
+#include <atomic>
+#include <memory>
+#include <cstdlib>
+#include <algorithm>
+
+static WorkerPool* sharedPool = NULL;
+static std::mutex sharedPoolMutex;
+
+WorkerPool::WorkerPool(int threadCount)
+	: m_stop(false)
+{
+	for (int i=1; i < threadCount; i++)
+	{
+		m_threads.push_back(std::thread(&WorkerPool::WorkerMain, this));
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_wake.notify_all();
+
+	for (size_t i=0; i < m_threads.size(); i++)
+	{
+		m_threads[i].join();
+	}
+
+	// no worker threads at all, run whatever was posted on this thread
+	while (!m_queue.empty())
+	{
+		std::function<void()> task = m_queue.front();
+		m_queue.pop_front();
+		task();
+	}
+}
+
+void WorkerPool::WorkerMain()
+{
+	for (;;)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while (!m_stop && m_queue.empty())
+			{
+				m_wake.wait(lock);
+			}
+			if (m_queue.empty())
+				return; // stopping and nothing left to do
+
+			task = m_queue.front();
+			m_queue.pop_front();
+		}
+		task();
+	}
+}
+
+void WorkerPool::Post(const std::function<void()>& task)
+{
+	if (m_threads.empty())
+	{
+		task();
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_queue.push_back(task);
+	}
+	m_wake.notify_one();
+}
+
+namespace
+{
+	struct Batch
+	{
+		std::vector< std::function<void()> > tasks;
+		std::atomic<size_t> next;
+		size_t done;
+		std::mutex mutex;
+		std::condition_variable finished;
+	};
+
+	void DrainBatch(const std::shared_ptr<Batch>& batch)
+	{
+		size_t index;
+		while ((index = batch->next++) < batch->tasks.size())
+		{
+			batch->tasks[index]();
+
+			std::lock_guard<std::mutex> lock(batch->mutex);
+			if (++batch->done == batch->tasks.size())
+				batch->finished.notify_all();
+		}
+	}
+}
+
+void WorkerPool::Run(std::vector< std::function<void()> > tasks)
+{
+	if (m_threads.empty() || tasks.size() < 2)
+	{
+		for (size_t i=0; i < tasks.size(); i++)
+		{
+			tasks[i]();
+		}
+		return;
+	}
+
+	std::shared_ptr<Batch> batch(new Batch);
+	batch->tasks.swap(tasks);
+	batch->next = 0;
+	batch->done = 0;
+
+	// helpers that start after the batch is drained just return, the batch is kept alive by the shared_ptr
+	size_t helpers = std::min(m_threads.size(), batch->tasks.size() - 1);
+	for (size_t i=0; i < helpers; i++)
+	{
+		Post(std::bind(&DrainBatch, batch));
+	}
+
+	DrainBatch(batch);
+
+	std::unique_lock<std::mutex> lock(batch->mutex);
+	while (batch->done != batch->tasks.size())
+	{
+		batch->finished.wait(lock);
+	}
+}
+
+int WorkerPool::DefaultThreadCount()
+{
+	const char* env = getenv("PARTIO_EXPORT_THREADS");
+	if (env != NULL && atoi(env) > 0)
+		return atoi(env);
+
+	int hardwareThreads = (int)std::thread::hardware_concurrency();
+	return hardwareThreads > 0 ? hardwareThreads : 1;
+}
+
+WorkerPool& WorkerPool::Shared()
+{
+	std::lock_guard<std::mutex> lock(sharedPoolMutex);
+	if (sharedPool == NULL)
+		sharedPool = new WorkerPool(DefaultThreadCount());
+	return *sharedPool;
+}
+
+void WorkerPool::ShutdownShared()
+{
+	// not done from a static destructor, joining threads while the dll is being unloaded deadlocks on windows
+	std::lock_guard<std::mutex> lock(sharedPoolMutex);
+	delete sharedPool;
+	sharedPool = NULL;
+}
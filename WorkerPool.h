@@ -0,0 +1,71 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef PARTIO_EXPORT_WORKER_POOL_H
+#define PARTIO_EXPORT_WORKER_POOL_H
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Small fixed size thread pool shared by the exporter.
+//
+// Run() blocks until a batch of tasks has finished and has the calling thread work on the batch as well, Post() just
+// queues a task and returns. Tasks must not call back into the Softimage SDK, everything that touches the scene has
+// to stay on the main thread.
+class WorkerPool
+{
+public:
+	// threadCount is the total number of threads working on a batch including the caller, so 1 means no worker threads
+	explicit WorkerPool(int threadCount);
+	~WorkerPool(); // finishes all queued tasks before returning
+
+	int GetThreadCount() const { return (int)m_threads.size() + 1; }
+
+	void Run(std::vector< std::function<void()> > tasks);
+	void Post(const std::function<void()>& task);
+
+	// shared pool used by the exporter, created on first use with DefaultThreadCount() threads
+	static WorkerPool& Shared();
+	static void ShutdownShared(); // must be called before the plugin is unloaded
+
+	// PARTIO_EXPORT_THREADS environment variable if set, otherwise the number of hardware threads
+	static int DefaultThreadCount();
+
+private:
+	WorkerPool(const WorkerPool&);
+	WorkerPool& operator=(const WorkerPool&);
+
+	void WorkerMain();
+
+	std::vector<std::thread> m_threads;
+	std::deque< std::function<void()> > m_queue;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	bool m_stop;
+};
+
+#endif
@@ -0,0 +1,158 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "WriteQueue.h"
+
+#include <cstdlib>
+
+// writing is mostly disk/compression bound, more writers than this don't help much
+static const int defaultWriterCount = 4;
+
+static WriteQueue* sharedQueue = NULL;
+static std::mutex sharedQueueMutex;
+
+WriteQueue::WriteQueue(size_t maxPendingBytes, int writerCount)
+	: m_maxPendingBytes(maxPendingBytes), m_pendingBytes(0), m_activeWrites(0), m_stop(false)
+{
+	if (m_maxPendingBytes == 0)
+		return;
+
+	for (int i=0; i < writerCount; i++)
+	{
+		m_threads.push_back(std::thread(&WriteQueue::WriterMain, this));
+	}
+}
+
+WriteQueue::~WriteQueue()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_changed.notify_all();
+
+	for (size_t i=0; i < m_threads.size(); i++)
+	{
+		m_threads[i].join();
+	}
+}
+
+void WriteQueue::RunJob(const WriteJob& job)
+{
+	std::string error = job();
+	if (!error.empty())
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_errors.push_back(error);
+	}
+}
+
+void WriteQueue::WriterMain()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (;;)
+	{
+		while (!m_stop && m_queue.empty())
+		{
+			m_changed.wait(lock);
+		}
+		if (m_queue.empty())
+			return; // stopping and everything has been written
+
+		PendingWrite write = m_queue.front();
+		m_queue.pop_front();
+		m_activeWrites++;
+
+		lock.unlock();
+		RunJob(write.job);
+		write.job = WriteJob(); // drop the frame data before accounting for it
+		lock.lock();
+
+		m_activeWrites--;
+		m_pendingBytes -= write.bytes;
+		m_changed.notify_all();
+	}
+}
+
+void WriteQueue::Push(const WriteJob& job, size_t bytes)
+{
+	if (m_threads.empty())
+	{
+		RunJob(job);
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	// a frame bigger than the whole budget is still accepted once everything before it has been written
+	while (m_pendingBytes > 0 && m_pendingBytes + bytes > m_maxPendingBytes)
+	{
+		m_changed.wait(lock);
+	}
+
+	PendingWrite write = { job, bytes };
+	m_queue.push_back(write);
+	m_pendingBytes += bytes;
+	m_changed.notify_all();
+}
+
+void WriteQueue::Flush()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (!m_queue.empty() || m_activeWrites > 0)
+	{
+		m_changed.wait(lock);
+	}
+}
+
+std::vector<std::string> WriteQueue::TakeErrors()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::vector<std::string> errors;
+	errors.swap(m_errors);
+	return errors;
+}
+
+size_t WriteQueue::DefaultMaxPendingBytes()
+{
+	const char* env = getenv("PARTIO_EXPORT_WRITE_BUFFER_MB");
+	if (env != NULL)
+		return size_t(atoi(env) > 0 ? atoi(env) : 0) * 1024 * 1024;
+
+	return size_t(1024) * 1024 * 1024;
+}
+
+WriteQueue& WriteQueue::Shared()
+{
+	std::lock_guard<std::mutex> lock(sharedQueueMutex);
+	if (sharedQueue == NULL)
+		sharedQueue = new WriteQueue(DefaultMaxPendingBytes(), defaultWriterCount);
+	return *sharedQueue;
+}
+
+void WriteQueue::ShutdownShared()
+{
+	std::lock_guard<std::mutex> lock(sharedQueueMutex);
+	delete sharedQueue;
+	sharedQueue = NULL;
+}
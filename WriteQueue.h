@@ -0,0 +1,85 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2013 James Vecore
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef PARTIO_EXPORT_WRITE_QUEUE_H
+#define PARTIO_EXPORT_WRITE_QUEUE_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Write-behind queue for finished frames.
+//
+// Writes are run on a few background threads so the next frame can be fetched and converted while the previous ones
+// are still being compressed and written. Jobs are started in the order they were pushed but several files (frames, or
+// the objects of a model export) can be written at the same time. Push() blocks while the queued frames hold more than the memory
+// budget, so a slow disk throttles the export instead of piling up frames in memory. A write job returns an error
+// message (empty on success), errors are collected and handed out by TakeErrors() on a later call.
+class WriteQueue
+{
+public:
+	typedef std::function<std::string()> WriteJob;
+
+	// maxPendingBytes of 0 disables the background threads and runs every write synchronously in Push()
+	WriteQueue(size_t maxPendingBytes, int writerCount);
+	~WriteQueue(); // waits for all pending writes
+
+	void Push(const WriteJob& job, size_t bytes);
+	void Flush();
+	std::vector<std::string> TakeErrors();
+
+	static WriteQueue& Shared();
+	static void ShutdownShared(); // must be called before the plugin is unloaded
+
+	// PARTIO_EXPORT_WRITE_BUFFER_MB environment variable if set, otherwise 1024 MB
+	static size_t DefaultMaxPendingBytes();
+
+private:
+	WriteQueue(const WriteQueue&);
+	WriteQueue& operator=(const WriteQueue&);
+
+	struct PendingWrite
+	{
+		WriteJob job;
+		size_t bytes;
+	};
+
+	void WriterMain();
+	void RunJob(const WriteJob& job);
+
+	size_t m_maxPendingBytes;
+	size_t m_pendingBytes;
+	int m_activeWrites;
+	bool m_stop;
+	std::deque<PendingWrite> m_queue;
+	std::vector<std::string> m_errors;
+	std::vector<std::thread> m_threads;
+	std::mutex m_mutex;
+	std::condition_variable m_changed;
+};
+
+#endif